@@ -16,6 +16,7 @@
 #include "file_utils.h"
 #include "draw_utils.h"
 #include "tree_leaf.h"
+#include "profiler.h"
 #include <set>
 
 #ifdef _WIN32 // wglew.h seems to be Windows only
@@ -64,7 +65,7 @@ char *lighting_file[NUM_LIGHTING_TYPES] = {0};
 bool combined_gu(0), underwater(0), kbd_text_mode(0), univ_stencil_shadows(1), use_waypoint_app_spots(0), enable_tiled_mesh_ao(0), tiled_terrain_only(0);
 bool show_lightning(0), disable_shader_effects(0), use_waypoints(0), group_back_face_cull(0), start_maximized(0), claim_planet(0), skip_light_vis_test(0);
 bool no_smoke_over_mesh(0), enable_model3d_tex_comp(0), global_lighting_update(0), lighting_update_offline(0), mesh_difuse_tex_comp(1), smoke_dlights(0), keep_keycards_on_death(0);
-bool texture_alpha_in_red_comp(0), use_model2d_tex_mipmaps(1), mt_cobj_tree_build(0), two_sided_lighting(0), inf_terrain_scenery(1), invert_model_nmap_bscale(0);
+bool texture_alpha_in_red_comp(0), use_model2d_tex_mipmaps(1), mt_cobj_tree_build(0), incremental_cobj_tree(1), two_sided_lighting(0), inf_terrain_scenery(1), invert_model_nmap_bscale(0);
 bool gen_tree_roots(1), fast_water_reflect(0), vsync_enabled(0), use_voxel_cobjs(0), disable_sound(0), enable_depth_clamp(0), volume_lighting(0), no_subdiv_model(0);
 bool detail_normal_map(0), init_core_context(0), use_core_context(0), enable_multisample(1), dynamic_smap_bias(0), model3d_wn_normal(0), snow_shadows(0), user_action_key(0);
 bool enable_dlight_shadows(1), tree_indir_lighting(0), ctrl_key_pressed(0), only_pine_palm_trees(0), enable_gamma_correct(0), use_z_prepass(0), reflect_dodgeballs(0);
@@ -74,7 +75,8 @@ bool enable_model3d_custom_mipmaps(1), flatten_tt_mesh_under_models(0), show_map
 bool enable_dpart_shadows(0), enable_tt_model_reflect(1), enable_tt_model_indir(0), auto_calc_tt_model_zvals(0), use_model_lod_blocks(0), enable_translocator(0), enable_grass_fire(0);
 bool disable_model_textures(0), start_in_inf_terrain(0), allow_shader_invariants(1), config_unlimited_weapons(0), disable_tt_water_reflect(0), allow_model3d_quads(1);
 bool enable_timing_profiler(0), fast_transparent_spheres(0), force_ref_cmap_update(0), use_instanced_pine_trees(0), enable_postproc_recolor(0), draw_building_interiors(0);
-bool toggle_room_light(0), teleport_to_screenshot(0), merge_model_objects(0), display_frame_time(0), reverse_3ds_vert_winding_order(1), disable_dlights(0);
+bool toggle_room_light(0), teleport_to_screenshot(0), merge_model_objects(0), model_weld_benchmark(0), display_frame_time(0), reverse_3ds_vert_winding_order(1), disable_dlights(0);
+bool univ_lockstep_time(0), show_telemetry(0);
 int xoff(0), yoff(0), xoff2(0), yoff2(0), rand_gen_index(0), mesh_rgen_index(0), camera_change(1), camera_in_air(0), auto_time_adv(0);
 int animate(1), animate2(1), draw_model(0), init_x(STARTING_INIT_X), fire_key(0), do_run(0), init_num_balls(-1), change_wmode_frame(0);
 int game_mode(0), map_mode(0), load_hmv(0), load_coll_objs(1), read_landscape(0), screen_reset(0), mesh_seed(0), rgen_seed(1);
@@ -92,21 +94,23 @@ int enable_fsource(0), run_forward(0), advanced(0), dynamic_mesh_scroll(0);
 int read_snow_file(0), write_snow_file(0), mesh_detail_tex(NOISE_TEX);
 int read_light_files[NUM_LIGHTING_TYPES] = {0}, write_light_files[NUM_LIGHTING_TYPES] = {0};
 unsigned num_snowflakes(0), create_voxel_landscape(0), hmap_filter_width(0), num_dynam_parts(100), snow_coverage_resolution(2), num_birds_per_tile(2), num_fish_per_tile(15);
-unsigned erosion_iters(0), erosion_iters_tt(0), video_framerate(60), num_video_threads(0), skybox_tid(0);
+unsigned mesh_horizon_azimuths(0); // 0 = sweep mesh shadows for each light direction
+unsigned erosion_iters(0), erosion_iters_tt(0), video_framerate(60), num_video_threads(0), skybox_tid(0), univ_sim_bench_frames(0), camera_path_frames(0), univ_dist_ai_ticks(1);
 float NEAR_CLIP(DEF_NEAR_CLIP), FAR_CLIP(DEF_FAR_CLIP), system_max_orbit(1.0), sky_occlude_scale(0.0), tree_slope_thresh(5.0), mouse_sensitivity(1.0), tt_grass_scale_factor(1.0);
 float water_plane_z(0.0), base_gravity(1.0), crater_depth(1.0), crater_radius(1.0), disabled_mesh_z(FAR_CLIP), vegetation(1.0), atmosphere(1.0), biome_x_offset(0.0);
 float mesh_file_scale(1.0), mesh_file_tz(0.0), speed_mult(1.0), mesh_z_cutoff(-FAR_CLIP), relh_adj_tex(0.0), dodgeball_metalness(1.0), ray_step_size_mult(1.0);
 float water_h_off(0.0), water_h_off_rel(0.0), perspective_fovy(0.0), perspective_nclip(0.0), read_mesh_zmm(0.0), indir_light_exp(1.0), cloud_height_offset(0.0);
 float snow_depth(0.0), snow_random(0.0), cobj_z_bias(DEF_Z_BIAS), init_temperature(DEF_TEMPERATURE), indir_vert_offset(0.25), sm_tree_density(1.0), fog_dist_scale(1.0);
 float CAMERA_RADIUS(DEF_CAMERA_RADIUS), C_STEP_HEIGHT(0.6), waypoint_sz_thresh(1.0), model3d_alpha_thresh(0.9), model3d_texture_anisotropy(1.0), dist_to_fire_sq(0.0);
-float ocean_wave_height(DEF_OCEAN_WAVE_HEIGHT), tree_density_thresh(0.55), model_auto_tc_scale(0.0), model_triplanar_tc_scale(0.0), shadow_map_pcf_offset(0.0);
+float ocean_wave_height(DEF_OCEAN_WAVE_HEIGHT), tree_density_thresh(0.55), model_auto_tc_scale(0.0), model_weld_epsilon(0.0), model_triplanar_tc_scale(0.0), shadow_map_pcf_offset(0.0);
 float custom_glaciate_exp(0.0), tree_type_rand_zone(0.0), jump_height(1.0), force_czmin(0.0), force_czmax(0.0), smap_thresh_scale(1.0), dlight_intensity_scale(1.0);
 float model_mat_lod_thresh(5.0), clouds_per_tile(0.5), def_atmosphere(1.0), def_vegetation(1.0), ocean_depth_opacity_mult(1.0), erode_amount(1.0), ambient_scale(1.0);
 float model_hemi_lighting_scale(0.5), pine_tree_radius_scale(1.0), sunlight_brightness(1.0), moonlight_brightness(1.0);
 float light_int_scale[NUM_LIGHTING_TYPES] = {1.0, 1.0, 1.0, 1.0, 1.0}, first_ray_weight[NUM_LIGHTING_TYPES] = {1.0, 1.0, 1.0, 1.0, 1.0};
 double camera_zh(0.0);
 point mesh_origin(all_zeros), camera_pos(all_zeros), cube_map_center(all_zeros);
-string user_text, cobjs_out_fn, sphere_materials_fn, hmap_out_fn, skybox_cube_map_name, coll_damage_name;
+string user_text, cobjs_out_fn, sphere_materials_fn, hmap_out_fn, skybox_cube_map_name, coll_damage_name, telemetry_fn, camera_path_fn, scene_cache_fn, building_indir_cache_dir;
+fnv1a_hasher_t config_files_hasher; // contents of all config files read, used in cache keys
 colorRGB ambient_lighting_scale(1,1,1), mesh_color_scale(1,1,1);
 colorRGBA bkg_color, flower_color(ALPHA0);
 set<unsigned char> keys, keyset;
@@ -236,7 +240,7 @@ void quit_3dworld() { // called once at the end for proper cleanup
 
 	cout << "quitting" << endl;
 	kill_current_raytrace_threads();
-	end_building_rt_job();
+	end_building_rt_job_and_flush_cache();
 	clear_context();
 	exit_openal();
 
@@ -1610,6 +1614,7 @@ int load_config(string const &config_file) {
 
 	FILE *fp(open_config_file(config_file));
 	if (fp == nullptr) return 0;
+	hash_file_contents(fp, config_files_hasher);
 	int error(0);
 	char strc[MAX_CHARS] = {0}, md_fname[MAX_CHARS] = {0}, we_fname[MAX_CHARS] = {0}, fw_fname[MAX_CHARS] = {0}, include_fname[MAX_CHARS] = {0};
 
@@ -1630,6 +1635,7 @@ int load_config(string const &config_file) {
 	kwmb.add("use_dense_voxels", use_dense_voxels);
 	kwmb.add("use_voxel_cobjs", use_voxel_cobjs);
 	kwmb.add("mt_cobj_tree_build", mt_cobj_tree_build);
+	kwmb.add("incremental_cobj_tree", incremental_cobj_tree);
 	kwmb.add("global_lighting_update", global_lighting_update);
 	kwmb.add("lighting_update_offline", lighting_update_offline);
 	kwmb.add("two_sided_lighting", two_sided_lighting);
@@ -1668,6 +1674,7 @@ int load_config(string const &config_file) {
 	kwmb.add("no_store_model_textures_in_memory", no_store_model_textures_in_memory);
 	kwmb.add("no_subdiv_model", no_subdiv_model);
 	kwmb.add("merge_model_objects", merge_model_objects);
+	kwmb.add("model_weld_benchmark", model_weld_benchmark);
 	kwmb.add("use_grass_tess", use_grass_tess);
 	kwmb.add("use_instanced_pine_trees", use_instanced_pine_trees);
 	kwmb.add("enable_dpart_shadows", enable_dpart_shadows);
@@ -1696,6 +1703,8 @@ int load_config(string const &config_file) {
 	kwmb.add("draw_building_interiors", draw_building_interiors);
 	kwmb.add("reverse_3ds_vert_winding_order", reverse_3ds_vert_winding_order);
 	kwmb.add("disable_dlights", disable_dlights);
+	kwmb.add("univ_lockstep_time", univ_lockstep_time);
+	kwmb.add("show_telemetry", show_telemetry);
 
 	kw_to_val_map_t<int> kwmi(error);
 	kwmi.add("verbose", verbose_mode);
@@ -1735,6 +1744,9 @@ int load_config(string const &config_file) {
 	kwmu.add("grass_density", grass_density);
 	kwmu.add("max_unique_trees", max_unique_trees);
 	kwmu.add("shadow_map_sz", shadow_map_sz);
+	kwmu.add("univ_sim_bench_frames", univ_sim_bench_frames);
+	kwmu.add("univ_dist_ai_ticks", univ_dist_ai_ticks);
+	kwmu.add("camera_path_frames", camera_path_frames);
 	kwmu.add("max_ray_bounces", MAX_RAY_BOUNCES);
 	kwmu.add("num_test_snowflakes", num_snowflakes);
 	kwmu.add("hmap_filter_width", hmap_filter_width);
@@ -1743,6 +1755,7 @@ int load_config(string const &config_file) {
 	kwmu.add("num_dynam_parts", num_dynam_parts);
 	kwmu.add("num_birds_per_tile", num_birds_per_tile);
 	kwmu.add("num_fish_per_tile", num_fish_per_tile);
+	kwmu.add("mesh_horizon_azimuths", mesh_horizon_azimuths);
 	kwmu.add("max_cube_map_tex_sz", max_cube_map_tex_sz);
 	kwmu.add("snow_coverage_resolution", snow_coverage_resolution);
 	kwmu.add("dlight_grid_bitshift", DL_GRID_BS);
@@ -1795,6 +1808,7 @@ int load_config(string const &config_file) {
 	kwmf.add("far_clip_dist", FAR_CLIP);
 	kwmf.add("tree_height_scale", tree_height_scale);
 	kwmf.add("model_auto_tc_scale", model_auto_tc_scale);
+	kwmf.add("model_weld_epsilon", model_weld_epsilon);
 	kwmf.add("model_triplanar_tc_scale", model_triplanar_tc_scale);
 	kwmf.add("shadow_map_pcf_offset", shadow_map_pcf_offset);
 	kwmf.add("smap_thresh_scale", smap_thresh_scale);
@@ -1845,6 +1859,10 @@ int load_config(string const &config_file) {
 
 	kw_to_val_map_t<string> kwms(error);
 	kwms.add("cobjs_out_filename", cobjs_out_fn);
+	kwms.add("telemetry_filename", telemetry_fn); // .csv or .jsonl
+	kwms.add("camera_path_filename", camera_path_fn);
+	kwms.add("scene_cache_filename", scene_cache_fn); // binary cache of the parsed and preprocessed scene
+	kwms.add("building_indir_cache_dir", building_indir_cache_dir); // directory for cached building indirect lighting volumes
 	kwms.add("coll_damage_name",   coll_damage_name);
 	kwms.add("read_hmap_modmap_filename",  read_hmap_modmap_fn);
 	kwms.add("write_hmap_modmap_filename", write_hmap_modmap_fn);
@@ -2198,16 +2216,42 @@ void init_debug_callback() {
 int main(int argc, char** argv) {
 
 	cout << "Starting 3DWorld" << endl;
-	if (argc == 2) {read_ueventlist(argv[1]);}
+	string cmd_camera_path_fn, map_tiles_dir;
+	unsigned cmd_camera_path_frames(0), map_tiles_max_zoom(0);
+	float map_tiles_region[4] = {0.0};
+	int map_tiles_seed(0);
+
+	if (argc >= 3 && string(argv[1]) == "-camera_path") { // 3DWorld -camera_path <path_file> [num_frames]
+		cmd_camera_path_fn = argv[2];
+		if (argc >= 4) {cmd_camera_path_frames = atoi(argv[3]);}
+	}
+	else if (argc >= 8 && string(argv[1]) == "-map_tiles") { // 3DWorld -map_tiles <dir> <max_zoom> <x1> <y1> <x2> <y2> [mesh_seed]
+		map_tiles_dir      = argv[2];
+		map_tiles_max_zoom = atoi(argv[3]);
+		for (unsigned i = 0; i < 4; ++i) {map_tiles_region[i] = atof(argv[i+4]);}
+		if (argc >= 9) {map_tiles_seed = atoi(argv[8]);}
+	}
+	else if (argc == 2) {read_ueventlist(argv[1]);}
 	int rs(1);
-	if      (srand_param == 1) {rs = GET_TIME_MS();}
+	bool const time_seed(srand_param == 1 && map_tiles_dir.empty()); // map tiles must be repeatable
+	if      (time_seed) {rs = GET_TIME_MS();}
 	else if (srand_param != 0) {rs = srand_param;}
 	add_uevent_srand(rs);
 	create_sin_table();
 	set_scene_constants();
 	load_texture_names(); // needs to be before config file load
 	load_top_level_config(defaults_file);
+	if (!cmd_camera_path_fn.empty()) {camera_path_fn = cmd_camera_path_fn; camera_path_frames = cmd_camera_path_frames;} // command line overrides config file
+	if (!camera_path_fn.empty() && time_seed) {add_uevent_srand(1);} // camera path benchmark must be repeatable, whether enabled by command line or config file
 	gen_gauss_rand_arr(); // after reading seed from config file
+	if (!telemetry_fn.empty()) {open_telemetry_file(telemetry_fn);}
+	telemetry_enabled = (show_telemetry || !telemetry_fn.empty());
+	if (!camera_path_fn.empty()) {load_camera_path_bench(camera_path_fn, camera_path_frames);}
+
+	if (!map_tiles_dir.empty()) { // headless: no window or GL context
+		if (map_tiles_seed != 0) {mesh_seed = map_tiles_seed;}
+		exit(write_map_tiles_headless(map_tiles_dir, map_tiles_max_zoom, map_tiles_region[0], map_tiles_region[1], map_tiles_region[2], map_tiles_region[3]) ? 0 : 1);
+	}
 	cout << "Loading."; cout.flush();
 	
  	// Initialize GLUT
@@ -1262,6 +1262,20 @@ public:
 	void end() {if (enabled && !name.empty()) {register_timing_value(name.c_str(), GET_DELTA_TIME); name.clear();}}
 };
 
+class fnv1a_hasher_t { // 64-bit FNV-1a, used for cache keys
+	uint64_t hash=14695981039346656037ULL;
+public:
+	template<typename T> void operator()(T const &v) {
+		unsigned char const *const p((unsigned char const *)&v);
+		for (unsigned i = 0; i < sizeof(T); ++i) {hash = (hash ^ p[i])*1099511628211ULL;}
+	}
+	void add_bytes(void const *data, size_t size) {
+		unsigned char const *const p((unsigned char const *)data);
+		for (size_t i = 0; i < size; ++i) {hash = (hash ^ p[i])*1099511628211ULL;}
+	}
+	uint64_t get() const {return hash;}
+};
+
 
 // world modes
 enum {WMODE_GROUND=0, WMODE_UNIVERSE, WMODE_INF_TERRAIN, NUM_WMODE};
@@ -53,6 +53,7 @@ extern obj_vector_t<fire> fires;
 extern obj_vector_t<decal_obj> decals;
 extern water_particle_manager water_part_man;
 extern physics_particle_manager explosion_part_man[];
+extern obj_side_effects_t obj_side_effects;
 
 
 int get_obj_zval(point &pt, float &dz, float z_offset);
@@ -716,7 +717,7 @@ float dwobject::get_true_mass() const {
 
 
 // 0 = out of range/expired, 1 = airborne, 2 = collision, 3 = moving on ground, 4 = motionless
-void dwobject::advance_object(bool disable_motionless_objects, int iter, int obj_index) { // returns collision status
+void dwobject::advance_object(bool disable_motionless_objects, int iter, int obj_index, float dt) { // returns collision status
 
 	assert(!disabled());
 	if (temperature <= ABSOLUTE_ZERO) return;
@@ -740,11 +741,11 @@ void dwobject::advance_object(bool disable_motionless_objects, int iter, int obj
 		status  = 1;
 	}
 	if (disable_motionless_objects && status == 4 && ground_mode) {
-		if ((flags & IS_ON_ICE) || (!(flags & (FLOATING | STATIC_COBJ_COLL)) && object_still_stopped(obj_index))) {
+		if ((flags & IS_ON_ICE) || (!(flags & (FLOATING | STATIC_COBJ_COLL)) && object_still_stopped(obj_index, dt))) {
 			point const old_pos(pos);
-			check_vert_collision(obj_index, 1, iter); // needed for gameplay (already tested in object_still_stopped()?)
+			check_vert_collision(obj_index, 1, iter, dt); // needed for gameplay (already tested in object_still_stopped()?)
 			pos = old_pos;
-			if (disabled() || check_water_collision(velocity.z)) return;
+			if (disabled() || check_water_collision(velocity.z, dt)) return;
 			if (pos.z < zmin || !is_over_mesh(pos)) status = 0;
 			flags &= ~Z_STOPPED;
 			return;
@@ -777,7 +778,7 @@ void dwobject::advance_object(bool disable_motionless_objects, int iter, int obj
 			int const xpos(get_xpos(pos.x)), ypos(get_ypos(pos.y));
 
 			if (ground_mode && !point_outside_mesh(xpos, ypos) && (pos.z - radius) > water_matrix[ypos][xpos] &&
-				((friction < 2.0*STICK_THRESHOLD) || (friction < rand_uniform(2.0, 2.5)*STICK_THRESHOLD)))
+				((friction < 2.0*STICK_THRESHOLD) || (friction < obj_side_effects.rand_uniform(2.0, 2.5)*STICK_THRESHOLD)))
 			{
 				flags &= ~Z_STOPPED;
 			}
@@ -803,7 +804,7 @@ void dwobject::advance_object(bool disable_motionless_objects, int iter, int obj
 				float const grav_well(min(1.0f, 0.1f*v_flow.mag()));
 
 				if (-velocity.z < otype.terminal_vel) {
-					velocity.z -= (1.0 - grav_well)*base_gravity*gscale*GRAVITY*tstep*otype.gravity;
+					velocity.z -= (1.0 - grav_well)*base_gravity*gscale*GRAVITY*dt*otype.gravity;
 					velocity.z  = grav_well*velocity.z - (1.0f - grav_well)*min(-velocity.z, otype.terminal_vel);
 				}
 				if (fabs(air_factor*vtot.z) > fabs(velocity.z) || ((vtot.z < 0.0f) != (velocity.z < 0.0f))) {
@@ -812,7 +813,7 @@ void dwobject::advance_object(bool disable_motionless_objects, int iter, int obj
 			}
 			else {
 				if (-velocity.z < otype.terminal_vel) {
-					velocity.z -= base_gravity*gscale*GRAVITY*tstep*otype.gravity;
+					velocity.z -= base_gravity*gscale*GRAVITY*dt*otype.gravity;
 					velocity.z  = -min(-velocity.z, otype.terminal_vel);
 				}
 				if (fabs(air_factor*local_wind.z) > fabs(velocity.z) || ((local_wind.z < 0) != (velocity.z < 0))) {
@@ -829,12 +830,12 @@ void dwobject::advance_object(bool disable_motionless_objects, int iter, int obj
 					bool const stopped(friction >= 2.0*STICK_THRESHOLD || fabs(velocity[d]) <= friction);
 					velocity[d] = (stopped ? 0.0 : max(0.0f, (velocity[d] + ((velocity[d] > 0.0) ? -friction : friction))));
 				}
-				pos[d] += tstep*velocity[d]; // move object
+				pos[d] += dt*velocity[d]; // move object
 			}
 			if (flags & FLOATING) {float_downstream(pos, radius);}
 		}
-		assert(!is_nan(tstep));
-		pos.z += tstep*velocity.z;
+		assert(!is_nan(dt));
+		pos.z += dt*velocity.z;
 		verify_data();
 
 		// check collisions
@@ -849,11 +850,11 @@ void dwobject::advance_object(bool disable_motionless_objects, int iter, int obj
 			if ((ground_mode && pos.z < zmin) || (flags & Z_STOPPED)) {status = 0;} // out of simulation region and underwater
 			return;
 		}
-		int const wcoll(check_water_collision(vz_old));
+		int const wcoll(check_water_collision(vz_old, dt));
 		vector3d cnorm;
 		bool const last_stat_coll((flags & STATIC_COBJ_COLL) != 0);
 		old_pos = pos;
-		int coll(check_vert_collision(obj_index, 1, iter, &cnorm));
+		int coll(check_vert_collision(obj_index, 1, iter, dt, &cnorm));
 		if (disabled()) return;
 
 		if (!ground_mode) { // tiled terrain
@@ -908,15 +909,15 @@ void dwobject::advance_object(bool disable_motionless_objects, int iter, int obj
 		}
 		if (otype.flags & COLL_DESTROYS) {assert(type != SMILEY); status = 0; return;}
 		if (flags & STATIC_COBJ_COLL) return; // stuck on vertical collision surface
-		if (check_water_collision(velocity.z) && (frozen || get_true_density() < WATER_DENSITY)) return;
+		if (check_water_collision(velocity.z, dt) && (frozen || get_true_density() < WATER_DENSITY)) return;
 		if (flags & IS_CUBE_FLAG) return;
 		if (is_flat() || (otype.flags & OBJ_IS_CYLIN)) {set_orient_for_coll(NULL);}
-		int const val(surface_advance()); // move along ground
+		int const val(surface_advance(dt)); // move along ground
 
 		if (val == 2) { // moved, recalculate velocity from position change
 			status = 3;
-			if (radius >= LARGE_OBJ_RAD) {check_vert_collision(obj_index, 1, iter);} // adds instability though
-			assert(tstep > 0.0);
+			if (radius >= LARGE_OBJ_RAD) {check_vert_collision(obj_index, 1, iter, dt);} // adds instability though
+			assert(dt > 0.0);
 			if (radius >= LARGE_OBJ_RAD && velocity != zero_vector) {modify_grass_at(pos, radius, 1);} // crush grass
 		}
 		else if (val == 1) { // stopped
@@ -929,7 +930,7 @@ void dwobject::advance_object(bool disable_motionless_objects, int iter, int obj
 				}
 			}
 			if (status != 4) {
-				check_vert_collision(obj_index, 0, iter); // one last time before the object is "stopped"???
+				check_vert_collision(obj_index, 0, iter, dt); // one last time before the object is "stopped"???
 				velocity = zero_vector;
 				if (!disabled()) {status = 4;}
 			}
@@ -959,7 +960,7 @@ int get_obj_zval(point &pt, float &dz, float z_offset) { // 0 = out of bounds/er
 }
 
 
-int dwobject::object_still_stopped(int obj_index) {
+int dwobject::object_still_stopped(int obj_index, float dt) {
 
 	float const zval(pos.z - get_true_radius());
 	float const mh(interpolate_mesh_zval(pos.x, pos.y, 0.0, 0, 0));
@@ -971,7 +972,7 @@ int dwobject::object_still_stopped(int obj_index) {
 	}
 	point const old_pos(pos);
 	pos.z = zval;
-	int const coll(check_vert_collision(obj_index, 0, 0)); // apply coll functions?
+	int const coll(check_vert_collision(obj_index, 0, 0, dt)); // apply coll functions?
 	pos   = old_pos;
 	if (!disabled() && !coll) status = 1;
 	return coll;
@@ -979,7 +980,7 @@ int dwobject::object_still_stopped(int obj_index) {
 
 
 // 0 = error (bad position), 1 = stopped, 2 = moved
-int dwobject::surface_advance() {
+int dwobject::surface_advance(float dt) {
 
 	obj_type const &otype(object_types[type]);
 	
@@ -1032,8 +1033,8 @@ int dwobject::surface_advance() {
 	}
 	float const vmult((otype.flags & OBJ_IS_DROP) ? 0.0 : pow(max((1.0f - friction), 0.0f), fticks)); // droplets stick - no momentum
 	velocity = (mesh_vel*(1.0 - vmult) + velocity*vmult);
-	pos.x   += velocity.x*tstep;
-	pos.y   += velocity.y*tstep;
+	pos.x   += velocity.x*dt;
+	pos.y   += velocity.y*dt;
 	pos.z    = mh + radius;
 	return val+1;
 }
@@ -1081,7 +1082,7 @@ void dwobject::set_orient_for_coll(vector3d const *const forced_norm) {
 }
 
 
-int dwobject::check_water_collision(float vz_old) {
+int dwobject::check_water_collision(float vz_old, float dt) {
 
 	if (world_mode != WMODE_GROUND) return 0;
 	obj_type const &otype(object_types[type]);
@@ -1121,7 +1122,7 @@ int dwobject::check_water_collision(float vz_old) {
 
 					if ((zpos - pos.z) > 2.0f*radius) { // under the surface
 						velocity.z  = vz_old;
-						velocity.z -= ((density - WATER_DENSITY)/density)*base_gravity*GRAVITY*tstep;
+						velocity.z -= ((density - WATER_DENSITY)/density)*base_gravity*GRAVITY*dt;
 						flags      |= Z_STOPPED;
 						if ((pos.z - radius) > water_height) splash = 1;
 					}
@@ -1184,13 +1185,16 @@ int dwobject::check_water_collision(float vz_old) {
 			float energy(get_coll_energy(old_v, (exp_on_coll ? zero_vector : velocity), get_true_mass()));
 
 			if (energy > 0.0) {
-				draw_splash(pos.x, pos.y, water_height, SPLASH_BASE_SZ*sqrt(energy));
+				float const draw_size(SPLASH_BASE_SZ*sqrt(energy));
 				
-				if (type != DROPLET) {
-					if (type == SHRAPNEL) {
-						if (rand()%10 < 6) {energy = 0.0;} else {energy *= 0.2;}
-					}
-					//else if (type == FRAGMENT) {energy *= 0.2;} // too many fragments adding energy gives too large of a splash
+				if (type == DROPLET) {energy = 0.0;}
+				else if (type == SHRAPNEL) {
+					if (obj_side_effects.rand_int()%10 < 6) {energy = 0.0;} else {energy *= 0.2;}
+				}
+				//else if (type == FRAGMENT) {energy *= 0.2;} // too many fragments adding energy gives too large of a splash
+				if (obj_side_effects.is_active()) {obj_side_effects.add_splash(pos, xpos, ypos, water_height, draw_size, energy, radius);}
+				else {
+					draw_splash(pos.x, pos.y, water_height, draw_size);
 					if (energy > 0.0) {add_splash(pos, xpos, ypos, energy, radius, (radius >= LARGE_OBJ_RAD));}
 				}
 			}
@@ -1230,7 +1234,7 @@ void dwobject::surf_collide_obj() const {
 		if (flags & (TYPE_FLAG | FROZEN_FLAG)) break; // charred or ice, not blood
 	case BLOOD:
 		if (snow_height(pos)) { // in the snow
-			add_color_to_landscape_texture(BLOOD_C, pos.x, pos.y, ((type == BLOOD) ? 4.0 : 2.2)*get_true_radius());
+			obj_side_effects.add_color_to_landscape_texture(BLOOD_C, pos.x, pos.y, ((type == BLOOD) ? 4.0 : 2.2)*get_true_radius());
 		}
 		break;
 	}
@@ -1454,7 +1458,7 @@ void particle_cloud::apply_physics(unsigned i) {
 		obj.pos += (vel + init_vel)*(tstep/(double)num_smoke_advance);
 		vector3d cnorm;
 		
-		if (obj.check_vert_collision(0, 0, j, &cnorm, all_zeros, 1, 1)) { // skip dynamic, only_drawn
+		if (obj.check_vert_collision(0, 0, j, tstep, &cnorm, all_zeros, 1, 1)) { // skip dynamic, only_drawn
 			// destroy the smoke if it's not damaging and hits the bottom of a static drawn object (excludes trees and scenery)
 			if (cnorm.z < 0.0 && damage == 0.0) { // <= 0.0?
 				if (acc_smoke && time > 0) add_smoke(pos, 1.0);
@@ -1534,7 +1538,7 @@ void fire::apply_physics(unsigned i) {
 				dwobject obj(FIRE, pos, zero_vector, 1, 10000.0); // make a FIRE object for collision detection
 				obj.source = source;
 
-				if (!obj.check_vert_collision(source, 1, 0)) { // Note: source is passed in as obj_index, and represents the player/smiley responisble for the fire
+				if (!obj.check_vert_collision(source, 1, 0, tstep)) { // Note: source is passed in as obj_index, and represents the player/smiley responisble for the fire
 					pos.z -= radius;
 					status = 1; // re-animate
 				}
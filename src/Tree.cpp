@@ -12,6 +12,7 @@
 #include "sinf.h"
 #include "cobj_bsp_tree.h"
 #include "draw_utils.h"
+#include "profiler.h"
 
 float const BURN_RADIUS      = 0.2;
 float const BURN_DAMAGE      = 80.0;
@@ -31,6 +32,10 @@ int const DISABLE_LEAVES     = 0;
 int const ENABLE_CLIP_LEAVES = 1;
 int const TLEAF_START_TUID   = 8; // trees use texture units 8-12
 bool const FORCE_TREE_TYPE   = 1;
+bool const BATCHED_LEAF_WIND = 1; // 0 = bend leaves one at a time (old path, for comparison)
+float const LEAF_BEND_TOLER  = 0.001; // in radians; smaller wind angle changes aren't applied/uploaded
+unsigned const LEAF_BATCH_SIZE     = 8; // leaves bent per SIMD batch
+unsigned const LEAF_DIRTY_BLK_BITS = 6; // 64 leaves per dirty block
 unsigned const CYLINS_PER_ROOT     = 3;
 unsigned const TREE_BILLBOARD_SIZE = 256;
 
@@ -44,9 +49,9 @@ tree_type tree_types[NUM_TREE_TYPES] = { // not const - config file can override
 	tree_type(BARK6_TEX, PAPAYA_TEX,   1.0, 1.0, 1.0, 1.00, 2.0, 2.0, 0.5, 0.1,  0.0, colorRGBA(0.7, 0.6,  0.5,  1.0), WHITE)
 };
 
-vector<tree_cylin >   tree_builder_t::cylin_cache;
-vector<tree_branch>   tree_builder_t::branch_cache;
-vector<tree_branch *> tree_builder_t::branch_ptr_cache;
+thread_local vector<tree_cylin >   tree_builder_t::cylin_cache;
+thread_local vector<tree_branch>   tree_builder_t::branch_cache;
+thread_local vector<tree_branch *> tree_builder_t::branch_ptr_cache;
 
 
 // tree_mode: 0 = no trees, 1 = large only, 2 = small only, 3 = both large and small
@@ -342,6 +347,7 @@ void tree_cont_t::draw_branches_and_leaves(shader_t &s, tree_lod_render_t &lod_r
 		tree_data_t::post_leaf_draw();
 
 		if (!tt_shadow_mode) {
+			PROFILE_ZONE("Leaf Wind Update");
 			int const num_to_update(to_update_leaves.size());
 	#pragma omp parallel for num_threads(max(1, min(4, num_to_update))) schedule(static) if (num_to_update > 1)
 			for (int i = 0; i < num_to_update; ++i) {to_update_leaves[i]->update_leaf_orients_wind();}
@@ -537,6 +543,9 @@ void tree_data_t::mark_leaf_changed(unsigned ix) {
 	assert(ix < leaves.size());
 	leaf_change_start = min(ix,   leaf_change_start);
 	leaf_change_end   = max(ix+1, leaf_change_end);
+	unsigned const block(ix >> LEAF_DIRTY_BLK_BITS);
+	if (block >= leaf_dirty_blocks.size()) {leaf_dirty_blocks.resize(block+1, 0);}
+	leaf_dirty_blocks[block] = 1;
 }
 
 
@@ -592,6 +601,11 @@ void tree_data_t::remove_leaf_ix(unsigned i, bool update_data) {
 	assert(i < leaves.size());
 	leaves[i] = leaves.back();
 	leaves.pop_back();
+
+	if (!leaf_bend_angles.empty()) {
+		leaf_bend_angles[i] = leaf_bend_angles.back();
+		leaf_bend_angles.pop_back();
+	}
 	if (!update_data) return;
 	unsigned const i4(i << 2), tnl4((unsigned)leaves.size() << 2);
 	assert(4*leaves.size() <= leaf_data.size());
@@ -1135,6 +1149,7 @@ void tree_data_t::reset_leaf_pos_norm() {
 		UNROLL_4X(leaf_data[i_+(i<<2)].v = leaves[i].pts[i_];)
 		update_normal_for_leaf(i);
 	}
+	std::fill(leaf_bend_angles.begin(), leaf_bend_angles.end(), 0.0f);
 	reset_leaves = 0;
 }
 
@@ -1150,8 +1165,21 @@ void tree_data_t::ensure_leaf_vbo() {
 		assert(leaf_change_end <= leaves.size());
 		bind_vbo(leaf_vbo);
 		unsigned const per_leaf_stride(4*sizeof(leaf_vert_type_t));
-		upload_vbo_sub_data((&leaf_data.front() + 4*leaf_change_start), leaf_change_start*per_leaf_stride, (leaf_change_end - leaf_change_start)*per_leaf_stride);
+		unsigned const last_block(min((unsigned)leaf_dirty_blocks.size(), (((leaf_change_end - 1) >> LEAF_DIRTY_BLK_BITS) + 1)));
+		unsigned num_uploaded(0);
+
+		for (unsigned b = (leaf_change_start >> LEAF_DIRTY_BLK_BITS); b < last_block; ++b) { // upload each run of consecutive dirty blocks
+			if (!leaf_dirty_blocks[b]) continue;
+			unsigned const run_start(b);
+			while (b+1 < last_block && leaf_dirty_blocks[b+1]) {++b;}
+			unsigned const start(max(leaf_change_start, (run_start << LEAF_DIRTY_BLK_BITS))), end(min(leaf_change_end, ((b+1) << LEAF_DIRTY_BLK_BITS)));
+			if (start >= end) continue;
+			upload_vbo_sub_data((&leaf_data.front() + 4*start), start*per_leaf_stride, (end - start)*per_leaf_stride);
+			num_uploaded += (end - start);
+		}
+		telemetry_add_count("tree_leaves_uploaded", num_uploaded);
 	}
+	std::fill(leaf_dirty_blocks.begin(), leaf_dirty_blocks.end(), 0);
 	leaf_change_start = leaves.size();
 	leaf_change_end   = 0;
 }
@@ -1190,10 +1218,63 @@ void tree_data_t::bend_leaf(unsigned i, float angle) { // Note: slow
 	leaf_data[ix+2].v = l.pts[2] + delta;
 	norm_comp nc; nc.set_norm_no_clamp(normal); // already normalized, no need to clamp
 	UNROLL_4X(leaf_data[i_+ix].set_norm(nc);) // similar to update_normal_for_leaf()
+	if (i < leaf_bend_angles.size()) {leaf_bend_angles[i] = angle;}
 	mark_leaf_changed(i);
 	reset_leaves = 1; // do we want to update the normals as well?
 }
 
+// same math as bend_leaf(), but only for leaves whose angle has changed, and gathered into SoA batches of LEAF_BATCH_SIZE;
+// the sin/cos table lookups are done in the scalar gather loop so that the branch-free per-lane loop vectorizes
+// (verified with -fopt-info-vec); results are scattered back into the interleaved leaf vertex data
+void tree_data_t::bend_leaves_batched(vector<float> const &angles) {
+
+	assert(angles.size() == leaves.size());
+	if (leaf_bend_angles.size() != leaves.size()) {leaf_bend_angles.resize(leaves.size(), 0.0);}
+	static thread_local vector<unsigned> to_bend; // reused across calls, one per OpenMP thread
+	to_bend.clear();
+
+	for (unsigned i = 0; i < leaves.size(); ++i) {
+		if (fabs(angles[i] - leaf_bend_angles[i]) > LEAF_BEND_TOLER) {to_bend.push_back(i);}
+	}
+	unsigned const W(LEAF_BATCH_SIZE);
+
+	for (unsigned n = 0; n < to_bend.size(); n += W) {
+		unsigned const num(min(W, unsigned(to_bend.size() - n)));
+		float dx[W], dy[W], dz[W], nx[W], ny[W], nz[W], sx[W], sy[W], sz[W], ca[W], sa[W]; // inputs
+		float ox[W], oy[W], oz[W], rx[W], ry[W], rz[W]; // outputs: tip delta and leaf normal
+
+		for (unsigned j = 0; j < W; ++j) { // gather; unused lanes repeat the last leaf
+			unsigned const i(to_bend[n + min(j, num-1)]);
+			tree_leaf const &l(leaves[i]);
+			dx[j] = l.pts[1].x - l.pts[0].x; dy[j] = l.pts[1].y - l.pts[0].y; dz[j] = l.pts[1].z - l.pts[0].z;
+			sx[j] = l.pts[3].x - l.pts[0].x; sy[j] = l.pts[3].y - l.pts[0].y; sz[j] = l.pts[3].z - l.pts[0].z;
+			nx[j] = l.norm.x; ny[j] = l.norm.y; nz[j] = l.norm.z;
+			ca[j] = COSF(angles[i]);
+			sa[j] = SINF(angles[i])*(l.pts[1] - l.pts[0]).mag();
+		}
+#pragma omp simd
+		for (unsigned j = 0; j < W; ++j) { // no branches or libm calls here, or gcc won't vectorize it
+			float const tx(dx[j]*ca[j] + nx[j]*sa[j]), ty(dy[j]*ca[j] + ny[j]*sa[j]), tz(dz[j]*ca[j] + nz[j]*sa[j]); // new_dir
+			ox[j] = tx - dx[j]; oy[j] = ty - dy[j]; oz[j] = tz - dz[j];
+			float const cx(ty*sz[j] - tz*sy[j]), cy(tz*sx[j] - tx*sz[j]), cz(tx*sy[j] - ty*sx[j]); // cross_product(new_dir, side)
+			float const inv_len(InvSqrt(cx*cx + cy*cy + cz*cz + 1.0E-12f)); // error is below the precision of norm_comp
+			rx[j] = cx*inv_len; ry[j] = cy*inv_len; rz[j] = cz*inv_len;
+		}
+		for (unsigned j = 0; j < num; ++j) { // scatter
+			unsigned const i(to_bend[n + j]), ix(i<<2);
+			tree_leaf const &l(leaves[i]);
+			vector3d const delta(ox[j], oy[j], oz[j]);
+			leaf_data[ix+1].v = l.pts[1] + delta;
+			leaf_data[ix+2].v = l.pts[2] + delta;
+			norm_comp nc; nc.set_norm_no_clamp(vector3d(rx[j], ry[j], rz[j]));
+			UNROLL_4X(leaf_data[i_+ix].set_norm(nc);)
+			leaf_bend_angles[i] = angles[i];
+			mark_leaf_changed(i);
+		}
+	} // for n
+	if (!to_bend.empty()) {reset_leaves = 1;}
+}
+
 
 bool tree_data_t::check_if_needs_updated() {
 
@@ -1213,6 +1294,8 @@ void tree::update_leaf_orients_wind() { // leaves move in wind (somewhat slow)
 	bool const heal_pass(priv_data && LEAF_HEAL_RATE > 0 && world_mode == WMODE_GROUND && (rgen.rand()&7) == 0); // only update healed color every 8 frames
 	int last_xpos(0), last_ypos(0);
 	vector3d local_wind(zero_vector);
+	static thread_local vector<float> angles; // reused across calls, one per OpenMP thread
+	if (BATCHED_LEAF_WIND) {angles.resize(leaves.size());}
 
 	for (unsigned i = 0; i < leaves.size(); ++i) { // process leaf wind and collisions
 		point p0(leaves[i].pts[0]);
@@ -1227,8 +1310,9 @@ void tree::update_leaf_orients_wind() { // leaves move in wind (somewhat slow)
 		}
 		if (local_wind != zero_vector) {
 			float const angle(PI_TWO*max(-1.0f, min(1.0f, dot_product(local_wind, leaves[i].norm)))); // not physically correct, but it looks good
-			td.bend_leaf(i, angle);
+			if (BATCHED_LEAF_WIND) {angles[i] = angle;} else {td.bend_leaf(i, angle);}
 		}
+		else if (BATCHED_LEAF_WIND) {angles[i] = td.get_leaf_bend_angle(i);} // no wind, leave as is
 		if (heal_pass && (rgen.rand()&63) == 0) { // leaf heals every 64 frames
 			short &lcolor(td.get_leaves()[i].lcolor); // non-const, can't use <leaves>
 
@@ -1238,6 +1322,7 @@ void tree::update_leaf_orients_wind() { // leaves move in wind (somewhat slow)
 			}
 		}
 	} // for i
+	if (BATCHED_LEAF_WIND) {td.bend_leaves_batched(angles);}
 	leaf_orients_valid = 1;
 }
 
@@ -1314,6 +1399,7 @@ void tree_data_t::clear_data() {
 	clear_context();
 	clear_cont(all_cylins);
 	clear_cont(leaf_data);
+	clear_cont(leaf_bend_angles);
 	clear_cont(leaves); // Note: not present in original delete_trees()
 }
 
@@ -2196,6 +2282,7 @@ void tree_cont_t::gen_trees_tt_within_radius(int x1, int y1, int x2, int y2, poi
 	unsigned const skip_val(max(1, int(1.0/tree_scale))); // similar to deterministic gen in scenery.cpp
 	shared_tree_data.ensure_init();
 	mesh_xy_grid_cache_t density_gen[NUM_TREE_TYPES+1];
+	vector<deferred_tree_t> to_gen;
 
 	if (NONUNIFORM_TREE_DEN) { // i==0 is the coverage density map, i>0 are the per-tree type coverage maps
 #pragma omp parallel for schedule(dynamic) num_threads(2)
@@ -2251,9 +2338,36 @@ void tree_cont_t::gen_trees_tt_within_radius(int x1, int y1, int x2, int y2, poi
 				if (!adjust_tree_zval(pos, 0, ttype, 0, cur_tile)) continue; // create_bush=0
 			}
 			add_new_tree(rgen, ttype);
-			back().gen_tree(pos, 0, ttype, 0, 1, 0, rgen, 1.0, 1.0, 1.0, tree_4th_branches, 1); // allow bushes
+			to_gen.emplace_back((size() - 1), ttype, pos, rgen); // rgen is reseeded for the next tree, so each tree only depends on this state
 		} // for j
 	} // for i
+	gen_deferred_trees(to_gen);
+}
+
+// generate trees in parallel, with results identical to generating them serially in order:
+// a shared tree_data_t is created by the first tree that uses it, so those trees are generated before the trees that reuse their data
+void tree_cont_t::gen_deferred_trees(vector<deferred_tree_t> &trees) {
+
+	vector<unsigned> passes[2]; // {private or creates shared data, uses previously created shared data}
+	set<tree_data_t const *> created;
+
+	for (unsigned i = 0; i < trees.size(); ++i) {
+		tree_data_t const *const td((*this)[trees[i].ix].get_shared_tdata());
+		bool const creates(td == nullptr || (!td->is_created() && created.insert(td).second));
+		passes[!creates].push_back(i);
+	}
+	for (unsigned p = 0; p < 2; ++p) {
+		vector<unsigned> const &pass(passes[p]);
+
+#pragma omp parallel for schedule(dynamic) if (pass.size() > 1)
+		for (int i = 0; i < (int)pass.size(); ++i) {
+			deferred_tree_t &dt(trees[pass[i]]);
+			tree_data_t const *const td((*this)[dt.ix].get_shared_tdata());
+			if (p == 1) {dt.ttype = td->get_tree_type();} // matches add_new_tree() when the shared data had already been created
+			(*this)[dt.ix].gen_tree(dt.pos, 0, dt.ttype, 0, 0, 0, dt.rgen, 1.0, 1.0, 1.0, tree_4th_branches, 1); // allow bushes, add cobjs below
+		}
+	}
+	for (auto i = trees.begin(); i != trees.end(); ++i) {(*this)[i->ix].add_tree_collision_objects();} // not thread safe; add in serial order
 }
 
 
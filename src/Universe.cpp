@@ -8,6 +8,9 @@
 #include "shaders.h"
 #include "gl_ext_arb.h"
 #include "asteroid.h"
+#include "profiler.h"
+#include <thread>
+#include <atomic>
 
 
 // temperatures
@@ -48,6 +51,7 @@ float const REV_RATE_CONST   = 1.0*ROTREV_TIMESCALE;
 float const STAR_BRIGHTNESS  = 1.4;
 float const MIN_TEX_OBJ_SZ   = 4.0;
 float const MAX_WATER        = 0.75;
+float const UCELL_PREFETCH_DIST = 0.2; // start generating the next face of cells when within this fraction of a cell from the edge
 float const GLOBAL_AMBIENT   = 0.25;
 float const GAS_GIANT_MIN_REL_SZ = 0.34;
 
@@ -75,6 +79,7 @@ extern double tfticks;
 extern point universe_origin;
 extern colorRGBA bkg_color, sunlight_color;
 extern exp_type_params et_params[];
+extern modmap modmaps[N_UMODS];
 
 int gen_rand_seed1(point const &center);
 int gen_rand_seed2(point const &center);
@@ -146,12 +151,12 @@ void setup_universe_fog(s_object const &closest) {
 }
 
 
-// Note: not threadsafe
+// Note: thread safe as long as the universe isn't modified, since the query state is per-thread
 uobject *line_intersect_universe(point const &start, vector3d const &dir, float length, float line_radius, float &dist) {
 
 	point coll;
 	s_object target;
-	static line_query_state lqs;
+	thread_local line_query_state lqs;
 
 	if (universe.get_trajectory_collisions(lqs, target, coll, dir, start, length, line_radius)) { // destroy, query, beams
 		if (target.is_solid()) {
@@ -1083,9 +1088,85 @@ void add_nearby_uobj_text(text_drawer_t &text_drawer) {
 // *** UPDATE CODE ***
 
 
+// generates the face of cells the player is predicted to move into next in a background thread
+class ucell_prefetcher_t {
+
+	std::thread gen_thread;
+	std::atomic<bool> is_done;
+	bool is_valid, was_used; // have a pending or completed prefetch; face cells were moved into the universe
+	int dir[3], target_uxyz[3]; // target_uxyz is uxyz after the shift
+	vector<ucell> face_cells; // {U_BLOCKS x U_BLOCKS} cells indexed by the two dims other than the shift dim
+	s_object name_sobj;
+	modmap given_names; // snapshot of the user given names, which can be modified by the main thread
+
+	static unsigned get_shift_dim(int const dir_[3]) {return (dir_[0] ? 0 : (dir_[1] ? 1 : 2));}
+
+	void get_face_cell_ii(unsigned ix, int ii[3]) const {
+		unsigned const d(get_shift_dim(dir));
+		ii[d] = ((dir[d] > 0) ? U_BLOCKS-1 : 0);
+		ii[(d+1)%3] = ix%U_BLOCKS;
+		ii[(d+2)%3] = ix/U_BLOCKS;
+	}
+	void gen_face_cells() { // runs in the background thread
+		PROFILE_ZONE("Prefetch Cells");
+		point const upt(CELL_SIZE*target_uxyz[0], CELL_SIZE*target_uxyz[1], CELL_SIZE*target_uxyz[2]);
+
+		for (unsigned ix = 0; ix < face_cells.size(); ++ix) {
+			int ii[3];
+			get_face_cell_ii(ix, ii);
+			face_cells[ix].gen_cell_at(ii, upt, name_sobj, given_names);
+		}
+		is_done = 1;
+	}
+	bool matches(int const dir_[3]) const {
+		for (unsigned d = 0; d < 3; ++d) {
+			if (dir[d] != dir_[d] || target_uxyz[d] != (uxyz[d] + dir_[d])) return 0;
+		}
+		return 1;
+	}
+
+public:
+	ucell_prefetcher_t() : is_done(0), is_valid(0), was_used(0) {UNROLL_3X(dir[i_] = target_uxyz[i_] = 0;)}
+	~ucell_prefetcher_t() {clear();}
+	void wait() {if (gen_thread.joinable()) {gen_thread.join();}}
+
+	void clear() {
+		wait();
+		is_valid = was_used = 0;
+		face_cells.clear();
+	}
+	void end_shift() {if (was_used) {clear();}} // a mispredicted face is kept in case the player moves there later
+	void start(int const dir_[3]) { // called before the shift, so target is uxyz + dir
+		if (is_valid && matches(dir_)) return; // already generated or in progress
+		if (is_valid && !is_done) return; // busy with a different face; let it finish
+		clear();
+		UNROLL_3X(dir[i_] = dir_[i_]; target_uxyz[i_] = uxyz[i_] + dir_[i_];)
+		face_cells.resize(U_BLOCKS_SQ);
+		name_sobj   = current; // copy so that the thread doesn't read the globals
+		given_names = modmaps[MOD_NAME];
+		is_done   = 0;
+		is_valid  = 1;
+		gen_thread = std::thread(&ucell_prefetcher_t::gen_face_cells, this);
+	}
+	bool take_cell(int const ii[3], int const dir_[3], ucell &cell) { // called during the shift, after uxyz has been updated
+		if (!is_valid) return 0;
+		UNROLL_3X(if (dir[i_] != dir_[i_] || target_uxyz[i_] != uxyz[i_]) return 0;)
+		wait(); // generally already done
+		unsigned const d(get_shift_dim(dir)), ix(ii[(d+1)%3] + U_BLOCKS*ii[(d+2)%3]);
+		assert(ix < face_cells.size());
+		cell     = face_cells[ix];
+		was_used = 1;
+		return 1;
+	}
+};
+
+ucell_prefetcher_t ucell_prefetcher;
+
+
 void universe_t::init() {
 
 	assert(U_BLOCKS & 1); // U_BLOCKS is odd
+	ucell_prefetcher.clear();
 
 	for (unsigned i = 0; i < U_BLOCKS; ++i) { // z
 		for (unsigned j = 0; j < U_BLOCKS; ++j) { // y
@@ -1102,6 +1183,7 @@ void universe_t::shift_cells(int dx, int dy, int dz) {
 
 	assert((abs(dx) + abs(dy) + abs(dz)) == 1);
 	vector3d const vxyz((float)dx, (float)dy, (float)dz);
+	int const dir[3] = {dx, dy, dz};
 
 	for (unsigned i = 0; i < U_BLOCKS; ++i) { // z
 		for (unsigned j = 0; j < U_BLOCKS; ++j) { // y
@@ -1114,7 +1196,7 @@ void universe_t::shift_cells(int dx, int dy, int dz) {
 				if (xout || yout || zout) { // allocate new cell
 					int const ii[3]     = {(int)k, (int)j, (int)i};
 					temp.cells[i][j][k].gen = 0;
-					temp.cells[i][j][k].gen_cell(ii);
+					if (!ucell_prefetcher.take_cell(ii, dir, temp.cells[i][j][k])) {temp.cells[i][j][k].gen_cell(ii);}
 				}
 				else {
 					cells[i2][j2][k2].gen           = 1;
@@ -1133,6 +1215,22 @@ void universe_t::shift_cells(int dx, int dy, int dz) {
 			}
 		}
 	}
+	ucell_prefetcher.end_shift();
+}
+
+
+// camera is the player position relative to the center cell
+void universe_t::prefetch_cells(point const &camera) {
+
+	static point last_camera(all_zeros);
+	vector3d const move(camera - last_camera);
+	last_camera = camera;
+	unsigned const d(get_max_dim(camera));
+	if (fabs(camera[d]) < (0.5 - UCELL_PREFETCH_DIST)*CELL_SIZE) return; // not close enough to the cell edge
+	if (move[d]*camera[d] <= 0.0) return; // not moving toward the cell edge
+	int dir[3] = {0, 0, 0};
+	dir[d] = ((camera[d] < 0.0) ? -1 : 1);
+	ucell_prefetcher.start(dir);
 }
 
 
@@ -1153,19 +1251,23 @@ inline int gen_rand_seed2(point const &center) {
 }
 
 
-void ucell::gen_cell(int const ii[3]) {
+void ucell::gen_cell(int const ii[3]) {gen_cell_at(ii, get_scaled_upt(), current, modmaps[MOD_NAME]);}
+
+// thread safe: uses a local RNG seeded from the cell position rather than the global RNG, upt rather than uxyz, and given_names rather than the name modmap
+void ucell::gen_cell_at(int const ii[3], point const &upt, s_object const &name_sobj, modmap const &given_names) {
 
 	if (gen) return; // already generated
 	UNROLL_3X(rel_center[i_] = CELL_SIZE*(float(ii[i_] - (int)U_BLOCKSo2));)
-	pos    = rel_center + get_scaled_upt();
+	pos    = rel_center + upt;
 	radius = 0.5*CELL_SIZE;
-	set_rand2_state(gen_rand_seed1(pos), gen_rand_seed2(pos));
-	get_rseeds();
+	rand_gen_t cell_rgen;
+	cell_rgen.set_state(gen_rand_seed1(pos), gen_rand_seed2(pos));
+	rgen = cell_rgen;
 	galaxies.reset(new vector<ugalaxy>);
-	galaxies->resize(rand_uniform_uint2(MIN_GALAXIES_PER_CELL, MAX_GALAXIES_PER_CELL));
+	galaxies->resize(cell_rgen.rand_uniform_uint(MIN_GALAXIES_PER_CELL, MAX_GALAXIES_PER_CELL));
 
 	for (unsigned l = 0; l < galaxies->size(); ++l) { // gen galaxies
-		if (!(*galaxies)[l].create(*this, l)) { // can't place the galaxy
+		if (!(*galaxies)[l].create(*this, l, cell_rgen, name_sobj, given_names)) { // can't place the galaxy
 			galaxies->resize(l); // so remove it
 			break;
 		}
@@ -1178,19 +1280,20 @@ ugalaxy::ugalaxy() : lrq_rad(0.0), lrq_pos(all_zeros), color(BLACK) {}
 ugalaxy::~ugalaxy() {}
 
 
-bool ugalaxy::create(ucell const &cell, int index) {
+bool ugalaxy::create(ucell const &cell, int index, rand_gen_t &rgen_, s_object const &name_sobj, modmap const &given_names) {
 
-	current.type = UTYPE_GALAXY;
-	gen_rseeds();
+	s_object sobj(name_sobj);
+	sobj.type = UTYPE_GALAXY;
+	gen_rseeds(rgen_);
 	clear_systems();
 	gen      = 0;
-	radius   = rand_uniform2(GALAXY_MIN_SIZE, GALAXY_MAX_SIZE);
-	xy_angle = rand_uniform2(0.0, TWO_PI);
-	axis     = signed_rand_vector2_norm();
-	scale    = vector3d(1.0, rand_uniform2(0.6, 1.0), rand_uniform2(0.07, 0.2));
+	radius   = rgen_.rand_uniform(GALAXY_MIN_SIZE, GALAXY_MAX_SIZE);
+	xy_angle = rgen_.rand_uniform(0.0, TWO_PI);
+	axis     = rgen_.signed_rand_vector_norm();
+	scale    = vector3d(1.0, rgen_.rand_uniform(0.6, 1.0), rgen_.rand_uniform(0.07, 0.2));
 	lrq_rad  = 0.0;
 	lrq_pos  = all_zeros;
-	gen_name(current);
+	gen_name(sobj, rgen_, given_names);
 	cube_t const cube(-radius*scale, radius*scale);
 	point galaxy_ext(all_zeros), pts[8];
 	cube.get_points(pts);
@@ -1204,7 +1307,7 @@ bool ugalaxy::create(ucell const &cell, int index) {
 		assert(galaxy_ext[j] >= 0.0);
 	}
 	for (unsigned i = 0; i < MAX_TRIES; ++i) {
-		for (unsigned j = 0; j < 3; ++j) {pos[j] = double(galaxy_ext[j])*signed_rand_float2();}
+		for (unsigned j = 0; j < 3; ++j) {pos[j] = double(galaxy_ext[j])*rgen_.signed_rand_float();}
 		bool too_close(0);
 
 		for (int j = 0; j < index && !too_close; ++j) {
@@ -1243,8 +1346,11 @@ float ugalaxy::get_radius_at(point const &pos_, bool exact) const {
 	dir[1] *= scale[1];
 	dir[2] *= scale[2];
 	float const rval(radius*dir.mag());
-	lrq_rad = rval;
-	lrq_pos = pos_;
+
+	if (!exact) { // the exact path doesn't touch the cache, so it can be called from multiple threads
+		lrq_rad = rval;
+		lrq_pos = pos_;
+	}
 	return rval;
 }
 
@@ -2760,9 +2866,18 @@ string ustar::get_info() const {
 }
 
 
+univ_search_hints_t shared_search_hints; // used by get_closest_object() calls without their own hints; not thread safe
+
+void univ_search_hints_t::update(s_object const &result) {
+	if (result.galaxy  >= 0) {galaxy  = result.galaxy; }
+	if (result.cluster >= 0) {cluster = result.cluster;}
+	if (result.system  >= 0) {system  = result.system; }
+}
+
 // if not find_largest then find closest
+// hints: if non-null, search hints owned by the caller, which makes the call thread safe; otherwise the shared hints are used and updated
 int universe_t::get_closest_object(s_object &result, point pos, int max_level, bool include_asteroids,
-	bool offset, float expand, bool get_destroyed, float g_expand, float r_add, int galaxy_hint) const
+	bool offset, float expand, bool get_destroyed, float g_expand, float r_add, int galaxy_hint, univ_search_hints_t *hints) const
 {
 	float min_gdist(CELL_SIZE);
 	if (offset) offset_pos(pos);
@@ -2784,10 +2899,10 @@ int universe_t::get_closest_object(s_object &result, point pos, int max_level, b
 	pos -= cell.pos;
 	float const planet_thresh(expand*4.0*MAX_PLANET_EXTENT + r_add), moon_thresh(expand*2.0*MAX_PLANET_EXTENT + r_add);
 	float const pt_sq(planet_thresh*planet_thresh), mt_sq(moon_thresh*moon_thresh);
-	static int last_galaxy(-1), last_cluster(-1), last_system(-1);
-	int const first_galaxy_to_try((galaxy_hint >= 0) ? galaxy_hint : last_galaxy);
+	univ_search_hints_t &h(hints ? *hints : shared_search_hints);
+	int const first_galaxy_to_try((galaxy_hint >= 0) ? galaxy_hint : h.galaxy);
 	unsigned const ng((unsigned)cell.galaxies->size());
-	unsigned const go((first_galaxy_to_try >= 0 && first_galaxy_to_try < int(ng)) ? last_galaxy : 0);
+	unsigned const go((first_galaxy_to_try >= 0 && first_galaxy_to_try < int(ng)) ? h.galaxy : 0);
 	bool found_system(0);
 
 	for (unsigned gc_ = 0; gc_ < ng && !found_system; ++gc_) { // find galaxy
@@ -2797,7 +2912,8 @@ int universe_t::get_closest_object(s_object &result, point pos, int max_level, b
 		if (!galaxy.gen) continue; // not yet generated
 		float const distg(p2p_dist(pos, galaxy.pos));
 		if (distg > g_expand*(galaxy.radius + MAX_SYSTEM_EXTENT) + r_add) continue;
-		float const galaxy_radius(galaxy.get_radius_at((pos - galaxy.pos)/max(distg, TOLERANCE)));
+		// the last query radius cache in the galaxy isn't thread safe, so compute the exact radius when called from multiple threads (with hints)
+		float const galaxy_radius(galaxy.get_radius_at((pos - galaxy.pos)/max(distg, TOLERANCE), (hints != nullptr)));
 		if (distg > g_expand*(galaxy_radius + MAX_SYSTEM_EXTENT) + r_add) continue;
 
 		if (max_level == UTYPE_GALAXY) { // galaxy
@@ -2823,7 +2939,7 @@ int universe_t::get_closest_object(s_object &result, point pos, int max_level, b
 			}
 		}
 		unsigned const num_clusters((unsigned)galaxy.clusters.size());
-		unsigned const co((last_cluster >= 0 && last_cluster < int(num_clusters) && gc == go) ? last_cluster : 0);
+		unsigned const co((h.cluster >= 0 && h.cluster < int(num_clusters) && gc == go) ? h.cluster : 0);
 
 		for (unsigned cl_ = 0; cl_ < num_clusters && !found_system; ++cl_) { // find cluster
 			unsigned cl(cl_);
@@ -2832,7 +2948,7 @@ int universe_t::get_closest_object(s_object &result, point pos, int max_level, b
 			float const testval(expand*cluster.bounds + r_add);
 			if (p2p_dist_sq(pos, cluster.center) > testval*testval) continue;
 			unsigned const cs1(cluster.s1), cs2(cluster.s2);
-			unsigned const so((last_system >= int(cs1) && last_system < int(cs2) && cl == co) ? last_system : cs1);
+			unsigned const so((h.system >= int(cs1) && h.system < int(cs2) && cl == co) ? h.system : cs1);
 
 			for (unsigned s_ = cs1; s_ < cs2 && !found_system; ++s_) {
 				unsigned s(s_);
@@ -2858,13 +2974,22 @@ int universe_t::get_closest_object(s_object &result, point pos, int max_level, b
 				if (max_level == UTYPE_SYSTEM || max_level == UTYPE_STAR) continue; // system/star
 
 				if (include_asteroids && system.asteroid_belt != nullptr) { // check for asteroid belt collisions
-					if (system.asteroid_belt->sphere_might_intersect(pos, expand*system.asteroid_belt->get_max_asteroid_radius()+r_add)) {
-						// asteroid positions are dynamic, so spatial subdivision is difficult - we just do a slow linear iteration here
-						for (uasteroid_field::const_iterator j = system.asteroid_belt->begin(); j != system.asteroid_belt->end(); ++j) {
-							if (!dist_less_than(pos, j->pos, expand*j->radius+r_add)) continue;
-							result.assign(gc, cl, s, p2p_dist(pos, j->pos), UTYPE_ASTEROID, NULL);
+					uasteroid_belt const &belt(*system.asteroid_belt);
+
+					if (belt.sphere_might_intersect(pos, expand*belt.get_max_asteroid_radius()+r_add)) {
+						int ast_ix(-1);
+						asteroid_belt_grid_t const *const grid(belt.get_grid()); // rebuilt each time the asteroids move
+
+						if (grid) {grid->query_sphere(pos, expand, r_add, [&](unsigned ix) {ast_ix = max(ast_ix, (int)ix);});}
+						else {
+							for (uasteroid_field::const_iterator j = belt.begin(); j != belt.end(); ++j) {
+								if (dist_less_than(pos, j->pos, expand*j->radius+r_add)) {ast_ix = (j - belt.begin());}
+							}
+						}
+						if (ast_ix >= 0) { // use the last asteroid in index order, same as a linear iteration
+							result.assign(gc, cl, s, p2p_dist(pos, belt[ast_ix].pos), UTYPE_ASTEROID, NULL);
 							result.asteroid_field = AST_BELT_ID; // special asteroid belt identifier
-							result.asteroid       = (j - system.asteroid_belt->begin());
+							result.asteroid       = ast_ix;
 						}
 					}
 				}
@@ -2912,32 +3037,59 @@ int universe_t::get_closest_object(s_object &result, point pos, int max_level, b
 		} // cluster
 	} // galaxy
 	result.val = ((result.dist < CELL_SIZE) ? 1 : -1);
-	if (result.galaxy  >= 0) {last_galaxy  = result.galaxy; }
-	if (result.cluster >= 0) {last_cluster = result.cluster;}
-	if (result.system  >= 0) {last_system  = result.system; }
+	h.update(result);
 	return (result.val == 1);
 }
 
 
+// batched version of get_object_closest_to_pos(); queries don't update any shared state (search hints or galaxy radius caches), so they can run in parallel;
+// each fixed size block of queries starts from the shared search hints and passes its own hints from one query to the next, as a serial sequence of queries would,
+// so results don't depend on the number of threads; the hints are then updated from all results in order
+void universe_t::get_objects_closest_to_pos(vector<closest_obj_query_t> &queries, float expand) const {
+
+	unsigned const block_sz(64), num_blocks((queries.size() + block_sz - 1)/block_sz);
+
+	#pragma omp parallel for schedule(dynamic,1)
+	for (int b = 0; b < (int)num_blocks; ++b) {
+		univ_search_hints_t hints(shared_search_hints);
+		unsigned const end(min((unsigned)queries.size(), (b+1)*block_sz));
+
+		for (unsigned i = b*block_sz; i < end; ++i) {
+			closest_obj_query_t &q(queries[i]);
+			if (!q.skip) {q.found = get_closest_object(q.result, q.pos, UTYPE_MOON, q.include_asteroids, 1, expand, 0, 1.0, q.r_add, -1, &hints);}
+		}
+	}
+	for (auto i = queries.begin(); i != queries.end(); ++i) { // write the hints back
+		if (!i->skip && i->found != 2) {shared_search_hints.update(i->result);} // found == 2 is an early return on collision, which doesn't update the hints
+	}
+}
+
+
 void check_asteroid_belt_coll(std::shared_ptr<uasteroid_belt> asteroid_belt, point const &curr, vector3d const &dir, float dist, float line_radius,
 	int cix, int six, int pix, s_object &result, point &coll, float &ctest_dist, float &asteroid_dist, float &ldist)
 {
 	if (!asteroid_belt) return;
 	if (!asteroid_belt->line_might_intersect(curr, (curr + dist*dir), line_radius)) return;
-		
-	for (vector<uasteroid>::const_iterator a = asteroid_belt->begin(); a != asteroid_belt->end(); ++a) {
-		if (!pt_line_dir_dist_less_than(a->pos, curr, dir, (a->radius + line_radius))) continue;
-
-		if (a->line_intersection(curr, dir, ((ctest_dist == 0.0) ? dist : ctest_dist), line_radius, ldist)) {
-			result.assign_asteroid(ldist, (a - asteroid_belt->begin()), AST_BELT_ID);
-			if (pix >= 0) {result.planet = pix;}
-			result.system  = six;
-			result.cluster = cix;
-			asteroid_dist  = ldist;
-			ctest_dist     = ldist;
-			coll           = a->pos;
+	
+	auto check_asteroid([&](unsigned ix) {
+		uasteroid const &a((*asteroid_belt)[ix]);
+		if (!a.line_intersection(curr, dir, ((ctest_dist == 0.0) ? dist : ctest_dist), line_radius, ldist)) return;
+		result.assign_asteroid(ldist, ix, AST_BELT_ID);
+		if (pix >= 0) {result.planet = pix;}
+		result.system  = six;
+		result.cluster = cix;
+		asteroid_dist  = ldist;
+		ctest_dist     = ldist;
+		coll           = a.pos;
+	});
+	asteroid_belt_grid_t const *const grid(asteroid_belt->get_grid());
+	
+	if (grid) {grid->query_line(curr, dir, ((ctest_dist == 0.0) ? dist : ctest_dist), line_radius, check_asteroid);}
+	else {
+		for (vector<uasteroid>::const_iterator a = asteroid_belt->begin(); a != asteroid_belt->end(); ++a) {
+			if (pt_line_dir_dist_less_than(a->pos, curr, dir, (a->radius + line_radius))) {check_asteroid(a - asteroid_belt->begin());}
 		}
-	} // for a
+	}
 }
 
 
@@ -3383,9 +3535,11 @@ void urev_body::explode(float damage, float bradius, int etype, vector3d const &
 
 
 // is this really OS/machine independent (even 32-bit vs. 64-bit)?
-void uobj_rgen::gen_rseeds() {
-	rgen.rseed1 = rand2();
-	rgen.rseed2 = rand2();
+void uobj_rgen::gen_rseeds() {gen_rseeds(global_rand_gen);}
+
+void uobj_rgen::gen_rseeds(rand_gen_t &rgen_) {
+	rgen.rseed1 = rgen_.rand();
+	rgen.rseed2 = rgen_.rand();
 }
 
 void uobj_rgen::get_rseeds() {rgen = global_rand_gen;}
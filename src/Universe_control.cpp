@@ -7,6 +7,8 @@
 #include "ship_util.h"
 #include "asteroid.h"
 #include "timetest.h"
+#include "profiler.h"
+#include "u_event.h"
 #include "openal_wrap.h"
 #ifdef _OPENMP
 #include <omp.h>
@@ -26,6 +28,8 @@ pos_dir_up player_pdu;
 cobj_vector_t const empty_cobjs; // always empty
 unsigned owner_counts[NUM_ALIGNMENT] = {0};
 float resource_counts[NUM_ALIGNMENT] = {0.0};
+bool usim_bench_active(0);
+double usim_phase_times[NUM_USIM_PHASES] = {0.0};
 
 
 extern bool claim_planet, water_is_lava, no_shift_universe;
@@ -63,8 +67,10 @@ void add_player_ship_engine_light();
 
 #ifdef _OPENMP
 int omp_get_thread_num_3dw() {return omp_get_thread_num();} // where does this belong?
+int omp_get_max_threads_3dw() {return omp_get_max_threads();}
 #else
 int omp_get_thread_num_3dw() {return 0;}
+int omp_get_max_threads_3dw() {return 1;}
 #endif
 
 void init_universe_display() {
@@ -233,6 +239,8 @@ void proc_uobjs_first_frame() {
 
 void process_ships(int timer1) {
 
+	PROFILE_ZONE("Process Ships"); // may run on an OpenMP worker thread
+	telemetry_set_gauge("univ_objects", uobjs.size());
 	sort_uobjects();
 	if (TIMETEST) PRINT_TIME(" Sort uobjs");
 	add_player_ship_engine_light();
@@ -337,6 +345,23 @@ void proc_collision(free_obj *const uobj, upos_point_type const &cpos, point con
 void process_univ_objects() {
 
 	vector<free_obj const*> stat_obj_query_res;
+	static vector<closest_obj_query_t> clobj_queries;
+	clobj_queries.resize(uobjs.size());
+
+	for (unsigned i = 0; i < uobjs.size(); ++i) { // find closest objects for all uobjs up front in a single batch
+		free_obj const *const uobj(uobjs[i]);
+		bool const no_coll(uobj->no_coll()), particle(uobj->is_particle());
+
+		if ((no_coll && particle) || uobj->is_stationary() || uobj->is_orbiting()) {clobj_queries[i] = closest_obj_query_t();} // skip
+		else {clobj_queries[i] = closest_obj_query_t(uobj->get_pos(), (no_coll ? 0.0 : uobj->get_c_radius()), !particle);}
+	}
+	{
+		PROFILE_ZONE("Closest Objects");
+		accum_timer_t const timer(get_usim_phase_time(USIM_PHASE_CLOSEST));
+		universe.get_objects_closest_to_pos(clobj_queries);
+	}
+	unsigned const query_ast_remove_count(uasteroid_cont::remove_count);
+	accum_timer_t const timer(get_usim_phase_time(USIM_PHASE_GRAVITY)); // gravity, temperature, and sobj collision response
 
 	for (unsigned i = 0; i < uobjs.size(); ++i) { // can we use cached_objs?
 		free_obj *const uobj(uobjs[i]);
@@ -353,8 +378,24 @@ void process_univ_objects() {
 
 		// skip orbiting objects (no collisions or gravity effects, temperature is mostly constant)
 		s_object clobj; // closest object
-		bool const include_asteroids(!particle); // disable particle-asteroid collisions because they're too slow
-		int const found_close(orbiting ? 0 : universe.get_object_closest_to_pos(clobj, obj_pos, include_asteroids, 1.0, (no_coll ? 0.0 : radius)));
+		int found_close(0);
+
+		bool use_query(i < clobj_queries.size());
+
+		if (use_query && !clobj_queries[i].skip) { // batched query result may be stale if an earlier object in this loop moved this object or destroyed the result object
+			closest_obj_query_t const &q(clobj_queries[i]);
+			if (point(obj_pos) != q.pos) {use_query = 0;} // moved
+			else if (q.found && q.result.type == UTYPE_ASTEROID) {use_query = (uasteroid_cont::remove_count == query_ast_remove_count);} // asteroid indices may have changed
+			else if (q.found && q.result.object != NULL) {use_query = q.result.object->is_ok();} // destroyed
+		}
+		if (use_query) { // use batched query result
+			clobj       = clobj_queries[i].result;
+			found_close = clobj_queries[i].found;
+		}
+		else if (!orbiting) { // uobj was added during this loop, or the batched result is stale
+			bool const include_asteroids(!particle); // disable particle-asteroid collisions because they're too slow
+			found_close = universe.get_object_closest_to_pos(clobj, obj_pos, include_asteroids, 1.0, (no_coll ? 0.0 : radius));
+		}
 		bool temp_known(0), has_rings(0);
 		float limit_speed_dist(clobj.dist);
 
@@ -505,6 +546,51 @@ void process_univ_objects() {
 }
 
 
+double *get_usim_phase_time(unsigned phase) {
+
+	assert(phase < NUM_USIM_PHASES);
+	return (usim_bench_active ? (usim_phase_times + phase) : nullptr);
+}
+
+
+// replays the user event list (if one was loaded) through the universe simulation with a fixed timestep and without drawing;
+// only free objects are simulated - planets and moons are only updated when drawn, so they stay fixed
+void run_univ_sim_benchmark(unsigned num_frames) {
+
+	char const *const phase_names[NUM_USIM_PHASES] = {"Closest Object", "Gravity + SObj Coll", "AI", "Physics", "Collision"};
+	cout << "Running universe simulation benchmark for " << num_frames << " frames starting at frame " << frame_counter << endl;
+	for (unsigned i = 0; i < NUM_USIM_PHASES; ++i) {usim_phase_times[i] = 0.0;}
+	usim_bench_active = 1;
+	unsigned max_objs(0);
+	double total_time(0.0);
+
+	for (unsigned f = 0; f < num_frames; ++f) {
+		accum_timer_t const timer(&total_time);
+		proc_kbd_events();
+		uevent_advance_frame(); // replay recorded user input for this frame
+		fticks   = 1.0; // lockstep: fixed timestep
+		tfticks += fticks;
+
+		if (fire_key) {
+			fire_key = 0;
+			player_ship().try_fire_weapon();
+		}
+		apply_univ_physics();
+		camera_origin = get_player_pos();
+		update_cpos();
+		process_ships(0);
+		max_objs = max(max_objs, (unsigned)uobjs.size());
+	}
+	usim_bench_active = 0;
+	cout << "Universe simulation benchmark: " << num_frames << " frames, " << max_objs << " max objects, " << total_time << " ms total, "
+		 << total_time/max(num_frames, 1U) << " ms per frame" << endl;
+
+	for (unsigned i = 0; i < NUM_USIM_PHASES; ++i) {
+		cout << "  " << phase_names[i] << ": " << usim_phase_times[i] << " ms total, " << usim_phase_times[i]/max(num_frames, 1U) << " ms per frame" << endl;
+	}
+}
+
+
 void reset_player_universe() {
 
 	change_speed_mode(do_run);
@@ -524,6 +610,7 @@ void check_shift_universe() {
 	point camera(get_player_pos2());
 	vector3d move(zero_vector);
 	bool moved(0);
+	if (had_init_shift) {universe.prefetch_cells(camera);}
 
 	for (unsigned d = 0; d < 3; ++d) { // max move distance is CELL_SIZE
 		int sh[3] = {0, 0, 0};
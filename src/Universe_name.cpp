@@ -84,6 +84,13 @@ void named_obj::gen_name(s_object const &sobj) {
 	//cout << name << "  ";
 }
 
+// given_names is passed in rather than read from the global modmap so that this can be called from a background thread
+void named_obj::gen_name(s_object const &sobj, rand_gen_t &rgen, modmap const &given_names) {
+
+	name = gen_random_name(rgen);
+	lookup_given_name(sobj, given_names); // already named, overwrite the old value (but need to preserve random number generator state)
+}
+
 
 
 
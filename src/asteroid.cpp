@@ -521,6 +521,9 @@ unsigned const NUM_AST_MODELS    = 40;
 unsigned const AST_FLD_MAX_NUM   = 1200;
 unsigned const AST_BELT_MAX_NS   = 10000;
 unsigned const AST_BELT_MAX_NP   = 4000;
+unsigned const AB_GRID_CELL_OCC  = 4;    // target average number of asteroids per belt grid cell
+unsigned const AB_GRID_MAX_DIM   = 128;
+unsigned const AB_MT_PHYS_THRESH = 4096; // use multiple threads for belt physics when there are more asteroids than this
 float    const AST_RADIUS_SCALE  = 0.04;
 float    const AST_AMBIENT_S     = 2.5;
 float    const AST_AMBIENT_NO_S  = 10.0;
@@ -815,6 +818,7 @@ void uasteroid_belt::gen_asteroids() {
 		cloud_insts[i].asteroid_id = i; // for now, there is a 1:1 mapping between asteroids and clouds
 		cloud_insts[i].cloud_id    = (rgen.rand() % asteroid_model_gen.num_cloud_models());
 	}
+	update_grid();
 }
 
 void uasteroid_belt::draw_detail(point_d const &pos_, point const &camera, bool no_asteroid_dust, bool draw_dust, float density) const {
@@ -1147,8 +1151,10 @@ void uasteroid_belt_system::apply_physics(upos_point_type const &pos_, point con
 	if (!animate2 || empty()) return;
 	//RESET_TIME;
 	calc_colliders();
-	upos_point_type const opn(orbital_plane_normal);
-	for (iterator i = begin(); i != end(); ++i) {i->apply_belt_physics(pos, opn, orbit_scale, colliders);}
+	if (phys.size() != size()) {phys.init(*this, pos);} // first update since the asteroids were generated
+	phys.update(orbital_plane_normal, orbit_scale, colliders, pos);
+	phys.write_back(*this, pos);
+	update_grid();
 	calc_shadowers();
 	//PRINT_TIME("Physics"); // < 1ms
 	// no collision detection between asteroids as it's rare and too slow
@@ -1169,6 +1175,7 @@ void uasteroid_belt_planet::apply_physics(upos_point_type const &pos_, point con
 			if (animate2) {i->rot_ang += fticks*i->rot_ang0;} // rotation
 			i->pos += delta_pos; // must always update pos, even when physics are disabled
 		}
+		update_grid();
 	}
 	calc_shadowers();
 }
@@ -1338,9 +1345,12 @@ void uasteroid_cont::draw(point_d const &pos_, point const &camera, shader_t &s,
 }
 
 
+unsigned uasteroid_cont::remove_count(0);
+
 void uasteroid_cont::remove_asteroid(unsigned ix) {
 
 	assert(ix < size());
+	++remove_count;
 	//std::swap(at(ix), back()); pop_back();
 	erase(begin()+ix); // probably okay if empty after this call
 }
@@ -1356,9 +1366,161 @@ void uasteroid_belt::remove_asteroid(unsigned ix) {
 		*o++ = *i;
 	}
 	cloud_insts.erase(o, cloud_insts.end());
+	update_grid(); // asteroid indices have changed
+}
+
+void uasteroid_belt_system::remove_asteroid(unsigned ix) {
+
+	uasteroid_belt::remove_asteroid(ix);
+	if (ix < phys.size()) {phys.erase(ix);} // else not yet initialized
 }
 
 
+void asteroid_belt_grid_t::clear() {
+
+	UNROLL_3X(nxyz[i_] = 0;)
+	max_radius = 0.0;
+	cell_start.clear();
+	ids.clear();
+	px.clear(); py.clear(); pz.clear(); pr.clear();
+}
+
+void asteroid_belt_grid_t::build(vector<uasteroid> const &asteroids) {
+
+	clear();
+	if (asteroids.empty()) return;
+	cube_t bcube(asteroids.front().pos);
+
+	for (auto i = asteroids.begin(); i != asteroids.end(); ++i) {
+		bcube.union_with_pt(i->pos);
+		max_radius = max(max_radius, i->radius);
+	}
+	bcube.expand_by(max_radius); // avoid zero size dims
+	vector3d const sz(bcube.get_size());
+	unsigned const num(asteroids.size()), target_cells(max(1U, num/AB_GRID_CELL_OCC));
+	float const cell_sz(pow(sz.x*sz.y*sz.z/target_cells, 1.0f/3.0f));
+	assert(cell_sz > 0.0);
+	llc = bcube.get_llc();
+	UNROLL_3X(nxyz[i_] = max(1U, min(AB_GRID_MAX_DIM, unsigned(ceil(sz[i_]/cell_sz)))); inv_csz[i_] = nxyz[i_]/sz[i_];)
+	unsigned const ncells(nxyz[0]*nxyz[1]*nxyz[2]);
+	vector<unsigned> cixs(num);
+	cell_start.resize(ncells+1, 0);
+
+	for (unsigned i = 0; i < num; ++i) { // count asteroids per cell
+		point const &p(asteroids[i].pos);
+		unsigned c[3];
+		UNROLL_3X(c[i_] = min(nxyz[i_]-1, unsigned(max(0.0f, (p[i_] - llc[i_])*inv_csz[i_])));)
+		cixs[i] = (c[2]*nxyz[1] + c[1])*nxyz[0] + c[0];
+		++cell_start[cixs[i]+1];
+	}
+	for (unsigned c = 0; c < ncells; ++c) {cell_start[c+1] += cell_start[c];} // prefix sum
+	vector<unsigned> wpos(cell_start.begin(), cell_start.end()-1);
+	ids.resize(num);
+	px.resize(num); py.resize(num); pz.resize(num); pr.resize(num);
+
+	for (unsigned i = 0; i < num; ++i) { // scatter into cell order
+		unsigned const j(wpos[cixs[i]]++);
+		uasteroid const &a(asteroids[i]);
+		ids[j] = i;
+		px[j]  = a.pos.x; py[j] = a.pos.y; pz[j] = a.pos.z; pr[j] = a.radius;
+	}
+}
+
+bool asteroid_belt_grid_t::get_cell_range(cube_t const &c, unsigned lo[3], unsigned hi[3]) const {
+
+	for (unsigned d = 0; d < 3; ++d) {
+		float const v1((c.d[d][0] - llc[d])*inv_csz[d]), v2((c.d[d][1] - llc[d])*inv_csz[d]);
+		if (v2 < 0.0 || v1 >= nxyz[d]) return 0; // no overlap
+		lo[d] = unsigned(max(0.0f, v1));
+		hi[d] = min(nxyz[d]-1, unsigned(v2));
+	}
+	return 1;
+}
+
+
+void asteroid_belt_phys_t::clear() {
+
+	px.clear(); py.clear(); pz.clear();
+	vx.clear(); vy.clear(); vz.clear();
+	radius.clear(); odist.clear(); rev_rate.clear();
+}
+
+void asteroid_belt_phys_t::init(vector<uasteroid> const &asteroids, point const &center) {
+
+	unsigned const num(asteroids.size());
+	px.resize(num); py.resize(num); pz.resize(num);
+	vx.resize(num); vy.resize(num); vz.resize(num);
+	radius.resize(num); odist.resize(num); rev_rate.resize(num);
+
+	for (unsigned i = 0; i < num; ++i) {
+		uasteroid const &a(asteroids[i]);
+		vector3d const &v(a.get_velocity());
+		px[i] = double(a.pos.x) - center.x; py[i] = double(a.pos.y) - center.y; pz[i] = double(a.pos.z) - center.z;
+		vx[i] = v.x; vy[i] = v.y; vz[i] = v.z;
+		radius[i] = a.radius; odist[i] = a.get_orbital_dist(); rev_rate[i] = a.rev_ang0;
+	}
+}
+
+void asteroid_belt_phys_t::erase(unsigned ix) { // same order as uasteroid_cont::remove_asteroid()
+
+	assert(ix < size());
+	for (vector<double> *v : {&px, &py, &pz, &vx, &vy, &vz, &radius, &odist, &rev_rate}) {v->erase(v->begin()+ix);}
+}
+
+// move asteroids along their orbits around the belt center and push them out of colliders; asteroids are independent
+void asteroid_belt_phys_t::update(vector3d const &op_normal, vector3d const &orbit_scale, vector<sphere_t> const &colliders, point const &center) {
+
+	int const num(size());
+	double const nx(op_normal.x), ny(op_normal.y), nz(op_normal.z), ft(fticks), osx(orbit_scale.x), osy(orbit_scale.y);
+	bool const elliptical(osx != 1.0 || osy != 1.0);
+	double const emult(elliptical ? 1.0 : 0.0), eadd(elliptical ? 0.0 : 1.0); // blend rather than select in the loop
+	vector3d cols[3] = {plus_x, plus_y, plus_z}; // columns of the rotation of op_normal into +z, for the elliptical orbit radius
+	rotate_norm_vector3d_into_plus_z_multi(op_normal, cols, 3, 1.0);
+	double const m0x(cols[0].x), m0y(cols[1].x), m0z(cols[2].x), m1x(cols[0].y), m1y(cols[1].y), m1z(cols[2].y); // first two rows
+	double *const x(px.data()), *const y(py.data()), *const z(pz.data()), *const vxs(vx.data()), *const vys(vy.data()), *const vzs(vz.data());
+	double const *const od(odist.data()), *const rr(rev_rate.data()), *const rad(radius.data());
+
+#pragma omp parallel for simd schedule(static) if (num > (int)AB_MT_PHYS_THRESH)
+	for (int i = 0; i < num; ++i) { // no branches, compares, or libm calls other than sqrt here, or gcc won't vectorize it
+		// adjust velocity so asteroids revolve around the sun
+		// Note: slightly off for asteroids not in the plane, should be cross_product(dir, op_normal).get_norm() but that's slower
+		double const dx(x[i]), dy(y[i]), dz(z[i]);
+		double const vxi(rr[i]*(dy*nz - dz*ny)), vyi(rr[i]*(dz*nx - dx*nz)), vzi(rr[i]*(dx*ny - dy*nx));
+		double const ox(dx + ft*vxi), oy(dy + ft*vyi), oz(dz + ft*vzi); // adjust for next frame pos
+		double const len(sqrt(ox*ox + oy*oy + oz*oz));
+		// elliptical orbit scale; see get_elliptical_orbit_radius(), which is the same but takes a normalized direction
+		double const s(osx*(m1x*ox + m1y*oy + m1z*oz)), c(osy*(m0x*ox + m0y*oy + m0z*oz));
+		double const escale(emult*osx*osy*len/sqrt(s*s + c*c + 1.0E-30) + eadd);
+		double const dscale(escale*od[i]/len); // renormalize for constant distance
+		vxs[i] = vxi; vys[i] = vyi; vzs[i] = vzi;
+		x[i] = ox*dscale; y[i] = oy*dscale; z[i] = oz*dscale;
+	}
+	for (auto c = colliders.begin(); c != colliders.end(); ++c) { // few colliders; loop over the asteroids inside to vectorize
+		double const cx(double(c->pos.x) - center.x), cy(double(c->pos.y) - center.y), cz(double(c->pos.z) - center.z), cr(c->radius);
+#pragma omp simd
+		for (int i = 0; i < num; ++i) {
+			double const dx(x[i] - cx), dy(y[i] - cy), dz(z[i] - cz), r(rad[i] + cr), sr(r/sqrt(dx*dx + dy*dy + dz*dz + 1.0E-30));
+			double const scale(0.5*(sr + 1.0 + fabs(sr - 1.0))); // max(sr, 1.0): move colliding asteroids to the collider surface
+			x[i] = cx + dx*scale; y[i] = cy + dy*scale; z[i] = cz + dz*scale;
+		}
+	}
+}
+
+void asteroid_belt_phys_t::write_back(vector<uasteroid> &asteroids, point const &center) const {
+
+	assert(asteroids.size() == size());
+	upos_point_type const cpos(center);
+
+#pragma omp parallel for schedule(static) if (asteroids.size() > AB_MT_PHYS_THRESH)
+	for (int i = 0; i < (int)asteroids.size(); ++i) {
+		uasteroid &a(asteroids[i]);
+		a.pos = cpos + upos_point_type(px[i], py[i], pz[i]);
+		a.set_velocity(vector3d(vx[i], vy[i], vz[i]));
+		a.rot_ang += 0.5*fticks*a.rot_ang0; // slow rotation
+	}
+}
+
+
 void uasteroid_cont::detach_asteroid(unsigned ix) {
 
 	assert(ix < size());
@@ -1438,27 +1600,6 @@ void uasteroid::apply_field_physics(point const &af_pos, float af_radius) {
 }
 
 
-void uasteroid::apply_belt_physics(upos_point_type const &af_pos, upos_point_type const &op_normal, vector3d const &orbit_scale, vector<sphere_t> const &colliders) {
-
-	upos_point_type const dir(pos - af_pos);
-	rot_ang += 0.5*fticks*rot_ang0; // slow rotation
-	// adjust velocity so asteroids revolve around the sun
-	// Note: slightly off for asteroids not in the plane, should be cross_product(dir, op_normal).get_norm() but that's slower
-	velocity = rev_ang0*cross_product(dir, op_normal);
-	upos_point_type const orbit_dir(dir + fticks*velocity); // adjust for next frame pos
-	float odist(orbital_dist);
-	if (orbit_scale.x != 1.0 || orbit_scale.y != 1.0) {odist *= get_elliptical_orbit_radius(op_normal, orbit_scale, orbit_dir.get_norm());} // elliptical orbit scale - slow
-	pos = af_pos + orbit_dir*(odist/orbit_dir.mag()); // renormalize for constant distance
-
-	for (vector<sphere_t>::const_iterator i = colliders.begin(); i != colliders.end(); ++i) {
-		if (dist_less_than(pos, i->pos, (radius + i->radius))) {
-			vector3d const coll_normal((pos - i->pos).get_norm());
-			pos = i->pos + (radius + i->radius)*coll_normal;
-		}
-	}
-}
-
-
 void uasteroid::draw(point_d const &pos_, point const &camera, shader_t &s, pt_line_drawer &pld) const {
 
 	point_d const apos(pos_ + pos);
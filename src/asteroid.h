@@ -38,11 +38,11 @@ public:
 	void gen_belt(upos_point_type const &pos_offset, vector3d const &orbital_plane_normal, vector3d const vxy[2],
 		float belt_radius, float belt_width, float belt_thickness, float max_radius, float &ri_max, float &plane_dmax);
 	void apply_field_physics(point const &af_pos, float af_radius);
-	void apply_belt_physics(upos_point_type const &af_pos, upos_point_type const &op_normal, vector3d const &orbit_scale, vector<sphere_t> const &colliders);
 	void draw(point_d const &pos_, point const &camera, shader_t &s, pt_line_drawer &pld) const;
 	void destroy();
 	void set_velocity(vector3d const &v) {velocity = v;}
 	unsigned get_rseed()           const {return inst_id;}
+	float get_orbital_dist()       const {return orbital_dist;}
 	vector3d const &get_scale()    const {return scale;}
 	vector3d const &get_velocity() const {return velocity;}
 	float get_rel_mass()           const {return scale.x*scale.y*scale.z*radius*radius*radius;} // mass is proportional to volume which is proportional to radius^3
@@ -78,6 +78,8 @@ protected:
 	virtual void remove_asteroid(unsigned ix);
 
 public:
+	static unsigned remove_count; // total number of asteroids removed, used to detect asteroid indices that may have been invalidated
+
 	uasteroid_cont() : rseed(0) {}
 	virtual ~uasteroid_cont() {}
 	void init(point const &pos, float radius);
@@ -105,6 +107,77 @@ public:
 };
 
 
+class asteroid_belt_grid_t { // uniform grid of asteroid centers for collision queries, with positions and radii packed in cell order
+
+	unsigned nxyz[3] = {0};
+	point llc;
+	vector3d inv_csz;
+	float max_radius=0.0;
+	vector<unsigned> cell_start; // asteroids in cell c are [cell_start[c], cell_start[c+1])
+	vector<unsigned> ids; // asteroid index
+	vector<float> px, py, pz, pr; // SoA copies of asteroid pos and radius
+
+	bool get_cell_range(cube_t const &c, unsigned lo[3], unsigned hi[3]) const;
+public:
+	void build(vector<uasteroid> const &asteroids);
+	void clear();
+	bool is_valid(unsigned num) const {return (!cell_start.empty() && ids.size() == num);} // must be rebuilt when asteroids are added/removed
+
+	// calls f(ix) for each asteroid ix with dist(pos, asteroid.pos) < radius_scale*asteroid.radius + r_add
+	template<typename F> void query_sphere(point const &pos, float radius_scale, float r_add, F f) const {
+		float const qr(radius_scale*max_radius + r_add);
+		unsigned lo[3], hi[3];
+		if (!get_cell_range(cube_t(pos.x-qr, pos.x+qr, pos.y-qr, pos.y+qr, pos.z-qr, pos.z+qr), lo, hi)) return;
+
+		for (unsigned z = lo[2]; z <= hi[2]; ++z) {
+			for (unsigned y = lo[1]; y <= hi[1]; ++y) {
+				unsigned const row((z*nxyz[1] + y)*nxyz[0]);
+
+				for (unsigned j = cell_start[row + lo[0]]; j < cell_start[row + hi[0] + 1]; ++j) { // cells in a row are contiguous
+					float const dx(px[j] - pos.x), dy(py[j] - pos.y), dz(pz[j] - pos.z), r(radius_scale*pr[j] + r_add);
+					if (dx*dx + dy*dy + dz*dz < r*r) {f(ids[j]);}
+				}
+			}
+		}
+	}
+	// calls f(ix) for each asteroid ix within asteroid.radius + line_radius of the line from p1 along dir (normalized) of length dist
+	template<typename F> void query_line(point const &p1, vector3d const &dir, float dist, float line_radius, F f) const {
+		point const p2(p1 + dist*dir);
+		cube_t bc(p1, p2);
+		bc.expand_by(line_radius + max_radius);
+		unsigned lo[3], hi[3];
+		if (!get_cell_range(bc, lo, hi)) return;
+
+		for (unsigned z = lo[2]; z <= hi[2]; ++z) {
+			for (unsigned y = lo[1]; y <= hi[1]; ++y) {
+				unsigned const row((z*nxyz[1] + y)*nxyz[0]);
+
+				for (unsigned j = cell_start[row + lo[0]]; j < cell_start[row + hi[0] + 1]; ++j) {
+					vector3d const v((p1.x - px[j]), (p1.y - py[j]), (p1.z - pz[j]));
+					float const r(pr[j] + line_radius);
+					if (cross_product(dir, v).mag_sq() < r*r) {f(ids[j]);}
+				}
+			}
+		}
+	}
+};
+
+
+struct asteroid_belt_phys_t { // SoA copy of the belt asteroid physics state, so that the per-frame orbit update vectorizes
+
+	vector<double> px, py, pz; // position relative to the belt center
+	vector<double> vx, vy, vz; // velocity
+	vector<double> radius, odist, rev_rate; // constant per-asteroid values
+
+	unsigned size() const {return px.size();}
+	void clear();
+	void init(vector<uasteroid> const &asteroids, point const &center);
+	void erase(unsigned ix);
+	void update(vector3d const &op_normal, vector3d const &orbit_scale, vector<sphere_t> const &colliders, point const &center);
+	void write_back(vector<uasteroid> &asteroids, point const &center) const;
+};
+
+
 class uasteroid_belt : public uasteroid_cont {
 
 protected:
@@ -119,6 +192,7 @@ protected:
 	float max_asteroid_radius, inner_radius, outer_radius, temperature;
 	vector<cloud_inst> cloud_insts;
 	mutable vector<pair<float, cloud_inst>> clouds_to_draw;
+	asteroid_belt_grid_t grid;
 
 	void xform_to_local_torus_coord_space(point &pt) const;
 	void xform_from_local_torus_coord_space(point &pt) const;
@@ -136,6 +210,8 @@ public:
 	float get_line_sphere_int_radius_scale() const;
 	float get_dist_to_boundary(point const &pt) const;
 	float get_max_asteroid_radius() const {return max_asteroid_radius;}
+	void update_grid() {grid.build(*this);} // must be called after asteroids are moved
+	asteroid_belt_grid_t const *get_grid() const {return (grid.is_valid(size()) ? &grid : nullptr);}
 	void draw_detail(point_d const &pos_, point const &camera, bool no_asteroid_dust, bool draw_dust, float density) const;
 };
 
@@ -144,6 +220,7 @@ class uasteroid_belt_system : public uasteroid_belt {
 
 	ussystem *system;
 	vector<sphere_t> colliders;
+	asteroid_belt_phys_t phys; // must be kept in sync with the asteroids
 
 	virtual void gen_asteroid_placements();
 	void add_potential_collider(point const &cpos, float cradius);
@@ -154,6 +231,8 @@ class uasteroid_belt_system : public uasteroid_belt {
 public:
 	uasteroid_belt_system(vector3d const &opn, ussystem *system_) : uasteroid_belt(opn, system_->orbit_scale), system(system_) {}
 	virtual bool get_is_ice() const {return (temperature < 6.0);} // 50% of FREEZE_TEMP
+	virtual void gen_asteroids() {uasteroid_belt::gen_asteroids(); phys.clear();}
+	virtual void remove_asteroid(unsigned ix);
 	virtual void apply_physics(upos_point_type const &pos_, point const &camera);
 };
 
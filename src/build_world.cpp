@@ -27,6 +27,11 @@ unsigned const SM_STEPS_PER_FRAME = 1;
 unsigned const SHRAP_DLT_IX_MOD   = 8;
 float const STAR_INNER_RAD        = 0.4;
 float const ROTATE_RATE           = 25.0;
+bool const PARALLEL_OBJ_ADVANCE = 1;
+unsigned const MIN_PAR_ADVANCE_OBJS = 64;
+unsigned const MIN_BROADPHASE_OBJS = 64;
+unsigned const SCENE_CACHE_MAGIC   = 0x3D5CCAC1;
+unsigned const SCENE_CACHE_VERSION = 2; // increment when the cache format, serialized fields, or coll_obj_group::finalize() change
 
 
 // object variables
@@ -48,17 +53,20 @@ vector<sphere_t> cur_frame_explosions;
 vector<colorRGBA> colors_by_id; // for keycards
 vector<popup_text_t> popup_text;
 cube_light_src_vect sky_cube_lights, global_cube_lights;
+obj_side_effects_t obj_side_effects;
+obj_coll_broadphase_t obj_broadphase;
 
 extern bool clear_landscape_vbo, use_voxel_cobjs, tree_4th_branches, lm_alloc, reflect_dodgeballs, begin_motion, disable_fire_delay;
 extern int camera_view, camera_mode, camera_reset, animate2, recreated, temp_change, preproc_cube_cobjs, precip_mode;
 extern int is_cloudy, num_smileys, load_coll_objs, world_mode, start_ripple, has_snow_accum, has_accumulation, scrolling, num_items, camera_coll_id;
 extern int num_dodgeballs, display_mode, game_mode, num_trees, tree_mode, has_scenery2, UNLIMITED_WEAPONS, ground_effects_level;
-extern float temperature, zmin, TIMESTEP, base_gravity, orig_timestep, fticks, tstep, sun_rot, czmax, czmin, dodgeball_metalness;
+extern float temperature, zmin, TIMESTEP, base_gravity, fticks, tstep, sun_rot, czmax, czmin, dodgeball_metalness;
 extern double camera_zh;
 extern point cpos2, orig_camera, orig_cdir;
 extern unsigned create_voxel_landscape, scene_smap_vbo_invalid, num_dynam_parts, max_num_mat_spheres, init_item_counts[];
 extern obj_type object_types[];
-extern string cobjs_out_fn;
+extern string cobjs_out_fn, scene_cache_fn;
+extern fnv1a_hasher_t config_files_hasher;
 extern coll_obj_group coll_objects;
 extern cobj_groups_t cobj_groups;
 extern cobj_draw_groups cdraw_groups;
@@ -294,7 +302,7 @@ void object_line_coll(dwobject &obj, point const &old_pos, float radius, unsigne
 		obj.flags |= OBJ_COLLIDED;
 		obj.pos    = cpos; // move it to collision point
 		bool coll(0);
-		if (cindex >= 0) coll     = (obj.check_vert_collision(obj_index, 1, 0, NULL, all_zeros, 0, 0, cindex) != 0);
+		if (cindex >= 0) coll     = (obj.check_vert_collision(obj_index, 1, 0, tstep, NULL, all_zeros, 0, 0, cindex) != 0);
 		if (!coll)       obj.pos += cnorm*(0.99*radius); // move so it only slightly collides
 		assert(!is_nan(obj.pos));
 	}
@@ -309,6 +317,160 @@ void set_global_state() {
 }
 
 
+// advances a non-smiley object by one frame, using multiple smaller timesteps for fast moving objects; timesteps are passed to advance_object()
+// rather than modifying the global TIMESTEP/tstep, so this can be called for multiple objects in parallel when side effects are deferred
+void advance_dwobject(dwobject &obj, unsigned obj_ix, int type, float radius, bool large_radius, unsigned group_flags,
+	unsigned char obj_flags, float time, float grav_dz)
+{
+	if (obj.time < 0) {obj.time = 0; return;}
+	if (type == PLASMA && obj.velocity.mag_sq() < 1.0) {obj.disable(); return;} // plasma dies when it stops
+	point &pos(obj.pos);
+
+	if ((large_radius || type == STAR5) && type != KEYCARD) { // teleport large objects, except for keycards (so they don't get lost)
+		maybe_teleport_object(obj.pos, radius, NO_SOURCE, type, !large_radius); // teleport!
+		maybe_use_jump_pad(obj.pos, obj.velocity, radius, NO_SOURCE);
+	}
+	else if (type == BLOOD || type == CHARRED || type == SHRAPNEL || type == STAR5) {
+		maybe_teleport_object(obj.pos, radius, NO_SOURCE, type, 1);
+	}
+	point const old_pos(pos); // after teleporting
+	unsigned spf(1);
+	int cindex(-1);
+
+	// What about rolling objects (type_flags & OBJ_ROLLS) on the ground (status == 3)?
+	if (obj.status == 1 && is_over_mesh(pos) && !((obj_flags & XY_STOPPED) && (obj_flags & Z_STOPPED))) {
+		if (obj.flags & CAMERA_VIEW) {spf = 4*LG_STEPS_PER_FRAME;} // smaller timesteps if camera view
+		else if (type == PLASMA || type == BALL || type == SAWBLADE) {spf = 3*LG_STEPS_PER_FRAME;}
+		else if (is_rocket_type(type)) {spf = 2*LG_STEPS_PER_FRAME;}
+		else if (large_radius /*|| type == STAR5 || type == SHELLC*/ || type == FRAGMENT) {spf = LG_STEPS_PER_FRAME;}
+		else if (type == SHRAPNEL) {spf = max(1, min(((obj.direction == W_GRENADE) ? 4 : 20), int(0.2*obj.velocity.mag())));}
+		else if (type == PRECIP || (group_flags & PRECIPITATION)) {spf = 1;}
+		else {spf = SM_STEPS_PER_FRAME;}
+
+		if (MORE_COLL_TSTEPS && obj.status == 1 && spf < LG_STEPS_PER_FRAME && pos.z < czmax && pos.z > czmin) {
+			point pos2(pos + obj.velocity*time); // makes precipitation slower, but collision detection is more correct
+			pos2.z -= grav_dz; // maybe want to try with and without this?
+			// Note: we only do the line intersection test if the object moves by more than its radius this frame (static leaves don't)
+			// Note: could also test pos.z > v_collision_matrix[y][x].zmax
+			if (!dist_less_than(pos, pos2, radius)) {check_coll_line(pos, pos2, cindex, -1, 0, 0);} // return value is unused
+		}
+		assert(spf > 0);
+
+		if (spf > 1) { // incremental multistep object advance
+			assert(fticks > 0.0);
+			float const sub_tstep(tstep/spf);
+			point const obj_pos(obj.pos);
+								
+			for (unsigned k = 0; k < spf; ++k) {
+				obj.advance_object(!recreated, k, obj_ix, sub_tstep);
+				if (obj.status != 1)    break; // no longer airborne
+				if (obj.pos == obj_pos) break; // stopped
+			}
+		}
+	}
+	if (spf == 1) {obj.advance_object(!recreated, 0, obj_ix, tstep);}
+	obj.verify_data();
+						
+	if (!obj.disabled() && cindex >= 0 && !large_radius && spf < LG_STEPS_PER_FRAME) { // test collision with this cobj
+		object_line_coll(obj, old_pos, radius, obj_ix, cindex);
+	}
+}
+
+
+struct par_obj_t {
+	unsigned ix;
+	int orig_status;
+	unsigned char obj_flags; // flags at the beginning of the frame
+	bool deferred;
+	dwobject start_obj; // used to restore the object if it's deferred
+	par_obj_t(unsigned ix_, int os, unsigned char of, dwobject const &obj) : ix(ix_), orig_status(os), obj_flags(of), deferred(0), start_obj(obj) {}
+};
+
+
+obj_side_effects_t::thread_queue_t &obj_side_effects_t::get_queue() {
+	unsigned const thread_id(omp_get_thread_num_3dw());
+	assert(thread_id < queues.size());
+	return queues[thread_id];
+}
+void obj_side_effects_t::begin() {
+	assert(!active);
+	queues.resize(omp_get_max_threads_3dw());
+	++num_begins; // so that each parallel update of the same objects gets different random numbers
+	active = 1;
+}
+void obj_side_effects_t::apply_and_end() {
+	assert(active);
+	active = 0;
+
+	for (auto q = queues.begin(); q != queues.end(); ++q) { // apply in thread order
+		for (auto i = q->coll_regs.begin(); i != q->coll_regs.end(); ++i) {coll_objects.get_cobj(i->cindex).register_coll(i->coll_time, i->coll_type);}
+		
+		for (auto i = q->splashes.begin(); i != q->splashes.end(); ++i) {
+			draw_splash(i->pos.x, i->pos.y, i->water_z, i->draw_size);
+			if (i->energy > 0.0) {::add_splash(i->pos, i->xpos, i->ypos, i->energy, i->radius, (i->radius >= LARGE_OBJ_RAD));}
+		}
+		for (auto i = q->decals.begin(); i != q->decals.end(); ++i) {
+			::gen_decal(i->pos, i->radius, i->orient, i->tid, i->cid, i->color, i->is_glass, i->rand_angle, i->lifetime, i->min_dist_scale, i->tr);
+		}
+		for (auto i = q->sounds.begin(); i != q->sounds.end(); ++i) {::gen_sound(i->id, i->pos, i->gain, i->pitch);}
+		for (auto i = q->land_colors.begin(); i != q->land_colors.end(); ++i) {::add_color_to_landscape_texture(i->color, i->x, i->y, i->radius);}
+		q->clear();
+	} // for q
+}
+void obj_side_effects_t::thread_queue_t::set_marks() {
+	marks[0] = splashes.size(); marks[1] = coll_regs.size(); marks[2] = decals.size(); marks[3] = sounds.size(); marks[4] = land_colors.size();
+	obj_deferred = 0;
+}
+void obj_side_effects_t::thread_queue_t::drop_to_marks() {
+	splashes.erase   ((splashes.begin()    + marks[0]), splashes.end());
+	coll_regs.erase  ((coll_regs.begin()   + marks[1]), coll_regs.end());
+	decals.erase     ((decals.begin()      + marks[2]), decals.end());
+	sounds.erase     ((sounds.begin()      + marks[3]), sounds.end());
+	land_colors.erase((land_colors.begin() + marks[4]), land_colors.end());
+}
+void obj_side_effects_t::thread_queue_t::clear() {
+	splashes.clear(); coll_regs.clear(); decals.clear(); sounds.clear(); land_colors.clear();
+}
+void obj_side_effects_t::add_splash(point const &pos, int xpos, int ypos, float water_z, float draw_size, float energy, float radius) {
+	get_queue().splashes.emplace_back(pos, xpos, ypos, water_z, draw_size, energy, radius);
+}
+void obj_side_effects_t::register_coll(int cindex, unsigned char coll_time, unsigned char coll_type) {get_queue().coll_regs.emplace_back(cindex, coll_time, coll_type);}
+
+void obj_side_effects_t::gen_decal(point const &pos, float radius, vector3d const &orient, int tid, int cid, colorRGBA const &color,
+	bool is_glass, bool rand_angle, int lifetime, float min_dist_scale, tex_range_t const &tr)
+{
+	if (active) {get_queue().decals.emplace_back(pos, radius, orient, tid, cid, color, is_glass, rand_angle, lifetime, min_dist_scale, tr);}
+	else {::gen_decal(pos, radius, orient, tid, cid, color, is_glass, rand_angle, lifetime, min_dist_scale, tr);}
+}
+void obj_side_effects_t::gen_sound(unsigned id, point const &pos, float gain, float pitch) {
+	if (active) {get_queue().sounds.emplace_back(id, pos, gain, pitch);} else {::gen_sound(id, pos, gain, pitch);}
+}
+void obj_side_effects_t::add_color_to_landscape_texture(colorRGBA const &color, float xval, float yval, float radius) {
+	if (active) {get_queue().land_colors.emplace_back(color, xval, yval, radius);} else {::add_color_to_landscape_texture(color, xval, yval, radius);}
+}
+
+void obj_side_effects_t::begin_obj(unsigned obj_ix) {
+	assert(active);
+	thread_queue_t &q(get_queue());
+	q.rgen.set_state(obj_ix+1, num_begins);
+	q.set_marks();
+}
+bool obj_side_effects_t::end_obj() {
+	assert(active);
+	thread_queue_t &q(get_queue());
+	if (!q.obj_deferred) return 0;
+	q.drop_to_marks(); // the object will be advanced again serially, which will recreate these
+	return 1;
+}
+void obj_side_effects_t::defer_obj() {
+	assert(active);
+	get_queue().obj_deferred = 1;
+}
+int   obj_side_effects_t::rand_int()                              {return (active ? get_queue().rgen.rand() : rand());}
+float obj_side_effects_t::rand_uniform(float val1, float val2)    {return (active ? get_queue().rgen.rand_uniform(val1, val2) : ::rand_uniform(val1, val2));}
+float obj_side_effects_t::signed_rand_float()                     {return (active ? get_queue().rgen.signed_rand_float() : ::signed_rand_float());}
+
+
 void process_groups() {
 
 	if (animate2) {advance_physics_objects();}
@@ -324,6 +486,7 @@ void process_groups() {
 	unsigned num_objs(0);
 	static int camera_follow(0);
 	static unsigned scounter(0);
+	static vector<par_obj_t> par_objs;
 	int const lcf(camera_follow);
 	++scounter;
 	camera_follow = 0;
@@ -389,132 +552,19 @@ void process_groups() {
 		cobj_params cp(otype.elasticity, otype.color, reflective, 1, coll_func, -1, otype.tid, 1.0, 0, 0);
 		if (reflective) {cp.metalness = dodgeball_metalness; cp.tscale = 0.0; cp.color = WHITE; cp.spec_color = WHITE; cp.shine = 100.0;} // reflective metal sphere
 		size_t const iter_count((large_radius || type == MAT_SPHERE || app_rate > 0) ? max_objs : objg.end_id); // optimization to use end_id when valid
+		// small objects (precipitation, shrapnel, projectiles, etc.) have no cobjs and no collision function, and their side effects can be deferred,
+		// so they can be advanced in parallel; objects that hit a cobj with a collision function are rolled back and advanced serially;
+		// this is only enabled in ground mode, where collisions don't query city/building state
+		bool const parallel_advance(PARALLEL_OBJ_ADVANCE && !large_radius && coll_func == NULL && type != SMILEY && world_mode == WMODE_GROUND);
+		// small moving objects get static cobj candidates from a per-frame broadphase; large objects and smileys interact with dynamic state
+		bool const use_broadphase(!large_radius && type != SMILEY && world_mode == WMODE_GROUND && iter_count >= MIN_BROADPHASE_OBJS);
 		bool defer_remove_cobj(0);
+		par_objs.clear();
 
-		for (size_t jj = 0; jj < iter_count; ++jj) {
-			unsigned const j(unsigned((type == SMILEY) ? (jj + scounter)%max_objs : jj)); // handle smiley permutation
-			dwobject &obj(objg.get_obj(j));
-			point cobj_pos(all_zeros);
-			assert(!defer_remove_cobj); // prev iter should have handled this
-
-			if (large_radius && obj.coll_id >= 0) {
-				if (obj.status == OBJ_STAT_STOP && type != MAT_SPHERE && type != LANDMINE) { // stopped cobj
-					// defer removal of stopped dynamic spheres, with the hope that the location is the same and we can skip re-adding it as well
-					coll_obj const &cobj(coll_objects.get_cobj(obj.coll_id));
-					if (cobj.type == COLL_SPHERE && cobj.status == COLL_DYNAMIC && cobj.cp.cf_index == (int)j) {cobj_pos = cobj.points[0]; defer_remove_cobj = 1;}
-				}
-				if (!defer_remove_cobj) {remove_reset_coll_obj(obj.coll_id);}
-			}
-			if (obj.status == OBJ_STAT_RES) continue; // ignore
+		// the rest of the object update modifies shared state, so it runs serially in object order, including for objects advanced in parallel
+		auto const finish_obj([&](dwobject &obj, unsigned j, int orig_status, unsigned char obj_flags, point const &cobj_pos) {
 			point &pos(obj.pos);
 
-			if (obj.status == 0) {
-				if (type == MAT_SPHERE) {remove_mat_sphere(j);}
-				if (gen_count >= app_rate || !(flags & WAS_ADVANCED))      continue;
-				if (type == BALL && (game_mode != 2 || UNLIMITED_WEAPONS)) continue; // not in dodgeball mode
-				++gen_count;
-				if (precip && temperature >= WATER_MAX_TEMP) continue; // skip it
-				dwobject new_obj(def_objects[type]);
-				int const ret(objg.get_next_predef_obj(new_obj, j));
-				if (ret == 0) continue; // skip this object (no slots available)
-				obj = new_obj;
-				
-				if (ret == 1) { // use a predefined object
-					assert(type != SMILEY); // use an appearance spot for a smiley
-				}
-				else { // standard random generation
-					if (type == SMILEY) {
-						if (!gen_smiley_or_player_pos(pos, j)) {
-							if (!printed_ngsp_warning) cout << "No good smiley pos." << endl;
-							printed_ngsp_warning = 1;
-						}
-					}
-					else {
-						gen_object_pos(pos, otype.flags);
-						assert(!is_nan(pos));
-						vadd_rand(obj.velocity, 1.0);
-					}
-					if (type != SMILEY && (otype.flags & NO_FALL)) {pos.z = interpolate_mesh_zval(pos.x, pos.y, 0.0, 0, 0) + radius;}
-					if (type == POWERUP || type == WEAPON || type == AMMO) {obj.direction = (unsigned char)gen_game_obj(type);}
-				}
-				if (otype.flags & OBJ_IS_FLAT) {
-					obj.init_dir = signed_rand_vector_norm();
-					obj.angle    = signed_rand_float();
-				}
-				else if (otype.flags & OBJ_RAND_DIR_XY) {
-					obj.init_dir = vector3d(signed_rand_float(), signed_rand_float(), 0.0).get_norm();
-				}
-				if (type == SNOW) {obj.angle = rand_uniform(0.7, 1.3);} // used as radius
-			} // end obj.status == 0
-			if (precip) {obj.update_precip_type();}
-			unsigned char const obj_flags(obj.flags);
-			int const orig_status(obj.status);
-			obj.flags &= ~PLATFORM_COLL;
-			++used_objs;
-			++num_objs;
-
-			if (obj.health < 0.0) {obj.status = 0;} // can get here for smileys?
-			else if (type == SMILEY) {advance_smiley(obj, j);}
-			else {
-				if (obj.time >= 0) {
-					if (type == PLASMA && obj.velocity.mag_sq() < 1.0) {obj.disable();} // plasma dies when it stops
-					else {
-						if ((large_radius || type == STAR5) && type != KEYCARD) { // teleport large objects, except for keycards (so they don't get lost)
-							maybe_teleport_object(obj.pos, radius, NO_SOURCE, type, !large_radius); // teleport!
-							maybe_use_jump_pad(obj.pos, obj.velocity, radius, NO_SOURCE);
-						}
-						else if (type == BLOOD || type == CHARRED || type == SHRAPNEL || type == STAR5) {
-							maybe_teleport_object(obj.pos, radius, NO_SOURCE, type, 1);
-						}
-						point const old_pos(pos); // after teleporting
-						unsigned spf(1);
-						int cindex(-1);
-
-						// What about rolling objects (type_flags & OBJ_ROLLS) on the ground (status == 3)?
-						if (obj.status == 1 && is_over_mesh(pos) && !((obj_flags & XY_STOPPED) && (obj_flags & Z_STOPPED))) {
-							if (obj.flags & CAMERA_VIEW) {spf = 4*LG_STEPS_PER_FRAME;} // smaller timesteps if camera view
-							else if (type == PLASMA || type == BALL || type == SAWBLADE) {spf = 3*LG_STEPS_PER_FRAME;}
-							else if (is_rocket_type(type)) {spf = 2*LG_STEPS_PER_FRAME;}
-							else if (large_radius /*|| type == STAR5 || type == SHELLC*/ || type == FRAGMENT) {spf = LG_STEPS_PER_FRAME;}
-							else if (type == SHRAPNEL) {spf = max(1, min(((obj.direction == W_GRENADE) ? 4 : 20), int(0.2*obj.velocity.mag())));}
-							else if (type == PRECIP || (flags & PRECIPITATION)) {spf = 1;}
-							else {spf = SM_STEPS_PER_FRAME;}
-
-							if (MORE_COLL_TSTEPS && obj.status == 1 && spf < LG_STEPS_PER_FRAME && pos.z < czmax && pos.z > czmin) {
-								point pos2(pos + obj.velocity*time); // makes precipitation slower, but collision detection is more correct
-								pos2.z -= grav_dz; // maybe want to try with and without this?
-								// Note: we only do the line intersection test if the object moves by more than its radius this frame (static leaves don't)
-								// Note: could also test pos.z > v_collision_matrix[y][x].zmax
-								if (!dist_less_than(pos, pos2, radius)) {check_coll_line(pos, pos2, cindex, -1, 0, 0);} // return value is unused
-							}
-							assert(spf > 0);
-
-							if (spf > 1) {
-								assert(fticks > 0.0);
-								orig_timestep = TIMESTEP; // incremental multistep object advance
-								TIMESTEP     /= float(spf);
-								tstep         = TIMESTEP*fticks;
-								point const obj_pos(obj.pos);
-								
-								for (unsigned k = 0; k < spf; ++k) {
-									obj.advance_object(!recreated, k, j);
-									if (obj.status != 1)    break; // no longer airborne
-									if (obj.pos == obj_pos) break; // stopped
-								}
-								TIMESTEP = orig_timestep;
-								tstep    = time;
-							}
-						}
-						if (spf == 1) {obj.advance_object(!recreated, 0, j);}
-						obj.verify_data();
-						
-						if (!obj.disabled() && cindex >= 0 && !large_radius && spf < LG_STEPS_PER_FRAME) { // test collision with this cobj
-							object_line_coll(obj, old_pos, radius, j, cindex);
-						}
-					} // not plasma
-				} // obj.time < 0
-				else {obj.time = 0;}
-			} // not smiley
 			if (!obj.disabled()) {
 				update_deformation(obj);
 				
@@ -592,7 +642,119 @@ void process_groups() {
 			}
 			if (type == LANDMINE && obj.status == 1 && !(obj.flags & (STATIC_COBJ_COLL | PLATFORM_COLL))) {obj.time = 0;} // don't start time until it lands
 			if (defer_remove_cobj) {remove_reset_coll_obj(obj.coll_id); defer_remove_cobj = 0;}
+		});
+
+		if (use_broadphase && !parallel_advance) { // parallel objects are added below, after new objects are created
+			obj_broadphase.begin_group(&objg.get_obj(0), max_objs);
+
+			for (unsigned j = 0; j < iter_count; ++j) {
+				dwobject const &obj(objg.get_obj(j));
+				if (obj.status != 0 && !obj.disabled()) {obj_broadphase.add_obj(obj, j, radius, time, grav_dz);}
+			}
+			obj_broadphase.build();
+		}
+
+		for (size_t jj = 0; jj < iter_count; ++jj) {
+			unsigned const j(unsigned((type == SMILEY) ? (jj + scounter)%max_objs : jj)); // handle smiley permutation
+			dwobject &obj(objg.get_obj(j));
+			point cobj_pos(all_zeros);
+			assert(!defer_remove_cobj); // prev iter should have handled this
+
+			if (large_radius && obj.coll_id >= 0) {
+				if (obj.status == OBJ_STAT_STOP && type != MAT_SPHERE && type != LANDMINE) { // stopped cobj
+					// defer removal of stopped dynamic spheres, with the hope that the location is the same and we can skip re-adding it as well
+					coll_obj const &cobj(coll_objects.get_cobj(obj.coll_id));
+					if (cobj.type == COLL_SPHERE && cobj.status == COLL_DYNAMIC && cobj.cp.cf_index == (int)j) {cobj_pos = cobj.points[0]; defer_remove_cobj = 1;}
+				}
+				if (!defer_remove_cobj) {remove_reset_coll_obj(obj.coll_id);}
+			}
+			if (obj.status == OBJ_STAT_RES) continue; // ignore
+			point &pos(obj.pos);
+
+			if (obj.status == 0) {
+				if (type == MAT_SPHERE) {remove_mat_sphere(j);}
+				if (gen_count >= app_rate || !(flags & WAS_ADVANCED))      continue;
+				if (type == BALL && (game_mode != 2 || UNLIMITED_WEAPONS)) continue; // not in dodgeball mode
+				++gen_count;
+				if (precip && temperature >= WATER_MAX_TEMP) continue; // skip it
+				dwobject new_obj(def_objects[type]);
+				int const ret(objg.get_next_predef_obj(new_obj, j));
+				if (ret == 0) continue; // skip this object (no slots available)
+				obj = new_obj;
+				
+				if (ret == 1) { // use a predefined object
+					assert(type != SMILEY); // use an appearance spot for a smiley
+				}
+				else { // standard random generation
+					if (type == SMILEY) {
+						if (!gen_smiley_or_player_pos(pos, j)) {
+							if (!printed_ngsp_warning) cout << "No good smiley pos." << endl;
+							printed_ngsp_warning = 1;
+						}
+					}
+					else {
+						gen_object_pos(pos, otype.flags);
+						assert(!is_nan(pos));
+						vadd_rand(obj.velocity, 1.0);
+					}
+					if (type != SMILEY && (otype.flags & NO_FALL)) {pos.z = interpolate_mesh_zval(pos.x, pos.y, 0.0, 0, 0) + radius;}
+					if (type == POWERUP || type == WEAPON || type == AMMO) {obj.direction = (unsigned char)gen_game_obj(type);}
+				}
+				if (otype.flags & OBJ_IS_FLAT) {
+					obj.init_dir = signed_rand_vector_norm();
+					obj.angle    = signed_rand_float();
+				}
+				else if (otype.flags & OBJ_RAND_DIR_XY) {
+					obj.init_dir = vector3d(signed_rand_float(), signed_rand_float(), 0.0).get_norm();
+				}
+				if (type == SNOW) {obj.angle = rand_uniform(0.7, 1.3);} // used as radius
+			} // end obj.status == 0
+			if (precip) {obj.update_precip_type();}
+			unsigned char const obj_flags(obj.flags);
+			int const orig_status(obj.status);
+			obj.flags &= ~PLATFORM_COLL;
+			++used_objs;
+			++num_objs;
+
+			if (obj.health < 0.0) {obj.status = 0;} // can get here for smileys?
+			else if (type == SMILEY) {advance_smiley(obj, j);}
+			else if (parallel_advance) { // advanced below in parallel
+				par_objs.push_back(par_obj_t(j, orig_status, obj_flags, obj));
+				continue;
+			}
+			else {advance_dwobject(obj, j, type, radius, large_radius, flags, obj_flags, time, grav_dz);}
+			finish_obj(obj, j, orig_status, obj_flags, cobj_pos);
 		} // for jj
+		if (!par_objs.empty()) {
+			if (use_broadphase) {
+				obj_broadphase.begin_group(&objg.get_obj(0), max_objs);
+				for (auto i = par_objs.begin(); i != par_objs.end(); ++i) {obj_broadphase.add_obj(objg.get_obj(i->ix), i->ix, radius, time, grav_dz);}
+				obj_broadphase.build();
+			}
+			obj_side_effects.begin();
+			// static scheduling is required for deterministic side effect order; this is only deterministic because physics random numbers
+			// come from per-object generators
+#pragma omp parallel for schedule(static) if (par_objs.size() >= MIN_PAR_ADVANCE_OBJS)
+			for (int n = 0; n < (int)par_objs.size(); ++n) {
+				par_obj_t &po(par_objs[n]);
+				dwobject &obj(objg.get_obj(po.ix));
+				obj_side_effects.begin_obj(po.ix);
+				advance_dwobject(obj, po.ix, type, radius, large_radius, flags, po.obj_flags, time, grav_dz);
+				po.deferred = obj_side_effects.end_obj();
+			}
+			obj_side_effects.apply_and_end();
+
+			for (auto po = par_objs.begin(); po != par_objs.end(); ++po) {
+				dwobject &obj(objg.get_obj(po->ix));
+
+				if (po->deferred) { // hit a cobj with a collision function; restore and advance serially
+					obj = po->start_obj;
+					advance_dwobject(obj, po->ix, type, radius, large_radius, flags, po->obj_flags, time, grav_dz);
+				}
+				finish_obj(obj, po->ix, po->orig_status, po->obj_flags, all_zeros);
+			}
+		}
+		obj_broadphase.end_group();
 		objg.flags |= WAS_ADVANCED;
 		if (num_objs > 0 && (SHOW_PROC_TIME /*|| type == SMILEY*/)) {cout << "type = " << type << ", num = " << num_objs << " "; PRINT_TIME("Process");}
 	} // for i
@@ -699,6 +861,7 @@ void shift_point_vector(vector<point> &pts, vector3d const &vd) {
 
 void shift_all_cobjs(vector3d const &vd) {
 	for (unsigned i = 0; i < coll_objects.size(); ++i) {coll_objects[i].shift_by(vd);}
+	invalidate_moving_cobj_trees(); // moved in place
 }
 
 
@@ -808,6 +971,7 @@ void flag_cobjs_indoors_outdoors() {
 
 void coll_obj_group::clear_ids() {
 	dynamic_ids.clear();
+	clear_dynamic_log(1);
 	drawn_ids.clear();
 	platform_ids.clear();
 }
@@ -841,14 +1005,388 @@ void coll_obj_group::finalize() {
 }
 
 
+// binary cache of everything produced by parsing the scene file that's needed after loading: the finalized fixed cobjs (so that the CSG
+// preprocessing of finalize() is skipped as well), lights, and the model loads/transforms to replay; texture IDs are stored by name and
+// remapped on load; the cache is only used if the contents of the scene file, all of its includes and model files, and the config
+// files all match; scenes using commands with other side effects (trees, platforms, triggers, sounds, etc.) aren't cached
+struct scene_cache_writer_t {
+	ostream &out;
+	scene_cache_writer_t(ostream &out_) : out(out_) {}
+	template<typename T> void operator()(T const &v) {out.write((char const *)&v, sizeof(T));}
+	void operator()(string const &s) {operator()((unsigned)s.size()); out.write(s.data(), s.size());}
+};
+struct scene_cache_reader_t {
+	istream &in;
+	scene_cache_reader_t(istream &in_) : in(in_) {}
+	template<typename T> void operator()(T &v) {in.read((char *)&v, sizeof(T));}
+
+	void operator()(string &s) {
+		unsigned sz(0);
+		operator()(sz);
+		if (!in.good() || sz > MAX_CHARS*16) {in.setstate(ios::failbit); return;} // bad length
+		s.resize(sz);
+		in.read(&s[0], sz);
+	}
+};
+
+// visits each serialized field individually so that struct padding isn't hashed; coll_func and occluders are not included
+template<typename C, typename F> void xfer_cobj_fields(C &c, F &f) {
+	f(c.d); f(c.type); f(c.destroy); f(c.status); f(c.last_coll); f(c.coll_type); f(c.fixed); f(c.is_billboard); f(c.falling);
+	f(c.cp.tid); f(c.cp.shine); f(c.cp.color); f(c.cp.spec_color); f(c.cp.draw); f(c.cp.is_emissive); f(c.cp.swap_tcs); f(c.cp.cobj_type);
+	f(c.cp.elastic); f(c.cp.tscale); f(c.cp.tdx); f(c.cp.tdy); f(c.cp.refract_ix); f(c.cp.light_atten); f(c.cp.density); f(c.cp.metalness); f(c.cp.damage);
+	f(c.cp.normal_map); f(c.cp.cf_index); f(c.cp.surfs); f(c.cp.flags); f(c.cp.destroy_prob);
+	f(c.radius); f(c.radius2); f(c.thickness); f(c.volume); f(c.v_fall); f(c.counter); f(c.id);
+	f(c.platform_id); f(c.group_id); f(c.cgroup_id); f(c.dgroup_id); f(c.waypt_id); f(c.npoints); f(c.points); f(c.norm); f(c.texture_offset);
+}
+template<typename T, typename F> void xfer_cube_light(T &c, F &f) {f(c.bounds); f(c.color); f(c.intensity); f(c.num_rays); f(c.disabled_edges);}
+
+class scene_cache_t {
+
+	struct model_ref_t { // a model load or an operation on the current model, replayed in order on a cache hit
+		enum {LOAD=0, XFORM, SKY_LIGHTING, OCC_CUBE};
+		unsigned char op;
+		string fn; // LOAD, SKY_LIGHTING
+		geom_xform_t xf; // LOAD
+		model3d_xform_t model_xf; // XFORM
+		colorRGBA color; // LOAD
+		int tid, reflective, recalc_normals, group_cobjs_level; // LOAD
+		float metalness, weight; // LOAD, SKY_LIGHTING
+		unsigned sz[3]; // SKY_LIGHTING
+		bool write_file; // LOAD
+		cube_t cube; // OCC_CUBE
+
+		model_ref_t(unsigned char op_=LOAD) : op(op_), color(WHITE), tid(-1), reflective(0), recalc_normals(0), group_cobjs_level(0),
+			metalness(0.0), weight(0.0), write_file(0) {UNROLL_3X(sz[i_] = 0;)}
+
+		template<typename M, typename F> static void xfer_fields(M &m, F &f) { // op is read first, so this works for reading as well
+			f(m.op);
+
+			switch (m.op) {
+			case LOAD: f(m.fn); f(m.xf); f(m.color); f(m.tid); f(m.reflective); f(m.recalc_normals); f(m.group_cobjs_level); f(m.metalness); f(m.write_file); break;
+			case XFORM:        f(m.model_xf); break;
+			case SKY_LIGHTING: f(m.fn); f(m.weight); f(m.sz); break;
+			case OCC_CUBE:     f(m.cube); break;
+			}
+		}
+		void replay() {
+			switch (op) {
+			case LOAD:
+				if (!read_model_file(fn, nullptr, xf, tid, color, reflective, metalness, 1, recalc_normals, group_cobjs_level, write_file, 1)) {
+					cerr << "Error reading model file data from file " << fn << "; Model will be skipped" << endl;
+				}
+				break;
+			case XFORM:        add_transform_for_cur_model(model_xf); break;
+			case SKY_LIGHTING: set_sky_lighting_file_for_cur_model(fn, weight, sz); break;
+			case OCC_CUBE:     set_occlusion_cube_for_cur_model(cube); break;
+			default: assert(0);
+			}
+		}
+	};
+
+	struct scene_state_t { // sizes of the global containers that the scene file appends to
+		unsigned num_textures, lights_a, lights_d, sky_lights, global_lights, cobj_groups, draw_groups;
+
+		void set_to_current() {
+			num_textures  = textures.size();
+			lights_a      = light_sources_a.size();
+			lights_d      = light_sources_d.size();
+			sky_lights    = sky_cube_lights.size();
+			global_lights = global_cube_lights.size();
+			cobj_groups   = ::cobj_groups.size();
+			draw_groups   = obj_draw_groups.size();
+		}
+		template<typename S, typename F> static void xfer_fields(S &s, F &f) {
+			f(s.num_textures); f(s.lights_a); f(s.lights_d); f(s.sky_lights); f(s.global_lights); f(s.cobj_groups); f(s.draw_groups);
+		}
+		bool operator==(scene_state_t const &s) const {
+			return (num_textures == s.num_textures && lights_a == s.lights_a && lights_d == s.lights_d && sky_lights == s.sky_lights &&
+				global_lights == s.global_lights && cobj_groups == s.cobj_groups && draw_groups == s.draw_groups);
+		}
+	};
+
+	bool recording, cacheable;
+	scene_state_t start_state;
+	vector<pair<string, uint64_t>> deps; // {filename, hash of contents}; the first entry is the scene file
+	vector<model_ref_t> model_refs;
+
+	static uint64_t get_config_hash() {
+		fnv1a_hasher_t hasher;
+		hasher(SCENE_CACHE_VERSION);
+		hasher(config_files_hasher.get());
+		hasher(preproc_cube_cobjs); // may be changed outside of the config files
+		hasher(use_voxel_cobjs);
+		return hasher.get();
+	}
+	static uint64_t hash_file(string const &fn, bool &success) {
+		fnv1a_hasher_t hasher;
+		FILE *fp(fopen(fn.c_str(), "rb"));
+		success = (fp != nullptr);
+		if (success) {hash_file_contents(fp, hasher); fclose(fp);}
+		return hasher.get();
+	}
+	static bool is_cacheable_keyword(string const &keyword) {
+		// long name aliases are checked by their single character commands instead
+		static char const *const keywords[] = {"cube", "sphere", "cylinder", "capsule", "polygon", "torus", "trigger", "platform", "light", "bind_light",
+			"indir_dlight_group", "movable", "end", "teleporter", "density", "tj", "reflective", "cube_map_ref", "metalness", "damage", "start_cobj_group",
+			"end_cobj_group", "end_draw_group", "destroy_prob", "transform_array_1d", "transform_array_2d", "lighting_file_sky_model",
+			"model_occlusion_cube", "cube_light", "light_rotate", "dynamic_indir", "outdoor_shadows"};
+		for (unsigned i = 0; i < sizeof(keywords)/sizeof(keywords[0]); ++i) {if (keyword == keywords[i]) return 1;}
+		return 0;
+	}
+	void block(string const &reason) {
+		if (!recording || !cacheable) return;
+		cout << "Scene can't be cached because it uses " << reason << endl;
+		cacheable = 0;
+	}
+	void add_model_ref(model_ref_t const &m) {if (recording) {model_refs.push_back(m);}}
+
+public:
+	scene_cache_t() : recording(0), cacheable(0) {}
+
+	void begin_recording() {
+		recording = 1;
+		cacheable = 1;
+		start_state.set_to_current();
+		deps.clear();
+		model_refs.clear();
+		if (!fixed_cobjs.empty()) {block("cobjs added before the scene file");}
+	}
+	void end_recording() {recording = 0;}
+
+	// scene file parsing hooks
+	void add_dep(string const &fn, FILE *fp) {
+		if (!recording) return;
+		fnv1a_hasher_t hasher;
+		hash_file_contents(fp, hasher);
+		deps.emplace_back(fn, hasher.get());
+	}
+	void add_dep(string const &fn) {
+		if (!recording) return;
+		bool success(0);
+		uint64_t const hash(hash_file(fn, success));
+		if (success) {deps.emplace_back(fn, hash);} else {block("unreadable file " + fn);}
+	}
+	void check_cmd(int letter) {
+		if (!recording || is_EOF(letter) || isspace(letter)) return;
+		if (strchr("#iOZQgLVbeBSCkzPcDljJXrtTmMsRyYnadvq", letter) == nullptr) {block(string("command '") + char(letter) + "'");}
+	}
+	void check_keyword(string const &keyword) {
+		if (recording && !is_cacheable_keyword(keyword)) {block("keyword '" + keyword + "'");}
+	}
+	void check_platform() {block("platforms");}
+
+	void add_model_load(string const &fn, geom_xform_t const &xf, int tid, colorRGBA const &color, int reflective, float metalness,
+		bool load_models, int recalc_normals, int group_cobjs_level, bool write_file)
+	{
+		add_dep(fn);
+		if (!load_models) return; // only used for cobjs, which are cached
+		model_ref_t m(model_ref_t::LOAD);
+		m.fn = fn; m.xf = xf; m.tid = tid; m.color = color; m.reflective = reflective; m.metalness = metalness;
+		m.recalc_normals = recalc_normals; m.group_cobjs_level = group_cobjs_level; m.write_file = write_file;
+		add_model_ref(m);
+	}
+	void add_model_xform(model3d_xform_t const &xf) {
+		model_ref_t m(model_ref_t::XFORM);
+		m.model_xf = xf;
+		add_model_ref(m);
+	}
+	void add_model_sky_lighting(string const &fn, float weight, unsigned const sz[3]) {
+		model_ref_t m(model_ref_t::SKY_LIGHTING);
+		m.fn = fn; m.weight = weight;
+		UNROLL_3X(m.sz[i_] = sz[i_];)
+		add_model_ref(m);
+	}
+	void add_model_occlusion_cube(cube_t const &cube) {
+		model_ref_t m(model_ref_t::OCC_CUBE);
+		m.cube = cube;
+		add_model_ref(m);
+	}
+
+	bool write(coll_obj_group const &cobjs, string const &fn) const;
+	bool read(coll_obj_group &cobjs, string const &fn, string const &scene_fn);
+	bool can_write(coll_obj_group const &cobjs) const;
+};
+
+scene_cache_t scene_cache;
+
+
+bool scene_cache_t::can_write(coll_obj_group const &cobjs) const {
+
+	if (!cacheable || deps.empty()) return 0;
+
+	for (auto c = cobjs.begin(); c != cobjs.end(); ++c) {
+		if (c->cp.coll_func != nullptr || !c->occluders.empty()) return 0; // can't be cached
+	}
+	return 1;
+}
+
+bool scene_cache_t::write(coll_obj_group const &cobjs, string const &fn) const {
+
+	ofstream out(fn, ios::out | ios::binary);
+	if (!out.good()) {cerr << "Error opening scene cache file " << fn << " for write" << endl; return 0;}
+	cout << "Writing " << cobjs.size() << " cobjs to scene cache file " << fn << endl;
+	scene_cache_writer_t w(out);
+	w(SCENE_CACHE_MAGIC); w(SCENE_CACHE_VERSION); w(get_config_hash());
+	w((unsigned)deps.size());
+	for (auto d = deps.begin(); d != deps.end(); ++d) {w(d->first); w(d->second);}
+	scene_state_t::xfer_fields(start_state, w);
+	// texture table: names of all textures loaded by the scene, which may get different IDs on the next run
+	vector<int> tids;
+	auto const add_tid([&](int tid) {if (tid >= (int)start_state.num_textures) {tids.push_back(tid);}});
+
+	for (auto c = cobjs.begin(); c != cobjs.end(); ++c) {add_tid(c->cp.tid); add_tid(c->cp.normal_map);}
+	for (auto m = model_refs.begin(); m != model_refs.end(); ++m) {add_tid(m->tid); add_tid(m->model_xf.material.tid);}
+	sort(tids.begin(), tids.end());
+	tids.erase(unique(tids.begin(), tids.end()), tids.end());
+	w((unsigned)tids.size());
+
+	for (auto t = tids.begin(); t != tids.end(); ++t) {
+		assert((unsigned)*t < textures.size());
+		texture_t const &tex(textures[*t]);
+		w(*t); w(tex.name); w(tex.normal_map); w(tex.invert_y);
+	}
+	w(cobjs.has_lt_atten); w(cobjs.has_voxel_cobjs); w((unsigned)cobjs.size());
+	for (auto c = cobjs.begin(); c != cobjs.end(); ++c) {xfer_cobj_fields(*c, w);}
+	// Note: triggers and sensors aren't written, but scenes that use them aren't cached
+	w(unsigned(light_sources_a.size() - start_state.lights_a));
+	for (auto l = light_sources_a.begin() + start_state.lights_a; l != light_sources_a.end(); ++l) {light_source::xfer_fields(*l, w);}
+	w(unsigned(light_sources_d.size() - start_state.lights_d));
+	for (auto l = light_sources_d.begin() + start_state.lights_d; l != light_sources_d.end(); ++l) {light_source_trig::xfer_fields(*l, w);}
+	w(unsigned(sky_cube_lights.size() - start_state.sky_lights));
+	for (auto l = sky_cube_lights.begin() + start_state.sky_lights; l != sky_cube_lights.end(); ++l) {xfer_cube_light(*l, w);}
+	w(unsigned(global_cube_lights.size() - start_state.global_lights));
+	for (auto l = global_cube_lights.begin() + start_state.global_lights; l != global_cube_lights.end(); ++l) {xfer_cube_light(*l, w);}
+	w(unsigned(cobj_groups.size() - start_state.cobj_groups));
+	w(unsigned(obj_draw_groups.size() - start_state.draw_groups));
+	for (auto g = obj_draw_groups.begin() + start_state.draw_groups; g != obj_draw_groups.end(); ++g) {w(g->vbo_enabled());}
+	w(using_model_bcube);
+	w((unsigned)model_refs.size());
+	for (auto m = model_refs.begin(); m != model_refs.end(); ++m) {model_ref_t::xfer_fields(*m, w);}
+	w(SCENE_CACHE_MAGIC);
+	if (!out.good()) {cerr << "Error writing scene cache file " << fn << endl; return 0;}
+	return 1;
+}
+
+// on success, cobjs and the global scene state are set up as if scene_fn had been read and cobjs had been finalized
+bool scene_cache_t::read(coll_obj_group &cobjs, string const &fn, string const &scene_fn) {
+
+	ifstream in(fn, ios::in | ios::binary);
+	if (!in.good()) return 0; // no cache yet, not an error
+	scene_cache_reader_t r(in);
+	unsigned magic(0), version(0), num(0);
+	uint64_t config_hash(0);
+	r(magic); r(version); r(config_hash); r(num);
+	if (!in.good() || magic != SCENE_CACHE_MAGIC || version != SCENE_CACHE_VERSION || config_hash != get_config_hash() || num == 0) return 0; // stale
+
+	for (unsigned i = 0; i < num; ++i) { // check that the scene file, its includes, and model files are unchanged
+		string dep_fn;
+		uint64_t hash(0);
+		r(dep_fn); r(hash);
+		if (!in.good() || (i == 0 && dep_fn != scene_fn)) return 0; // different scene
+		bool success(0);
+		if (hash_file(dep_fn, success) != hash || !success) {cout << "Scene cache file " << fn << " is stale: " << dep_fn << " has changed" << endl; return 0;}
+	}
+	scene_state_t state, cur_state;
+	scene_state_t::xfer_fields(state, r);
+	cur_state.set_to_current();
+	if (!in.good() || !(state == cur_state)) return 0; // something else was loaded before the scene
+	struct tex_ref_t {int tid=-1; string name; bool normal_map=0, invert_y=0;};
+	r(num);
+	if (!in.good()) return 0;
+	vector<tex_ref_t> tex_refs(num);
+	for (auto t = tex_refs.begin(); t != tex_refs.end(); ++t) {r(t->tid); r(t->name); r(t->normal_map); r(t->invert_y);}
+	coll_obj_group loaded;
+	r(loaded.has_lt_atten); r(loaded.has_voxel_cobjs); r(num);
+	if (!in.good()) return 0;
+	loaded.resize(num);
+	for (auto c = loaded.begin(); c != loaded.end(); ++c) {xfer_cobj_fields(*c, r);}
+	vector<light_source> lights_a;
+	vector<light_source_trig> lights_d;
+	vector<cube_light_src> sky_lights, global_lights;
+	r(num); if (!in.good()) return 0;
+	lights_a.resize(num);
+	for (auto l = lights_a.begin(); l != lights_a.end(); ++l) {light_source::xfer_fields(*l, r);}
+	r(num); if (!in.good()) return 0;
+	lights_d.resize(num);
+	for (auto l = lights_d.begin(); l != lights_d.end(); ++l) {light_source_trig::xfer_fields(*l, r);}
+	r(num); if (!in.good()) return 0;
+	sky_lights.resize(num);
+	for (auto l = sky_lights.begin(); l != sky_lights.end(); ++l) {xfer_cube_light(*l, r);}
+	r(num); if (!in.good()) return 0;
+	global_lights.resize(num);
+	for (auto l = global_lights.begin(); l != global_lights.end(); ++l) {xfer_cube_light(*l, r);}
+	unsigned num_cobj_groups(0);
+	bool model_bcube(0);
+	r(num_cobj_groups); r(num);
+	if (!in.good()) return 0;
+	vector<bool> draw_group_vbos(num);
+	for (unsigned i = 0; i < num; ++i) {bool v(0); r(v); draw_group_vbos[i] = v;}
+	r(model_bcube); r(num);
+	if (!in.good()) return 0;
+	vector<model_ref_t> models(num);
+
+	for (auto m = models.begin(); m != models.end(); ++m) {
+		model_ref_t::xfer_fields(*m, r);
+		if (m->op > model_ref_t::OCC_CUBE) return 0; // bad data
+	}
+	r(magic); // trailing magic number detects truncation
+
+	if (!in.good() || magic != SCENE_CACHE_MAGIC) {
+		cerr << "Error reading scene cache file " << fn << "; ignoring it" << endl;
+		return 0;
+	}
+	// everything was read; now apply it to the scene
+	map<int, int> tid_map;
+	for (auto t = tex_refs.begin(); t != tex_refs.end(); ++t) {tid_map[t->tid] = get_texture_by_name(t->name, t->normal_map, t->invert_y);}
+
+	auto const remap_tid([&](int &tid) {
+		if (tid < (int)state.num_textures) return; // predefined texture
+		auto const it(tid_map.find(tid));
+		tid = ((it == tid_map.end()) ? -1 : it->second);
+	});
+	for (auto c = loaded.begin(); c != loaded.end(); ++c) {
+		remap_tid(c->cp.tid);
+		remap_tid(c->cp.normal_map);
+		if (c->cp.tid >= 0 && c->cp.normal_map >= 0) {textures[c->cp.tid].maybe_assign_normal_map_tid(c->cp.normal_map);} // as in add_to_vector()
+	}
+	cout << "Read " << loaded.size() << " cobjs from scene cache file " << fn << endl;
+	cobjs.swap(loaded);
+	light_sources_a.insert(light_sources_a.end(), lights_a.begin(), lights_a.end());
+
+	for (auto l = lights_d.begin(); l != lights_d.end(); ++l) {
+		indir_dlight_group_manager.add_dlight_ix_for_tag_ix(l->get_indir_dlight_ix(), light_sources_d.size());
+		light_sources_d.push_back(*l);
+	}
+	sky_cube_lights.insert(sky_cube_lights.end(), sky_lights.begin(), sky_lights.end());
+	global_cube_lights.insert(global_cube_lights.end(), global_lights.begin(), global_lights.end());
+	for (unsigned i = 0; i < num_cobj_groups; ++i) {cobj_groups.new_group();}
+	for (unsigned i = 0; i < draw_group_vbos.size(); ++i) {obj_draw_groups.push_back(obj_draw_group(draw_group_vbos[i]));}
+	using_model_bcube |= model_bcube;
+
+	for (auto m = models.begin(); m != models.end(); ++m) {
+		remap_tid(m->tid);
+		remap_tid(m->model_xf.material.tid);
+		m->replay();
+	}
+	return 1;
+}
+
+void finalize_with_scene_cache(coll_obj_group &cobjs, string const &fn) {
+
+	RESET_TIME;
+	cobjs.finalize();
+	PRINT_TIME(" Finalize Cobjs");
+	if (!fn.empty() && scene_cache.can_write(cobjs)) {scene_cache.write(cobjs, fn);}
+}
+
+
 void add_all_coll_objects(const char *filename, bool re_add) {
 
 	static int init(0);
 
 	if (!init) {
 		if (load_coll_objs) {
-			if (!read_coll_objects(filename)) {exit(1);}
-			fixed_cobjs.finalize();
+			if (!read_coll_objects(filename)) {exit(1);} // and finalize
 			bool const has_voxel_cobjs(gen_voxels_from_cobjs(fixed_cobjs));
 			unsigned const ncobjs(fixed_cobjs.size());
 			RESET_TIME;
@@ -1141,6 +1679,7 @@ string add_loaded_model(vector<coll_tquad> const &ppts, coll_obj cobj, float sca
 int add_model_transform(FILE *fp, model3d_xform_t const &model_xf, vector<coll_tquad> &ppts, coll_obj const &cobj, float scale, bool has_layer) {
 
 	if (!add_transform_for_cur_model(model_xf)) {return read_error(fp, "model transform", coll_obj_file);}
+	scene_cache.add_model_xform(model_xf);
 	bool const no_cobjs(model_xf.group_cobjs_level >= 4);
 	if (!no_cobjs) {get_cur_model_polygons(ppts, model_xf);} // add cobjs for collision detection
 	string const error_str(add_loaded_model(ppts, cobj, scale, has_layer, model_xf));
@@ -1181,6 +1720,19 @@ unsigned read_cube(FILE *fp, geom_xform_t const &xf, cube_t &c) {
 	return 6;
 }
 
+void hash_file_contents(FILE *fp, fnv1a_hasher_t &hasher) {
+
+	char buf[4096];
+	size_t num_read(0), tot_size(0);
+
+	while ((num_read = fread(buf, 1, sizeof(buf), fp)) > 0) {
+		hasher.add_bytes(buf, num_read);
+		tot_size += num_read;
+	}
+	hasher(tot_size); // so that concatenated files hash differently
+	rewind(fp);
+}
+
 bool read_block_comment(FILE *fp) {
 
 	while (1) {
@@ -1203,6 +1755,7 @@ int read_coll_obj_file(const char *coll_obj_file, geom_xform_t xf, coll_obj cobj
 	assert(coll_obj_file != NULL);
 	FILE *fp;
 	if (!open_file(fp, coll_obj_file, "collision object")) return 0;
+	scene_cache.add_dep(coll_obj_file, fp);
 	char str[MAX_CHARS] = {0};
 	unsigned line_num(1), npoints(0), indir_dlight_ix(0), prev_light_ix_start(0);
 	int end(0), use_z(0), use_vel(0), ivals[3];
@@ -1237,6 +1790,7 @@ int read_coll_obj_file(const char *coll_obj_file, geom_xform_t xf, coll_obj cobj
 				keyword.push_back(letter);
 				letter = next_letter;
 				while (!is_end_of_string(letter)) {keyword.push_back(letter); letter = getc(fp);}
+				scene_cache.check_keyword(keyword);
 
 				if (0) {}
 				// long name aliases remapped to single character
@@ -1338,11 +1892,13 @@ int read_coll_obj_file(const char *coll_obj_file, geom_xform_t xf, coll_obj cobj
 					float weight(0.0);
 					if (fscanf(fp, "%255s%u%u%u%f", str, &sz[0], &sz[1], &sz[2], &weight) != 5) {return read_error(fp, keyword, coll_obj_file);}
 					set_sky_lighting_file_for_cur_model(str, weight, sz);
+					scene_cache.add_model_sky_lighting(str, weight, sz);
 				}
 				else if (keyword == "model_occlusion_cube") { // Note: in local model space, so tr
 					cube_t cube;
 					if (!read_cube(fp, geom_xform_t(), cube)) {return read_error(fp, keyword, coll_obj_file);}
 					set_occlusion_cube_for_cur_model(cube);
+					scene_cache.add_model_occlusion_cube(cube);
 				}
 				else if (keyword == "cube_light") { // ambient/precomputed light only
 					cube_t cube; // x1 y1 x2 y2 z1 z2 size color
@@ -1411,6 +1967,8 @@ int read_coll_obj_file(const char *coll_obj_file, geom_xform_t xf, coll_obj cobj
 				}
 			}
 		}
+		scene_cache.check_cmd(letter);
+
 		switch (letter) {
 		case 0:
 		case EOF:
@@ -1459,6 +2017,8 @@ int read_coll_obj_file(const char *coll_obj_file, geom_xform_t xf, coll_obj cobj
 					skip_cur_model = 1;
 					break;
 				}
+				scene_cache.add_model_load(fn, xf, cobj.cp.tid, cobj.cp.color, reflective, cobj.cp.metalness, use_model3d, recalc_normals,
+					model_xf2.group_cobjs_level, (write_file != 0));
 				string const error_str(add_loaded_model(ppts, cobj, xf.scale, has_layer, model_xf2));
 				if (!error_str.empty()) {return read_error(fp, error_str.c_str(), coll_obj_file);}
 				skip_cur_model = 0;
@@ -1488,6 +2048,7 @@ int read_coll_obj_file(const char *coll_obj_file, geom_xform_t xf, coll_obj cobj
 				cobj.platform_id = -1;
 			}
 			else {
+				scene_cache.check_platform();
 				cobj.platform_id = (short)platforms.size();
 				if (!platforms.add_from_file(fp, xf, triggers, cur_sensor)) {return read_error(fp, "platform", coll_obj_file);}
 				assert(cobj.platform_id < (int)platforms.size());
@@ -2079,16 +2640,29 @@ int read_coll_obj_file(const char *coll_obj_file, geom_xform_t xf, coll_obj cobj
 	return 1;
 }
 
+// reads and finalizes fixed_cobjs, either from the scene file or from the scene cache
 int read_coll_objects(const char *filename) {
 
-	geom_xform_t xf;
-	coll_obj cobj;
-	cobj.init();
-	cobj.cp.elastic = 0.5; // default
-	cobj.cp.draw    = 1;   // default
-	if (EXPLODE_EVERYTHING) {cobj.destroy = EXPLODEABLE;}
-	if (use_voxel_cobjs) {cobj.cp.cobj_type = COBJ_TYPE_VOX_TERRAIN;}
-	if (!read_coll_obj_file(filename, xf, cobj, 0, WHITE)) return 0;
+	RESET_TIME;
+
+	if (!scene_cache_fn.empty() && scene_cache.read(fixed_cobjs, scene_cache_fn, filename)) {
+		PRINT_TIME(" Read Scene Cache");
+	}
+	else {
+		geom_xform_t xf;
+		coll_obj cobj;
+		cobj.init();
+		cobj.cp.elastic = 0.5; // default
+		cobj.cp.draw    = 1;   // default
+		if (EXPLODE_EVERYTHING) {cobj.destroy = EXPLODEABLE;}
+		if (use_voxel_cobjs) {cobj.cp.cobj_type = COBJ_TYPE_VOX_TERRAIN;}
+		if (!scene_cache_fn.empty()) {scene_cache.begin_recording();}
+		bool const success(read_coll_obj_file(filename, xf, cobj, 0, WHITE) != 0);
+		scene_cache.end_recording();
+		if (!success) return 0;
+		PRINT_TIME(" Read Scene File");
+		finalize_with_scene_cache(fixed_cobjs, scene_cache_fn);
+	}
 	if (num_keycards > 0) {obj_groups[coll_id[KEYCARD]].enable();}
 	if (has_scenery2) {gen_scenery();} // need to call post_gen_setup() for leafy plants
 	cube_t const model_bcube(calc_and_return_all_models_bcube()); // calculate even if not using; will force internal transform bcubes to be calculated
@@ -6,16 +6,23 @@
 #include "buildings.h"
 #include "lightmap.h" // for light_source
 #include "cobj_bsp_tree.h"
+#include "binary_file_io.h"
 #include <thread>
 
 bool const USE_BKG_THREAD = 1;
+unsigned const BLDG_INDIR_NUM_PASSES = 4; // one coarse pass + refinement passes, each doubling the number of rays per light
+unsigned const NUM_PRI_SPLITS = 16;
+unsigned const BLDG_INDIR_MEM_CACHE_SIZE = 8; // max number of lighting volumes cached in memory
+unsigned const BLDG_INDIR_CACHE_MAGIC    = 0xB1D11947;
+unsigned const BLDG_INDIR_CACHE_VERSION  = 1; // increment when the lighting computation changes
 
 extern int MESH_Z_SIZE, display_mode, display_framerate, camera_surf_collide, animate2;
 extern unsigned LOCAL_RAYS, MAX_RAY_BOUNCES, NUM_THREADS;
-extern float indir_light_exp;
-extern std::string lighting_update_text;
+extern float indir_light_exp, ray_step_size_mult, light_int_scale[];
+extern std::string lighting_update_text, building_indir_cache_dir;
 extern building_dest_t cur_player_building_loc;
 extern vector<light_source> dl_sources;
+extern building_params_t global_building_params;
 
 bool enable_building_people_ai();
 
@@ -159,37 +166,238 @@ void building_t::gather_interior_cubes(vect_colored_cube_t &cc) const {
 }
 
 
+unsigned get_num_pri_rays_per_light() {return max(1U, LOCAL_RAYS/NUM_PRI_SPLITS);}
+unsigned get_pass_end_ray  (unsigned pass) {return max(1U, (get_num_pri_rays_per_light() >> (BLDG_INDIR_NUM_PASSES - pass - 1)));}
+unsigned get_pass_start_ray(unsigned pass) {return ((pass == 0) ? 0 : get_pass_end_ray(pass-1));}
+
+
+// local light accumulation grid sized and aligned to a building's bcube with near cubic cells; stored {Y,X,Z} to match the 3D texture layout
+class building_light_volume_t {
+	unsigned sz[3];
+	float step_sz, weight_scale;
+	cube_t bcube;
+	vector3d cell_sz_inv;
+	vector<lmcell_local> data;
+	vector<unsigned char> dirty_y; // per Y slab, for incremental texture updates
+
+	unsigned get_ix(unsigned x, unsigned y, unsigned z) const {return ((y*sz[0] + x)*sz[2] + z);}
+public:
+	building_light_volume_t() : step_sz(0.0), weight_scale(1.0) {UNROLL_3X(sz[i_] = 0;)}
+	bool is_allocated() const {return !data.empty();}
+	float get_avg_cell_xy_size() const {return (is_allocated() ? 0.5f*(bcube.dx()/sz[0] + bcube.dy()/sz[1]) : 0.0f);}
+
+	void init(cube_t const &bcube_, unsigned max_res) {
+		bcube = bcube_;
+		vector3d const bsz(bcube.get_size()), ref_cell_sz(bsz.x/MESH_X_SIZE, bsz.y/MESH_Y_SIZE, bsz.z/MESH_SIZE[2]);
+		float const cell_sz(max(bsz.x, max(bsz.y, bsz.z))/max(max_res, 2U));
+		vector3d csz;
+
+		for (unsigned d = 0; d < 3; ++d) {
+			sz[d]  = max(2U, min(max_res, unsigned(ceil(bsz[d]/cell_sz))));
+			csz[d] = bsz[d]/sz[d];
+			cell_sz_inv[d] = 1.0/csz[d];
+		}
+		step_sz = 0.3f*ray_step_size_mult*(csz.x + csz.y + csz.z); // same steps per cell as add_path_to_lmcs()
+		// the number of rays crossing a cell scales with its cross section area; normalize to the scene lighting grid cells this used to be stretched over
+		weight_scale = pow((ref_cell_sz.x*ref_cell_sz.y*ref_cell_sz.z)/(csz.x*csz.y*csz.z), 2.0f/3.0f);
+		reset();
+	}
+	void reset() {
+		data.clear();
+		data.resize(sz[0]*sz[1]*sz[2]); // all zeros
+		dirty_y.clear();
+		dirty_y.resize(sz[1], 0);
+	}
+	void clear() {
+		UNROLL_3X(sz[i_] = 0;)
+		data.clear();
+		dirty_y.clear();
+	}
+	void add_path(point p1, point const &p2, float weight, colorRGBA const &color) { // p1 and p2 in building space
+		// Note: not thread safe, but any races only drop a small amount of light (see add_path_to_lmcs())
+		colorRGBA const cw(color*(weight*weight_scale*ray_step_size_mult));
+		unsigned const nsteps(1 + unsigned(p2p_dist(p1, p2)/step_sz)); // round up (dist can be 0)
+		vector3d const step((p2 - p1)/nsteps);
+		p1 += step; // move past the first step so we don't double count
+
+		for (unsigned s = 0; s < nsteps; ++s, p1 += step) {
+			int ix[3];
+			UNROLL_3X(ix[i_] = int(floor((p1[i_] - bcube.d[i_][0])*cell_sz_inv[i_]));)
+			if (ix[0] < 0 || ix[1] < 0 || ix[2] < 0 || ix[0] >= (int)sz[0] || ix[1] >= (int)sz[1] || ix[2] >= (int)sz[2]) continue; // outside the building
+			float *const lc(data[get_ix(ix[0], ix[1], ix[2])].lc);
+			ADD_LIGHT_CONTRIB(cw, lc);
+			dirty_y[ix[1]] = 1;
+		}
+	}
+	bool write(binary_file_writer &w, uint64_t key) const {
+		return (w.write(&BLDG_INDIR_CACHE_MAGIC, sizeof(unsigned), 1) && w.write(&key, sizeof(uint64_t), 1) && w.write(sz, sizeof(unsigned), 3) &&
+			w.write(data.data(), sizeof(lmcell_local), data.size()) && w.write(&BLDG_INDIR_CACHE_MAGIC, sizeof(unsigned), 1));
+	}
+	bool read(binary_file_reader &r, uint64_t key) { // must already be initialized to the building's size
+		unsigned magic(0), fsz[3] = {0,0,0};
+		uint64_t fkey(0);
+		if (!r.read(&magic, sizeof(unsigned), 1) || !r.read(&fkey, sizeof(uint64_t), 1) || !r.read(fsz, sizeof(unsigned), 3)) return 0;
+		if (magic != BLDG_INDIR_CACHE_MAGIC || fkey != key || fsz[0] != sz[0] || fsz[1] != sz[1] || fsz[2] != sz[2]) return 0; // stale or wrong file
+		if (!r.read(data.data(), sizeof(lmcell_local), data.size()) || !r.read(&magic, sizeof(unsigned), 1)) return 0;
+		return (magic == BLDG_INDIR_CACHE_MAGIC); // trailing magic number detects truncation
+	}
+	void blend_with(building_light_volume_t const &v, float weight, float v_weight) { // this = this*weight + v*v_weight
+		assert(v.data.size() == data.size());
+
+		for (unsigned i = 0; i < data.size(); ++i) {
+			UNROLL_3X(data[i].lc[i_] = weight*data[i].lc[i_] + v_weight*v.data[i].lc[i_];)
+		}
+	}
+	void update_texture(unsigned &tid, vector<unsigned char> &tex_data, float lighting_exponent, bool full_update) {
+		// convert and upload the range of Y slabs that changed; a full update takes a few ms for a large building
+		int y1(sz[1]), y2(-1);
+
+		for (unsigned y = 0; y < sz[1]; ++y) {
+			if (full_update || dirty_y[y]) {y1 = min(y1, (int)y); y2 = y;}
+			dirty_y[y] = 0;
+		}
+		if (tid == 0) {y1 = 0; y2 = sz[1]-1;} // must create the entire texture
+		if (y2 < y1) return; // no updates
+		bool const apply_sqrt(lighting_exponent > 0.49 && lighting_exponent < 0.51), apply_exp(!apply_sqrt && lighting_exponent != 1.0);
+		float const lscale(light_int_scale[LIGHTING_LOCAL]);
+		unsigned const slab_sz(sz[0]*sz[2]);
+		tex_data.resize(4*data.size(), 0);
+
+#pragma omp parallel for schedule(static) if ((y2 - y1) > 4)
+		for (int y = y1; y <= y2; ++y) {
+			for (unsigned i = y*slab_sz; i < (y+1)*slab_sz; ++i) {
+				colorRGB color;
+				UNROLL_3X(color[i_] = min(1.0f, lscale*data[i].lc[i_]);) // see lmcell::get_final_color_local()
+				if      (apply_sqrt) {UNROLL_3X(color[i_] = sqrt(color[i_]););}
+				else if (apply_exp)  {UNROLL_3X(color[i_] = pow(color[i_], lighting_exponent););}
+				UNROLL_3X(tex_data[4*i+i_] = (unsigned char)(255*CLIP_TO_01(color[i_]));)
+			}
+		}
+		if (tid == 0) {tid = create_3d_texture(sz[2], sz[0], sz[1], 4, tex_data, GL_LINEAR, GL_CLAMP_TO_EDGE);} // stored {Z,X,Y}
+		else {update_3d_texture(tid, 0, 0, y1, sz[2], sz[0], (y2 - y1 + 1), 4, (tex_data.data() + 4*y1*slab_sz));}
+	}
+};
+
+
+// in-memory LRU cache of completed building lighting volumes, backed by an optional directory of gzipped files that persists across sessions
+class building_indir_cache_t {
+	deque<pair<uint64_t, building_light_volume_t>> entries; // most recently used first
+	std::thread write_thread;
+
+	static string get_filename(uint64_t key) {
+		std::ostringstream oss;
+		oss << building_indir_cache_dir << "/bldg_indir_" << std::hex << key << ".gz";
+		return oss.str();
+	}
+	static void write_file(string const &fn, uint64_t key, building_light_volume_t const &vol) { // runs in write_thread, which owns copies of the args
+		binary_file_writer w;
+		if (!w.open(fn)) return;
+		if (!vol.write(w, key)) {std::cerr << "Error writing building lighting cache file " << fn << std::endl;}
+	}
+	void add_to_front(uint64_t key, building_light_volume_t const &vol) {
+		entries.emplace_front(key, vol);
+		if (entries.size() > BLDG_INDIR_MEM_CACHE_SIZE) {entries.pop_back();} // evict the least recently used
+	}
+public:
+	~building_indir_cache_t() {join_write_thread();}
+	void join_write_thread() {if (write_thread.joinable()) {write_thread.join();}}
+
+	bool read(uint64_t key, building_light_volume_t &vol) {
+		for (auto i = entries.begin(); i != entries.end(); ++i) {
+			if (i->first != key) continue;
+			vol = i->second;
+
+			if (i != entries.begin()) { // move to front
+				pair<uint64_t, building_light_volume_t> entry(std::move(*i));
+				entries.erase(i);
+				entries.push_front(std::move(entry));
+			}
+			return 1;
+		}
+		if (building_indir_cache_dir.empty()) return 0; // no disk cache
+		join_write_thread(); // may be writing this file
+		string const fn(get_filename(key));
+		FILE *fp(fopen(fn.c_str(), "rb"));
+		if (fp == nullptr) return 0; // not cached, not an error
+		fclose(fp);
+		binary_file_reader r;
+		if (!r.open(fn) || !vol.read(r, key)) {vol.reset(); return 0;}
+		add_to_front(key, vol);
+		return 1;
+	}
+	void add(uint64_t key, building_light_volume_t const &vol) {
+		add_to_front(key, vol);
+		if (building_indir_cache_dir.empty()) return; // no disk cache
+		join_write_thread();
+		// compress and write in the background; the filename is created here because it reads a global that the thread may outlive
+		write_thread = std::thread(write_file, get_filename(key), key, vol);
+	}
+};
+
+building_indir_cache_t building_indir_cache;
+
+
 class building_indir_light_mgr_t {
 	bool is_running, is_done, kill_thread, lighting_updated, needs_to_join;
-	int cur_bix, cur_light;
-	unsigned cur_tid;
+	int cur_bix;
+	unsigned cur_tid, cur_pass;
+	uint64_t cache_key;
 	vector<unsigned char> tex_data;
-	vector<unsigned> light_ids;
-	set<unsigned> lights_complete;
+	vector<unsigned> light_ids, cur_lights; // all lights, and the batch of lights currently being processed
+	set<unsigned> lights_complete; // lights completed in the current pass
 	cube_bvh_t bvh;
-	lmap_manager_t lmgr;
+	building_light_volume_t accum, estimate; // lighting from the current pass, and the combined lighting from all previous passes
 	std::thread rt_thread;
 
-	void init_lmgr(bool clear_lighting) {
-		if (clear_lighting) {lmgr.reset_all();}
-		if (lmgr.is_allocated()) return; // already setup
-		unsigned const tot_sz(XY_MULT_SIZE*MESH_SIZE[2]); // Note: MESH_SIZE[2], not MESH_Z_SIZE; want clipped size that lmap uses rather than user-specified size
-		lmcell init_lmcell;
-		lmgr.alloc(tot_sz, MESH_X_SIZE, MESH_Y_SIZE, MESH_SIZE[2], (unsigned char **)nullptr, init_lmcell);
+	void init_volumes(building_t const &b) {
+		unsigned const max_res(max(global_building_params.indir_grid_res, 2U));
+		accum.init(b.bcube, max_res);
+		estimate.init(b.bcube, max_res);
+	}
+	uint64_t get_cache_key(building_t const &b) { // must be called after build_bvh()
+		// buildings don't store their generation seed, so use a hash of everything that affects lighting, which includes the bcube
+		fnv1a_hasher_t hasher;
+		hasher(BLDG_INDIR_CACHE_VERSION);
+		hasher(global_building_params.indir_grid_res);
+		hasher(LOCAL_RAYS);
+		hasher(MAX_RAY_BOUNCES);
+		hasher(NUM_PRI_SPLITS);
+		hasher(BLDG_INDIR_NUM_PASSES);
+		hasher(ray_step_size_mult); // affects both the ray step size and the per-step weights
+		hasher(b.bcube);
+		hasher(b.mat_ix);
+		hasher(b.side_color);
+		hasher(b.has_pri_hall());
+		hasher(bool(b.is_house));
+		for (auto p = b.parts.begin(); p != b.parts.end(); ++p) {hasher((cube_t const &)*p);}
+		vect_colored_cube_t const &cubes(bvh.get_objs()); // interior geometry used for ray casting
+
+		for (auto c = cubes.begin(); c != cubes.end(); ++c) {
+			hasher((cube_t const &)*c);
+			hasher(c->color);
+		}
+		vector<room_object_t> const &objs(b.interior->room_geom->objs);
+
+		for (auto i = objs.begin(); i != objs.end(); ++i) { // light state
+			if (i->type != TYPE_LIGHT || !i->is_lit()) continue;
+			hasher(unsigned(i - objs.begin()));
+			hasher((cube_t const &)*i);
+			hasher(i->get_color());
+		}
+		return hasher.get();
 	}
 	void start_lighting_compute(building_t const &b) {
-		assert(cur_light >= 0);
-		init_lmgr(0); // clear_lighting=0
+		assert(!cur_lights.empty());
 		is_running = 1;
 		lighting_updated = 1;
 
-		if (USE_BKG_THREAD) { // start a thread to compute cur_light for building b
-			rt_thread = std::thread(&building_indir_light_mgr_t::cast_light_ray, this, b);
+		if (USE_BKG_THREAD) { // start a thread to compute cur_lights for building b
+			rt_thread = std::thread(&building_indir_light_mgr_t::cast_light_rays, this, b);
 			needs_to_join = 1;
 		}
 		else {
-			timer_t timer("Ray Cast Building Light");
-			cast_light_ray(b);
+			timer_t timer("Ray Cast Building Lights");
+			cast_light_rays(b);
 		}
 	}
 	void calc_reflect_ray(point &pos, point const &cpos, vector3d &dir, vector3d const &cnorm, rand_gen_t &rgen, float tolerance) const {
@@ -201,28 +409,36 @@ class building_indir_light_mgr_t {
 		if (dot_product(dir, cnorm) < 0.0) {dir.negate();} // make sure it points away from the surface (is this needed?)
 		pos = cpos + tolerance*dir; // move slightly away from the surface
 	}
-	void cast_light_ray(building_t const &b) {
-		// Note: modifies lmgr, but otherwise thread safe
+	void cast_light_rays(building_t const &b) {
+		// Note: modifies accum, but otherwise thread safe
 		unsigned const num_rt_threads(NUM_THREADS - (USE_BKG_THREAD ? 1 : 0)); // reserve a thread for the main thread if running in the background
 		vector<room_object_t> const &objs(b.interior->room_geom->objs);
-		assert((unsigned)cur_light < objs.size());
-		room_object_t const &ro(objs[cur_light]);
-		colorRGBA const lcolor(ro.get_color());
-		cube_t const scene_bounds(get_scene_bounds_bcube()); // expected by lmap update code
-		point const ray_scale(scene_bounds.get_size()/b.bcube.get_size()), llc_shift(scene_bounds.get_llc() - b.bcube.get_llc()*ray_scale);
-		float const tolerance(1.0E-5*b.bcube.get_max_extent()), light_zval(ro.z1() - 0.01*ro.dz()); // set slightly below bottom of light
-		float const surface_area(ro.dx()*ro.dy() + 2.0f*(ro.dx() + ro.dy())*ro.dz()); // bottom + 4 sides (top is occluded), 0.0003 for houses
-		float weight(100.0f*(surface_area/0.0003f)/LOCAL_RAYS); // normalize to the number of rays
-		if (b.has_pri_hall()) {weight *= 0.8;} // floorplan is open and well lit, indir lighting value seems too high
-		if (b.is_house) {weight *= 2.0;} // houses have dimmer lights and seem to work better with more indir
-		unsigned const NUM_PRI_SPLITS = 16;
-		int const num_rays(LOCAL_RAYS/NUM_PRI_SPLITS);
+		unsigned const ray_start(get_pass_start_ray(cur_pass)), rays_per_light(get_pass_end_ray(cur_pass) - ray_start);
+		float const tolerance(1.0E-5*b.bcube.get_max_extent());
+		// each pass is normalized to full brightness so that it can be displayed or blended with the previous passes
+		float const pass_weight_scale(float(get_num_pri_rays_per_light())/rays_per_light);
+		vector<float> weights(cur_lights.size());
+
+		for (unsigned i = 0; i < cur_lights.size(); ++i) {
+			assert(cur_lights[i] < objs.size());
+			room_object_t const &ro(objs[cur_lights[i]]);
+			float const surface_area(ro.dx()*ro.dy() + 2.0f*(ro.dx() + ro.dy())*ro.dz()); // bottom + 4 sides (top is occluded), 0.0003 for houses
+			float &weight(weights[i]);
+			weight = pass_weight_scale*100.0f*(surface_area/0.0003f)/LOCAL_RAYS; // normalize to the number of rays
+			if (b.has_pri_hall()) {weight *= 0.8;} // floorplan is open and well lit, indir lighting value seems too high
+			if (b.is_house) {weight *= 2.0;} // houses have dimmer lights and seem to work better with more indir
+		}
+		int const num_rays(cur_lights.size()*rays_per_light);
 
 #pragma omp parallel for schedule(dynamic) num_threads(num_rt_threads)
-		for (int n = 0; n < num_rays; ++n) {
+		for (int i = 0; i < num_rays; ++i) {
 			if (kill_thread) continue;
+			unsigned const lix(i/rays_per_light), n(ray_start + (i - lix*rays_per_light)), light_id(cur_lights[lix]);
+			room_object_t const &ro(objs[light_id]);
+			colorRGBA const lcolor(ro.get_color());
+			float const weight(weights[lix]), light_zval(ro.z1() - 0.01*ro.dz()); // set slightly below bottom of light
 			rand_gen_t rgen;
-			rgen.set_state(n+1, cur_light);
+			rgen.set_state(n+1, light_id); // same rays for a given light independent of how they're split into passes
 			vector3d pri_dir(rgen.signed_rand_vector_spherical(1.0).get_norm());
 			pri_dir.z = -fabs(pri_dir.z); // make sure dir points down
 			point origin, init_cpos, cpos;
@@ -245,45 +461,63 @@ class building_indir_light_mgr_t {
 				for (unsigned bounce = 1; bounce < MAX_RAY_BOUNCES; ++bounce) { // allow up to MAX_RAY_BOUNCES bounces
 					cpos = pos; // init value
 					bool const hit(b.ray_cast_interior(pos, dir, bvh, cpos, cnorm, ccolor));
-
-					if (cpos != pos) { // accumulate light along the ray from pos to cpos (which is always valid) with color cur_color
-						point const p1(pos*ray_scale + llc_shift), p2(cpos*ray_scale + llc_shift); // transform building space to global scene space
-						add_path_to_lmcs(&lmgr, nullptr, p1, p2, weight, cur_color, LIGHTING_LOCAL, 0); // local light, no bcube
-					}
+					if (cpos != pos) {accum.add_path(pos, cpos, weight, cur_color);} // accumulate light along the ray from pos to cpos (which is always valid)
 					if (!hit) break; // done
 					cur_color = cur_color.modulate_with(ccolor);
 					if (cur_color.get_luminance() < 0.1) break; // done
 					calc_reflect_ray(pos, cpos, dir, cnorm, rgen, tolerance);
 				} // for bounce
 			} // for splits
-		} // for n
+		} // for i
 		is_running = 0;
 	}
 	void wait_for_finish(bool force_kill) {
-		// Note: for now the time taken to process a light should be pretty fast so we just block until finished; set kill_thread=1 to be faster
+		// Note: for now the time taken to process a batch of lights should be pretty fast so we just block until finished; set kill_thread=1 to be faster
 		if (force_kill) {kill_thread = 1;}
 		while (is_running) {alut_sleep(0.01);}
 		kill_thread = 0;
 	}
-	void update_volume_light_texture() { // full update, 6.6ms for z=128
-		//timer_t timer("Lighting Tex Create");
-		indir_light_tex_from_lmap(cur_tid, lmgr, tex_data, MESH_X_SIZE, MESH_Y_SIZE, MESH_SIZE[2], indir_light_exp, 1); // local_only=1
-	}
 	void maybe_join_thread() {
 		if (needs_to_join) {rt_thread.join(); needs_to_join = 0;}
 	}
+	void finish_pass() { // blend this pass into the estimate, weighted by the number of rays per light in each
+		unsigned const prev_rays(get_pass_start_ray(cur_pass)), tot_rays(get_pass_end_ray(cur_pass));
+		estimate.blend_with(accum, float(prev_rays)/tot_rays, float(tot_rays - prev_rays)/tot_rays);
+		accum.reset();
+		estimate.update_texture(cur_tid, tex_data, indir_light_exp, 1); // full update
+		lights_complete.clear();
+		++cur_pass;
+	}
+	bool select_next_batch(building_t const &b, point const &target) {
+		// lights are processed nearest first in batches of about the same number of rays as a single light in the final pass
+		unsigned const pass_rays(get_pass_end_ray(cur_pass) - get_pass_start_ray(cur_pass)); // can be 0 if LOCAL_RAYS is small
+		b.order_lights_by_priority(target, light_ids);
+		cur_lights.clear();
+		if (pass_rays == 0) return 0; // nothing to do for this pass
+		unsigned const max_batch_lights(max(1U, get_num_pri_rays_per_light()/pass_rays));
+
+		for (auto i = light_ids.begin(); i != light_ids.end() && cur_lights.size() < max_batch_lights; ++i) {
+			if (lights_complete.find(*i) == lights_complete.end()) {cur_lights.push_back(*i);} // find an incomplete light
+		}
+		return !cur_lights.empty();
+	}
 public:
-	building_indir_light_mgr_t() : is_running(0), is_done(0), kill_thread(0), lighting_updated(0), needs_to_join(0), cur_bix(-1), cur_light(-1), cur_tid(0) {}
+	building_indir_light_mgr_t() : is_running(0), is_done(0), kill_thread(0), lighting_updated(0), needs_to_join(0), cur_bix(-1), cur_tid(0), cur_pass(0), cache_key(0) {}
 
 	void clear() {
+		end_rt_job();
 		is_done = lighting_updated = 0;
-		cur_bix = cur_light = -1;
+		cur_bix  = -1;
+		cur_pass = 0;
+		cache_key = 0;
 		tex_data.clear();
 		light_ids.clear();
+		cur_lights.clear();
 		lights_complete.clear();
-		end_rt_job();
-		lmgr.reset_all(); // clear lighting values back to 0
+		accum.clear();
+		estimate.clear();
 		bvh.clear();
+		free_indir_texture(); // texture size depends on the building
 	}
 	void end_rt_job() {
 		wait_for_finish(1); // force_kill=1
@@ -297,31 +531,44 @@ public:
 			cur_bix = bix;
 			assert(!is_running);
 			build_bvh(b);
+			init_volumes(b);
+			cache_key = get_cache_key(b);
+
+			if (building_indir_cache.read(cache_key, estimate)) { // use the cached lighting
+				estimate.update_texture(cur_tid, tex_data, indir_light_exp, 1); // full update
+				cur_pass = BLDG_INDIR_NUM_PASSES;
+				is_done  = 1;
+				tid = cur_tid;
+				return;
+			}
 		}
 		if (cur_tid > 0 && is_done) return; // nothing else to do
 
 		if (display_framerate && (is_running || lighting_updated)) { // show progress to the user
 			std::ostringstream oss;
-			oss << "Lights: " << lights_complete.size() << " / " << light_ids.size();
+			oss << "Lights: " << lights_complete.size() << " / " << light_ids.size() << " Pass: " << (cur_pass+1) << " / " << BLDG_INDIR_NUM_PASSES;
 			lighting_update_text = oss.str();
 		}
 		if (is_running) return; // still running, let it continue
 
-		if (lighting_updated) { // update lighting texture based on incremental progress
+		if (lighting_updated) { // the batch has completed
 			maybe_join_thread();
-			update_volume_light_texture();
+			lights_complete.insert(cur_lights.begin(), cur_lights.end()); // mark the most recent lights as complete
+			cur_lights.clear();
+			// the coarse pass is shown incrementally; refinement passes replace the estimate when complete so that lighting doesn't get darker
+			if (cur_pass == 0) {accum.update_texture(cur_tid, tex_data, indir_light_exp, 0);} // partial update
 			lighting_updated = 0;
 		}
-		// nothing is running and there is more work to do, find the nearest light to the target and process it
-		if (cur_light >= 0) {lights_complete.insert(cur_light); cur_light = -1;} // mark the most recent light as complete
-		b.order_lights_by_priority(target, light_ids);
-
-		for (auto i = light_ids.begin(); i != light_ids.end(); ++i) {
-			if (lights_complete.find(*i) == lights_complete.end()) {cur_light = *i; break;} // find an incomplete light
+		// nothing is running and there is more work to do, find the nearest lights to the target and process them
+		while (cur_pass < BLDG_INDIR_NUM_PASSES && !select_next_batch(b, target)) {
+			if (light_ids.empty()) {cur_pass = BLDG_INDIR_NUM_PASSES; break;} // no lights
+			finish_pass();
+		}
+		if (cur_pass < BLDG_INDIR_NUM_PASSES) {start_lighting_compute(b);} // this batch is next
+		else if (!is_done) { // no more lights to process
+			if (!light_ids.empty()) {building_indir_cache.add(cache_key, estimate);}
+			is_done = 1;
 		}
-		if (cur_light >= 0) {start_lighting_compute(b);} // this light is next
-		else {is_done = 1;} // no more lights to process
-		//cout << "Process light " << lights_complete.size() << " of " << light_ids.size() << endl;
 		tid = cur_tid;
 	}
 	void build_bvh(building_t const &b) {
@@ -330,12 +577,19 @@ public:
 		bvh.build_tree_top(0); // verbose=0
 	}
 	cube_bvh_t const &get_bvh() const {return bvh;}
+	float get_avg_cell_xy_size() const {return estimate.get_avg_cell_xy_size();}
 };
 
 building_indir_light_mgr_t building_indir_light_mgr;
 
 void free_building_indir_texture() {building_indir_light_mgr.free_indir_texture();}
-void end_building_rt_job() {building_indir_light_mgr.end_rt_job();}
+void end_building_rt_job() {building_indir_light_mgr.end_rt_job();} // called every frame the player isn't in a building with indir lighting, so must not block
+
+void end_building_rt_job_and_flush_cache() { // called on quit
+	end_building_rt_job();
+	building_indir_cache.join_write_thread(); // finish writing the cache file before globals are destroyed
+}
+float get_building_indir_cell_xy_size() {return building_indir_light_mgr.get_avg_cell_xy_size();}
 
 void building_t::create_building_volume_light_texture(unsigned bix, point const &target, unsigned &tid) const {
 	if (!has_room_geom()) return; // error?
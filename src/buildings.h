@@ -148,8 +148,8 @@ struct building_mat_t : public building_tex_params_t {
 
 struct building_params_t {
 
-	bool flatten_mesh, has_normal_map, tex_mirror, tex_inv_y, tt_only, infinite_buildings, dome_roof, onion_roof, enable_people_ai, add_city_interiors, enable_rotated_room_geom;
-	unsigned num_place, num_tries, cur_prob, max_shadow_maps;
+	bool flatten_mesh, has_normal_map, tex_mirror, tex_inv_y, tt_only, infinite_buildings, dome_roof, onion_roof, enable_people_ai, add_city_interiors, enable_rotated_room_geom, parallel_place;
+	unsigned num_place, num_tries, cur_prob, max_shadow_maps, indir_grid_res;
 	float ao_factor, sec_extra_spacing, player_coll_radius_scale;
 	float window_width, window_height, window_xspace, window_yspace; // windows
 	float wall_split_thresh, max_fp_wind_xscale, max_fp_wind_yscale; // interiors
@@ -160,7 +160,7 @@ struct building_params_t {
 	vector<unsigned> rug_tids, picture_tids, desktop_tids, sheet_tids;
 
 	building_params_t(unsigned num=0) : flatten_mesh(0), has_normal_map(0), tex_mirror(0), tex_inv_y(0), tt_only(0), infinite_buildings(0), dome_roof(0),
-		onion_roof(0), enable_people_ai(0), add_city_interiors(0), enable_rotated_room_geom(0), num_place(num), num_tries(10), cur_prob(1), max_shadow_maps(32),
+		onion_roof(0), enable_people_ai(0), add_city_interiors(0), enable_rotated_room_geom(0), parallel_place(0), num_place(num), num_tries(10), cur_prob(1), max_shadow_maps(32), indir_grid_res(128),
 		ao_factor(0.0), sec_extra_spacing(0.0), player_coll_radius_scale(1.0), window_width(0.0), window_height(0.0), window_xspace(0.0), window_yspace(0.0),
 		wall_split_thresh(4.0), max_fp_wind_xscale(0.0), max_fp_wind_yscale(0.0), range_translate(zero_vector) {}
 	int get_wrap_mir() const {return (tex_mirror ? 2 : 1);}
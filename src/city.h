@@ -606,6 +606,7 @@ class car_manager_t {
 public:
 	car_manager_t(city_road_gen_t const &road_gen_) : road_gen(road_gen_), dstate(car_model_loader), first_parked_car(0), first_garage_car(0), car_destroyed(0) {}
 	bool empty() const {return cars.empty();}
+	unsigned size() const {return cars.size();}
 	void clear() {cars.clear(); car_blocks.clear();}
 	unsigned get_model_gpu_mem() const {return car_model_loader.get_gpu_mem();}
 	void init_cars(unsigned num);
@@ -761,6 +762,7 @@ public:
 	void next_animation();
 	static float get_ped_radius();
 	bool empty() const {return (peds.empty() && peds_b.empty());}
+	unsigned size() const {return (peds.size() + peds_b.size());}
 	void clear() {peds.clear(); peds_b.clear(); by_city.clear();}
 	unsigned get_model_gpu_mem() const {return ped_model_loader.get_gpu_mem();}
 	void init(unsigned num_city, unsigned num_building);
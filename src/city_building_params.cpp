@@ -237,9 +237,15 @@ bool parse_buildings_option(FILE *fp) {
 	else if (str == "num_tries") {
 		if (!read_uint(fp, global_building_params.num_tries)) {buildings_file_err(str, error);}
 	}
+	else if (str == "parallel_place") {
+		if (!read_bool(fp, global_building_params.parallel_place)) {buildings_file_err(str, error);}
+	}
 	else if (str == "max_shadow_maps") {
 		if (!read_uint(fp, global_building_params.max_shadow_maps)) {buildings_file_err(str, error);}
 	}
+	else if (str == "indir_grid_res") { // max number of building indirect lighting cells along any dimension
+		if (!read_uint(fp, global_building_params.indir_grid_res)) {buildings_file_err(str, error);}
+	}
 	else if (str == "ao_factor") {
 		if (!read_zero_one_float(fp, global_building_params.ao_factor)) {buildings_file_err(str, error);}
 	}
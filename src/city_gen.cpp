@@ -6,6 +6,7 @@
 #include "mesh.h"
 #include "heightmap.h"
 #include "lightmap.h"
+#include "profiler.h"
 #include "buildings.h"
 #include "tree_3dw.h"
 #include <cfloat> // for FLT_MAX
@@ -3072,8 +3073,12 @@ public:
 		if (!use_threads_2_3 || omp_get_thread_num_3dw() == 1) { // thread 1
 			road_gen.next_frame(); // update stoplights; must be before car_manager next_frame() call
 			car_manager.next_frame(ped_manager, city_params.car_speed);
+			telemetry_set_gauge("city_cars", car_manager.size());
+		}
+		if (!use_threads_2_3 || omp_get_thread_num_3dw() == 2) { // thread=2
+			ped_manager.next_frame();
+			telemetry_set_gauge("city_peds", ped_manager.size());
 		}
-		if (!use_threads_2_3 || omp_get_thread_num_3dw() == 2) {ped_manager.next_frame();} // thread=2
 	}
 	void draw(int shadow_only, int reflection_pass, int trans_op_mask, vector3d const &xlate) { // shadow_only: 0=non-shadow pass, 1=sun/moon shadow, 2=dynamic shadow
 		if (!shadow_only && !reflection_pass && (trans_op_mask & 1)) {setup_city_lights(xlate);} // setup lights on first (opaque) non-shadow pass
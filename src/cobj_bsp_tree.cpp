@@ -9,9 +9,14 @@
 unsigned const MAX_LEAF_SIZE = 2;
 float const POLY_TOLER       = 1.0E-6;
 float const OVERLAP_AMT      = 0.02;
+unsigned const MAX_BVH_REFITS = 300; // force a rebuild after this many consecutive refits
+float const MAX_REFIT_COST_RATIO = 1.5; // rebuild when the refit tree's node surface area exceeds the original by this ratio
+unsigned const CIX_NOT_IN_TREE    = (unsigned)-1;
+unsigned const MAX_INCR_SUBTREES  = 64;   // rebuild after this many incremental inserts, since each subtree root is tested by every query
+float const MAX_INCR_CHANGE_FRAC  = 0.25; // rebuild when the number of removed + inserted cobjs exceeds this fraction of the cobjs in the last build
 
 
-extern bool mt_cobj_tree_build, begin_motion;
+extern bool mt_cobj_tree_build, begin_motion, incremental_cobj_tree;
 extern int display_mode, frame_counter, cobj_counter;
 extern coll_obj_group coll_objects;
 extern vector<unsigned> falling_cobjs;
@@ -396,6 +401,14 @@ void cobj_bvh_tree::clear() {
 
 	cobj_tree_base::clear();
 	cixs.resize(0);
+	src_cixs.resize(0);
+	cix_pos.resize(0);
+	pos_leaf.resize(0);
+	node_parent.resize(0);
+	can_refit  = 0;
+	num_refits = 0;
+	num_built  = num_removed = num_inserted = num_subtrees = 0;
+	inserted_cost = 0.0;
 }
 
 
@@ -415,10 +428,178 @@ void cobj_bvh_tree::add_cobjs(bool verbose) {
 }
 
 
+// update the dynamic tree for the cobjs removed from and added to dynamic_ids since the last update;
+// dynamic cobjs are removed and re-added rather than moved in place, so there's nothing to refit
+void cobj_bvh_tree::update_cobjs(vector<int> const &removed, vector<int> const &added, bool verbose) {
+
+	if (removed.empty() && added.empty()) return; // no change
+	if (!update_incremental(removed, added)) {add_cobjs(verbose);} // too many changes, rebuild
+}
+
+
+// refit the leaves containing the moved cobjs (a subset of cids) and their ancestors, stopping where the bounds don't change;
+// returns 1 if the tree was refit; otherwise, the caller must rebuild it
+bool cobj_bvh_tree::refit_cobj_ids(vector<unsigned> const &cids, vector<unsigned> const &moved) {
+
+	if (!can_refit || nodes.empty() || num_refits >= MAX_BVH_REFITS || cids != src_cixs) return 0;
+	if (moved.empty()) return 1; // nothing to do
+	if (cix_pos.empty()) {init_incremental();} // first refit since the last build
+	if (node_parent.empty()) {init_node_parents();}
+	refit_nixs.resize(0);
+
+	for (auto i = moved.begin(); i != moved.end(); ++i) {
+		assert(*i < cix_pos.size() && cix_pos[*i] != CIX_NOT_IN_TREE);
+		refit_nixs.push_back(pos_leaf[cix_pos[*i]]);
+	}
+	make_heap(refit_nixs.begin(), refit_nixs.end()); // kids come after their parent in depth-first order, so the max heap refits kids first
+	unsigned last_nix((unsigned)nodes.size()), num_changed(0);
+
+	while (!refit_nixs.empty()) {
+		pop_heap(refit_nixs.begin(), refit_nixs.end());
+		unsigned const nix(refit_nixs.back());
+		refit_nixs.pop_back();
+		if (nix == last_nix) continue; // duplicate
+		last_nix = nix;
+		tree_node &n(nodes[nix]);
+		cube_t const prev(n);
+
+		if (n.start < n.end) {calc_node_bbox(n);} // leaf node
+		else { // branch node: union of kids
+			for (unsigned kid = nix+1; kid < n.next_node_id; kid = nodes[kid].next_node_id) {
+				assert(nodes[kid].next_node_id > kid);
+				if (kid == nix+1) {n.copy_from(nodes[kid]);} else {n.union_with_cube(nodes[kid]);}
+			}
+		}
+		if (n == prev) continue; // unchanged, so the ancestors are unchanged as well
+		refit_cost += n.get_area() - prev.get_area();
+		++num_changed;
+		if (nix > 0) {refit_nixs.push_back(node_parent[nix]); push_heap(refit_nixs.begin(), refit_nixs.end());} // root has no parent
+	}
+	if (num_changed == 0) return 1;
+	if (refit_cost > MAX_REFIT_COST_RATIO*build_cost) return 0; // tree quality has degraded too much, rebuild
+	++num_refits;
+	return 1;
+}
+
+
+// sum of node surface areas, a proxy for traversal cost
+float cobj_bvh_tree::calc_tree_cost() const {
+
+	float cost(0.0);
+	for (auto i = nodes.begin(); i != nodes.end(); ++i) {cost += i->get_area();}
+	return cost;
+}
+
+
+void cobj_bvh_tree::init_node_parents() {
+
+	node_parent.resize(0);
+	node_parent.resize(nodes.size(), 0);
+
+	for (unsigned nix = 0; nix < nodes.size(); ++nix) {
+		tree_node const &n(nodes[nix]);
+		if (n.start < n.end) continue; // leaf node
+		for (unsigned kid = nix+1; kid < n.next_node_id; kid = nodes[kid].next_node_id) {node_parent[kid] = nix;}
+	}
+}
+
+
+// incremental update of a static tree for destroyed and added cobjs:
+// removed cobjs are swapped to the end of their leaf and dropped, leaving the node bounds conservatively large;
+// added cobjs are built into a new subtree that's appended after the existing nodes, which traversal visits as another top level node;
+// returns 0 if the tree quality has degraded past the thresholds, in which case the caller must rebuild it
+bool cobj_bvh_tree::update_incremental(vector<int> const &removed, vector<int> const &added) {
+
+	if (nodes.empty() || num_subtrees >= MAX_INCR_SUBTREES) return 0;
+	if (num_removed + num_inserted + removed.size() + added.size() > MAX_INCR_CHANGE_FRAC*num_built) return 0;
+	if (build_cost + inserted_cost > MAX_REFIT_COST_RATIO*build_cost) return 0;
+	if (cix_pos.empty()) {init_incremental();} // first update since the last build
+	for (auto i = removed.begin(); i != removed.end(); ++i) {remove_cix(*i);}
+	for (auto i = added.begin(); i != added.end(); ++i) {remove_cix(*i);} // a reused cobj index may still have a stale entry
+	unsigned const start((unsigned)cixs.size());
+
+	for (auto i = added.begin(); i != added.end(); ++i) {
+		assert(*i >= 0 && (unsigned)*i < cobjs->size());
+		add_cobj(*i);
+	}
+	unsigned const num_add((unsigned)cixs.size() - start);
+	can_refit = 0; // src_cixs no longer matches
+	if (num_add == 0) return 1; // removal only
+	unsigned const root((unsigned)nodes.size());
+	nodes.resize(root + get_conservative_num_nodes(num_add));
+	nodes[root] = tree_node(start, (unsigned)cixs.size());
+	per_thread_data ptd(root+1, nodes.size(), 1);
+	build_tree(root, 0, 0, ptd);
+	nodes.resize(ptd.get_next_node_ix());
+	nodes[root].next_node_id = (unsigned)nodes.size();
+	pos_leaf.resize(cixs.size());
+	if (cix_pos.size() < cobjs->size()) {cix_pos.resize(cobjs->size(), CIX_NOT_IN_TREE);}
+
+	for (unsigned nix = root; nix < nodes.size(); ++nix) {
+		tree_node const &n(nodes[nix]);
+		inserted_cost += n.get_area();
+
+		for (unsigned i = n.start; i < n.end; ++i) {
+			pos_leaf[i] = nix;
+			cix_pos[cixs[i]] = i;
+		}
+	}
+	num_inserted += num_add;
+	++num_subtrees;
+	return 1;
+}
+
+
+void cobj_bvh_tree::init_incremental() {
+
+	cix_pos.resize(0);
+	cix_pos.resize(cobjs->size(), CIX_NOT_IN_TREE);
+	pos_leaf.resize(cixs.size(), 0);
+
+	for (unsigned nix = 0; nix < nodes.size(); ++nix) {
+		tree_node const &n(nodes[nix]);
+
+		for (unsigned i = n.start; i < n.end; ++i) { // leaves only; branch nodes and MT build gap nodes are empty
+			assert(cixs[i] < cix_pos.size());
+			cix_pos [cixs[i]] = i;
+			pos_leaf[i] = nix;
+		}
+	}
+}
+
+
+void cobj_bvh_tree::remove_cix(unsigned cid) {
+
+	if (cid >= cix_pos.size() || cix_pos[cid] == CIX_NOT_IN_TREE) return; // not in this tree
+	unsigned const pos(cix_pos[cid]);
+	assert(pos < pos_leaf.size());
+	tree_node &n(nodes[pos_leaf[pos]]);
+	assert(pos >= n.start && pos < n.end);
+	unsigned const last(n.end - 1);
+
+	if (pos != last) {
+		swap(cixs[pos], cixs[last]);
+		cix_pos[cixs[pos]] = pos;
+	}
+	--n.end; // an empty leaf is skipped by both traversal and refit
+	cix_pos[cid] = CIX_NOT_IN_TREE;
+	++num_removed;
+}
+
+
 // to be called from within add_cobjs() or after a call to add_cobj_ids()
 void cobj_bvh_tree::build_tree_from_cixs(bool do_mt_build) {
 
-	max_depth = max_leaf_count = num_leaf_nodes = 0;
+	src_cixs   = cixs; // record before cixs is reordered
+	can_refit  = !do_mt_build; // the MT build leaves gaps of unused nodes that refit_nodes() can't handle
+	num_refits = 0;
+	num_built  = (unsigned)cixs.size();
+	num_removed = num_inserted = num_subtrees = 0;
+	inserted_cost = 0.0;
+	cix_pos.resize(0); // rebuilt on the next incremental update or refit
+	pos_leaf.resize(0);
+	node_parent.resize(0);
+	max_depth  = max_leaf_count = num_leaf_nodes = 0;
 	nodes.resize(get_conservative_num_nodes(cixs.size()) + 64*do_mt_build); // add 8 extra nodes for each of 8 top level splits
 	unsigned const root(0);
 	nodes[root] = tree_node(0, (unsigned)cixs.size());
@@ -432,6 +613,7 @@ void cobj_bvh_tree::build_tree_from_cixs(bool do_mt_build) {
 		nodes.resize(ptd.get_next_node_ix());
 	}
 	nodes[root].next_node_id = (unsigned)nodes.size();
+	build_cost = refit_cost = calc_tree_cost();
 }
 
 
@@ -754,8 +936,13 @@ void cobj_bvh_tree::build_tree(unsigned nix, unsigned skip_dims, unsigned depth,
 cobj_bvh_tree cobj_tree_static (&coll_objects, 1, 0, 0, 0, 0); // does not include voxels
 cobj_bvh_tree cobj_tree_dynamic(&coll_objects, 0, 1, 0, 0, 0);
 cobj_bvh_tree cobj_tree_occlude(&coll_objects, 1, 0, 1, 0, 0);
+// the dynamic and static moving trees are updated in place by the main thread at fixed points in the frame (build_cobj_tree(1) at the start of
+// process_groups() and build_static_moving_cobj_tree() after platforms move), which are never concurrent with OpenMP loops that query them;
+// async lighting threads skip both trees (skip_dynamic and no_stat_moving), so readers don't need a snapshot
 cobj_bvh_tree cobj_tree_static_moving(&coll_objects, 1, 0, 0, 0, 0);
 //cobj_tree_tquads_t cobj_tree_triangles;
+unsigned static_cobjs_change_count(0); // incremented when static cobjs are removed or the static trees are rebuilt/updated
+bool all_cobjs_shifted(0); // all static moving cobjs must be refit
 
 
 cobj_bvh_tree &get_tree(bool dynamic) {
@@ -764,31 +951,65 @@ cobj_bvh_tree &get_tree(bool dynamic) {
 
 void build_static_moving_cobj_tree() {
 
-	cobj_tree_static_moving.clear();
-	vector<unsigned> moving_cids(falling_cobjs);
+	static vector<unsigned> moving_cids, moved_cids;
+	moving_cids = falling_cobjs;
 		
 	for (auto i = moving_cobjs.begin(); i != moving_cobjs.end(); ++i) {
 		if (coll_objects.get_cobj(*i).status == COLL_STATIC) {moving_cids.push_back(*i);}
 	}
+	moved_cids = moving_cids; // falling and movable cobjs may move on any frame; refit stops at the leaves whose bounds are unchanged
+
 	for (platform_cont::const_iterator i = platforms.begin(); i != platforms.end(); ++i) {
 		copy(i->cobjs.begin(), i->cobjs.end(), back_inserter(moving_cids));
+		if (all_cobjs_shifted || i->cobjs_moved()) {copy(i->cobjs.begin(), i->cobjs.end(), back_inserter(moved_cids));}
 	}
+	all_cobjs_shifted = 0;
+	if (cobj_tree_static_moving.refit_cobj_ids(moving_cids, moved_cids)) return; // refit in place; not thread safe, see no_stat_moving
+	cobj_tree_static_moving.clear(); // moved cobjs were added or removed, or the refit tree is poor quality, so rebuild it
+	++static_cobjs_change_count;
+
 	if (!moving_cids.empty()) {
 		cobj_tree_static_moving.add_cobj_ids(moving_cids);
 		cobj_tree_static_moving.build_tree_from_cixs(0);
 	}
 }
 
+void invalidate_moving_cobj_trees() { // called when all cobjs are shifted
+	coll_objects.clear_dynamic_log(1);
+	all_cobjs_shifted = 1;
+}
+
+// returns 0 if the static trees must be rebuilt instead
+bool update_static_cobj_trees(vector<int> const &removed, vector<int> const &added) {
+
+	if (!incremental_cobj_tree) return 0;
+	++static_cobjs_change_count;
+	//highres_timer_t timer("Update Static Cobj Trees");
+	return (get_tree(0).update_incremental(removed, added) && cobj_tree_occlude.update_incremental(removed, added));
+}
+
 void build_cobj_tree(bool dynamic, bool verbose) {
 	
 	if (!dynamic) { // static
+		++static_cobjs_change_count;
 		get_tree(0).add_cobjs(verbose);
 		cobj_tree_occlude.add_cobjs(verbose);
 		//cout << "occluders: " << cobj_tree_occlude.get_num_objs() << endl;
 		//cobj_tree_triangles.add_cobjs(coll_objects, verbose);
 	}
 	else { // dynamic
-		if (begin_motion) {get_tree(1).add_cobjs(verbose);}
+		if (begin_motion) {
+			if (coll_objects.dynamic_ids_reset) {get_tree(1).add_cobjs(verbose);}
+			else {
+				vector<int> &removed(coll_objects.dynamic_removed), &added(coll_objects.dynamic_added);
+				sort(removed.begin(), removed.end());
+				removed.erase(unique(removed.begin(), removed.end()), removed.end());
+				sort(added.begin(), added.end()); // a freed and reused index may have been added more than once
+				added.erase(unique(added.begin(), added.end()), added.end());
+				get_tree(1).update_cobjs(removed, added, verbose);
+			}
+			coll_objects.clear_dynamic_log(0);
+		}
 		//build_static_moving_cobj_tree();
 	}
 }
@@ -107,8 +107,12 @@ public:
 class cobj_bvh_tree : public cobj_tree_base {
 
 	coll_obj_group const *cobjs;
-	vector<unsigned> cixs;
-	bool is_static, is_dynamic, occluders_only, cubes_only, inc_voxel_cobjs;
+	vector<unsigned> cixs, src_cixs; // src_cixs is the unsorted input, used to check if the tree can be refit
+	vector<unsigned> cix_pos, pos_leaf; // cobj index => position in cixs, position in cixs => leaf node; only used for incremental updates
+	vector<unsigned> node_parent, refit_nixs; // node => parent node and the heap of nodes to refit; only used for refits
+	bool is_static, is_dynamic, occluders_only, cubes_only, inc_voxel_cobjs, can_refit;
+	unsigned num_refits, num_built, num_removed, num_inserted, num_subtrees;
+	float build_cost, inserted_cost, refit_cost;
 
 	struct per_thread_data {
 		vector<unsigned> temp_bins[3];
@@ -128,6 +132,10 @@ class cobj_bvh_tree : public cobj_tree_base {
 	void calc_node_bbox(tree_node &n) const;
 	void build_tree_top_level_omp();
 	void build_tree(unsigned nix, unsigned skip_dims, unsigned depth, per_thread_data &ptd);
+	float calc_tree_cost() const;
+	void init_node_parents();
+	void init_incremental();
+	void remove_cix(unsigned cid);
 
 	bool obj_ok(coll_obj const &c) const {
 		return (((is_static && c.status == COLL_STATIC) || (is_dynamic && c.status == COLL_DYNAMIC) || (!is_static && !is_dynamic)) &&
@@ -137,12 +145,16 @@ class cobj_bvh_tree : public cobj_tree_base {
 
 public:
 	cobj_bvh_tree(coll_obj_group const *cobjs_, bool s, bool d, bool o, bool c, bool v)
-		: cobjs(cobjs_), is_static(s), is_dynamic(d), occluders_only(o), cubes_only(c), inc_voxel_cobjs(v) {assert(cobjs);}
+		: cobjs(cobjs_), is_static(s), is_dynamic(d), occluders_only(o), cubes_only(c), inc_voxel_cobjs(v), can_refit(0), num_refits(0),
+		num_built(0), num_removed(0), num_inserted(0), num_subtrees(0), build_cost(0.0), inserted_cost(0.0), refit_cost(0.0) {assert(cobjs);}
 
 	unsigned get_num_objs() const {return cixs.size();}
 	void clear();
 	void add_cobj_ids(vector<unsigned> const &cids) {assert(cixs.empty() && !cids.empty()); cixs = cids;}
 	void add_cobjs(bool verbose);
+	void update_cobjs(vector<int> const &removed, vector<int> const &added, bool verbose);
+	bool refit_cobj_ids(vector<unsigned> const &cids, vector<unsigned> const &moved);
+	bool update_incremental(vector<int> const &removed, vector<int> const &added);
 	void build_tree_from_cixs(bool do_mt_build);
 	bool check_coll_line(point const &p1, point const &p2, point &cpos, vector3d &cnorm, int &cindex, int ignore_cobj,
 		bool exact, int test_alpha, bool skip_non_drawn, bool skip_init_colls, bool skip_movable) const;
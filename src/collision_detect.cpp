@@ -8,13 +8,19 @@
 #include "physics_objects.h"
 #include "openal_wrap.h"
 #include "model3d.h"
+#include <atomic>
+#include <memory>
+#include <thread>
 
 
 bool const REMOVE_ALL_COLL   = 1;
 bool const ALWAYS_ADD_TO_HCM = 0;
 unsigned const CAMERA_STEPS  = 10;
 unsigned const PURGE_THRESH  = 20;
+unsigned const COBJ_CACHE_BATCH = 64; // number of free cobj slots moved between the shared free list and a thread's cache at once
+unsigned const COBJ_EMPTY_IX    = 0xFFFFFFFF;
 float const CAMERA_MESH_DZ   = 0.1; // max dz on mesh
+float const BROADPHASE_BATCH_SZ = 4.0; // in mesh cells
 
 
 // Global Variables
@@ -39,6 +45,9 @@ extern platform_cont platforms;
 extern set<unsigned> moving_cobjs;
 extern reflective_cobjs_t reflective_cobjs;
 extern model3ds all_models;
+extern obj_side_effects_t obj_side_effects;
+extern obj_coll_broadphase_t obj_broadphase;
+extern unsigned static_cobjs_change_count;
 
 
 void add_coll_point(int i, int j, int index, float zminv, float zmaxv, int add_to_hcm, int is_dynamic, int dhcm);
@@ -120,64 +129,189 @@ vector3d decal_obj::get_platform_delta() const {
 }
 
 
+// cobj slot allocator: free slots are kept on a lock-free stack threaded through free_next, with an ABA tag in the upper 32 bits of
+// the head, and each thread caches a batch of slots so that most allocs and frees don't touch the shared head; threads that hold
+// references into cobjs are counted in num_active, and cobjs is only resized once they have all exited
 class cobj_manager_t {
 
-	vector<int> index_stack;
+	struct thread_cache_t {
+		unsigned gen, depth;
+		vector<int> slots; // back is allocated first
+		thread_cache_t() : gen(0), depth(0) {}
+	};
+
 	coll_obj_group &cobjs;
-	unsigned index_top;
+	std::unique_ptr<std::atomic<unsigned>[]> free_next;
+	std::atomic<uint64_t> free_head; // {tag, index}
+	std::atomic<unsigned> num_active, grow_count, cache_gen;
+	std::atomic<bool> growing;
+
+	thread_cache_t &get_cache() {
+		static thread_local thread_cache_t cache;
+		unsigned const gen(cache_gen);
+		if (cache.gen != gen) {cache.slots.clear(); cache.gen = gen;} // free list was rebuilt
+		return cache;
+	}
+	void enter(thread_cache_t &cache) {
+		if (cache.depth++ > 0) return; // already active
+
+		while (1) {
+			++num_active;
+			if (!growing) return;
+			--num_active; // back off until the resize is done
+			while (growing) {std::this_thread::yield();}
+		}
+	}
+	void exit(thread_cache_t &cache) {
+		assert(cache.depth > 0);
+		if (--cache.depth == 0) {assert(num_active > 0); --num_active;}
+	}
+	static uint64_t make_head(uint64_t old_head, unsigned ix) {return ((((old_head >> 32) + 1) << 32) | ix);}
 
-	void extend_index_stack(unsigned start, unsigned end) {
-		index_stack.resize(end);
+	int pop_free() { // must be active
+		uint64_t head(free_head.load());
 
-		for (size_t i = start; i < end; ++i) { // initialize
-			index_stack[i] = (int)i; // put on the free list
+		while (1) {
+			unsigned const ix((unsigned)head);
+			if (ix == COBJ_EMPTY_IX) return -1;
+			// free_next[ix] may be stale if ix was popped by another thread, but then the tag has changed and the CAS fails
+			if (free_head.compare_exchange_weak(head, make_head(head, free_next[ix].load(std::memory_order_relaxed)))) return ix;
 		}
 	}
+	void push_chain(int const *ixs, unsigned num) { // links ixs[0..num) and pushes them with a single CAS; must be active
+		if (num == 0) return;
+		for (unsigned i = 0; i+1 < num; ++i) {free_next[ixs[i]].store(ixs[i+1], std::memory_order_relaxed);}
+		uint64_t head(free_head.load());
+		do {free_next[ixs[num-1]].store((unsigned)head, std::memory_order_relaxed);}
+		while (!free_head.compare_exchange_weak(head, make_head(head, ixs[0])));
+	}
+	void push_range(unsigned start, unsigned end) { // must be exclusive
+		if (start == end) return;
+		for (unsigned i = start; i+1 < end; ++i) {free_next[i] = i+1;}
+		free_next[end-1] = (unsigned)free_head.load();
+		free_head = make_head(free_head.load(), start);
+	}
+	void resize_free_next(size_t old_size, size_t new_size) { // must be exclusive
+		std::unique_ptr<std::atomic<unsigned>[]> next(new std::atomic<unsigned>[new_size]);
+		for (size_t i = 0; i < old_size; ++i) {next[i] = free_next[i].load();}
+		free_next.swap(next);
+	}
+	void grow(size_t min_size, unsigned prev_grow_count) { // caller must not be active
+#pragma omp critical(cobj_manager_grow)
+		if (grow_count == prev_grow_count) { // not already grown by another thread
+			size_t const old_size(cobjs.size());
+			size_t const new_size(max(min_size, 2*old_size + 4)); // prevent small incremental resizes
+			//cout << "Resizing cojs vector from " << old_size << " to " << new_size << endl;
+			growing = 1;
+			while (num_active > 0) {std::this_thread::yield();} // wait for other threads to finish with their cobj references
+			cobjs.resize(new_size);
+			resize_free_next(old_size, new_size);
+			push_range(old_size, new_size);
+			++grow_count;
+			growing = 0;
+		}
+	}
+	void refill(thread_cache_t &cache, unsigned num) { // ensures the cache has at least num slots
+		while (cache.slots.size() < num) {
+			assert(cache.depth == 0); // can't wait for ourself in grow()
+			unsigned const prev_grow_count(grow_count);
+			vector<int> popped;
+			enter(cache);
+
+			while (cache.slots.size() + popped.size() < max(num, COBJ_CACHE_BATCH)) {
+				int const ix(pop_free());
+				if (ix < 0) break;
+				popped.push_back(ix);
+			}
+			exit(cache);
+			cache.slots.insert(cache.slots.begin(), popped.rbegin(), popped.rend()); // keep free list order
+			if (cache.slots.size() < num) {grow(cobjs.size() + num - cache.slots.size(), prev_grow_count);}
+		}
+	}
+	int take_slot(thread_cache_t &cache) { // must be active
+		int const index(cache.slots.back());
+		cache.slots.pop_back();
+		assert(size_t(index) < cobjs.size());
+		assert(cobjs[index].status == COLL_UNUSED);
+		cobjs[index].status = COLL_PENDING;
+		return index;
+	}
+	void reset_free_list(unsigned start) { // must be exclusive
+		free_head = make_head(free_head.load(), COBJ_EMPTY_IX);
+		resize_free_next(0, cobjs.size());
+		push_range(start, cobjs.size());
+		++cache_gen; // invalidate all thread caches
+	}
 
 public:
 	unsigned cobjs_removed;
 
-	cobj_manager_t(coll_obj_group &cobjs_) : cobjs(cobjs_), index_top(0), cobjs_removed(0) {
-		extend_index_stack(0, cobjs.size());
+	cobj_manager_t(coll_obj_group &cobjs_) : cobjs(cobjs_), free_head(COBJ_EMPTY_IX), num_active(0), grow_count(0), cache_gen(1), growing(0), cobjs_removed(0) {
+		reset_free_list(0);
+	}
+
+	void reserve_cobjs(size_t size) { // can be called from any thread that isn't in a begin_fill()/end_fill() pair
+		if (cobjs.size() < size) {grow(size, grow_count);}
 	}
 
-	void reserve_cobjs(size_t size) {
-		size_t const old_size(cobjs.size());
-		if (old_size >= size) return; // already large enough
-		size_t const new_size(max(size, 2*old_size)); // prevent small incremental reserves
-		//cout << "Resizing cojs vector from " << old_size << " to " << new_size << endl;
-		cobjs.resize(new_size);
-		extend_index_stack(old_size, new_size);
+	// takes num entries from the free list; can be called from any thread, and the caller may then write to these cobjs
+	// until it calls end_fill(), since cobjs won't be resized until then
+	void begin_fill(unsigned num, vector<unsigned> &indices) {
+		thread_cache_t &cache(get_cache());
+		refill(cache, num);
+		enter(cache);
+		indices.reserve(indices.size() + num);
+		for (unsigned i = 0; i < num; ++i) {indices.push_back(take_slot(cache));}
 	}
+	void end_fill() {exit(get_cache());}
 
 	int get_next_avail_index() {
-		size_t const old_size(cobjs.size());
-		assert(index_stack.size() == old_size);
-		if (index_top >= old_size) reserve_cobjs(2*index_top + 4); // approx double in size
-		int const index(index_stack[index_top]);
-		assert(size_t(index) < cobjs.size());
-		assert(cobjs[index].status == COLL_UNUSED);
-		cobjs[index].status = COLL_PENDING;
-		index_stack[index_top++] = -1;
+		thread_cache_t &cache(get_cache());
+		refill(cache, 1);
+		enter(cache);
+		int const index(take_slot(cache));
+		exit(cache);
 		return index;
 	}
 
-	void free_index(int index) {
+	void free_index(int index) { // can be called from any thread
+		thread_cache_t &cache(get_cache());
+		enter(cache);
 		assert(cobjs[index].status != COLL_UNUSED);
 		cobjs[index].status = COLL_UNUSED;
 
 		if (!cobjs[index].fixed) {
-			assert(index_top > 0);
-			index_stack[--index_top] = index;
+			cache.slots.push_back(index);
+
+			if (cache.slots.size() >= 2*COBJ_CACHE_BATCH) { // return the oldest slots to the shared list so that they can be used by other threads
+				push_chain(&cache.slots.front(), COBJ_CACHE_BATCH);
+				cache.slots.erase(cache.slots.begin(), cache.slots.begin()+COBJ_CACHE_BATCH);
+			}
 		}
+		exit(cache);
+	}
+	void free_indices(vector<int> const &ixs) { // frees a batch with a single push; ixs[0] will be allocated next
+		vector<int> to_push;
+		to_push.reserve(ixs.size());
+		thread_cache_t &cache(get_cache());
+		enter(cache);
+
+		for (int ix : ixs) {
+			assert(cobjs[ix].status != COLL_UNUSED);
+			cobjs[ix].status = COLL_UNUSED;
+			if (!cobjs[ix].fixed) {to_push.push_back(ix);}
+		}
+		push_chain(to_push.data(), to_push.size());
+		exit(cache);
 	}
 
 	bool swap_and_set_as_coll_objects(coll_obj_group &new_cobjs) {
 		if (!cobjs.empty()) return 0;
+		assert(num_active == 0);
 		cobjs.swap(new_cobjs);
 		unsigned const ncobjs(cobjs.size());
 		cobjs.resize(cobjs.capacity()); // use up all available capacity
-		extend_index_stack(0, cobjs.size());
+		reset_free_list(0);
 
 		for (unsigned i = 0; i < ncobjs; ++i) {
 			coll_obj temp_cobj(cobjs[i]);
@@ -446,19 +580,16 @@ int add_coll_sphere(point const &pt, float radius, cobj_params const &cparams, i
 }
 
 
-void add_coll_polygon_to_matrix(int index, int dhcm) { // coll_obj member function?
+// calls add_cell(i, j, z1, z2) for each coll_cell the polygon overlaps; only reads cobj, so can be called from multiple threads
+template<typename F> void for_each_coll_polygon_cell(coll_obj const &cobj, F add_cell) {
 
 	int x1, x2, y1, y2;
-	coll_obj const &cobj(coll_objects[index]);
 	get_params(x1, y1, x2, y2, cobj.d);
-	bool const is_dynamic(cobj.status == COLL_DYNAMIC);
 	float const zminc(cobj.d[2][0]), zmaxc(cobj.d[2][1]); // thickness has already been added/subtracted
 
 	if (cobj.thickness == 0.0 && (x2-x1) <= 1 && (y2-y1) <=1) { // small polygon
 		for (int i = y1; i <= y2; ++i) {
-			for (int j = x1; j <= x2; ++j) {
-				add_coll_point(i, j, index, zminc, zmaxc, 1, is_dynamic, dhcm);
-			}
+			for (int j = x1; j <= x2; ++j) {add_cell(i, j, zminc, zmaxc);}
 		}
 		return;
 	}
@@ -502,11 +633,18 @@ void add_coll_polygon_to_matrix(int index, int dhcm) { // coll_obj member functi
 			// adjust z bounds so that they are for the entire cell x/y bounds, not a single point (conservative)
 			z1 = max(zminc, (z1 - delta_z));
 			z2 = min(zmaxc, (z2 + delta_z));
-			add_coll_point(i, j, index, z1, z2, 1, is_dynamic, dhcm);
+			add_cell(i, j, z1, z2);
 		} // for j
 	} // for i
 }
 
+void add_coll_polygon_to_matrix(int index, int dhcm) { // coll_obj member function?
+
+	coll_obj const &cobj(coll_objects[index]);
+	bool const is_dynamic(cobj.status == COLL_DYNAMIC);
+	for_each_coll_polygon_cell(cobj, [&](int i, int j, float z1, float z2) {add_coll_point(i, j, index, z1, z2, 1, is_dynamic, dhcm);});
+}
+
 void set_coll_polygon(coll_obj &cobj, const point *points, int npoints, vector3d const &normal, float thickness) {
 
 	assert(npoints >= 3 && points != NULL); // too strict?
@@ -563,6 +701,54 @@ int add_simple_coll_polygon(const point *points, int npoints, cobj_params const
 }
 
 
+// batched version of add_simple_coll_polygon() that can be called from multiple threads: cobj slots are taken from the lock-free allocator
+// and the cobjs are filled without locking; cp_ixs[i] is the index into cparams for polys[i];
+// new cobj indices are appended to cids; the cobjs may be read until register_simple_coll_polygons() is called, which must follow
+void add_simple_coll_polygons(vector<coll_tquad> const &polys, vector<unsigned char> const &cp_ixs, cobj_params const *const cparams, vector<unsigned> &cids, bool fixed) {
+
+	assert(cparams != NULL);
+	assert(cp_ixs.size() == polys.size());
+	unsigned const start(cids.size());
+	cobj_manager.begin_fill(polys.size(), cids);
+
+	for (unsigned i = 0; i < polys.size(); ++i) {
+		coll_tquad const &poly(polys[i]);
+		int const index(cids[start + i]);
+		set_coll_polygon(coll_objects[index], poly.pts, poly.npts, poly.normal, 0.0);
+		float brad;
+		point center; // unused
+		polygon_bounding_sphere(poly.pts, poly.npts, 0.0, center, brad);
+		coll_objects.init_coll_obj_props(index, COLL_POLYGON, brad, 0.0, -1, cparams[cp_ixs[i]]);
+		coll_objects[index].fixed = fixed;
+	}
+}
+
+// adds the cobjs from add_simple_coll_polygons() to the coll_cells and ID sets; the cells are found before entering the critical section
+void register_simple_coll_polygons(vector<unsigned> const &cids, int dhcm) {
+
+	struct cell_entry_t {
+		int i, j; unsigned index; float z1, z2;
+		cell_entry_t(int i_, int j_, unsigned index_, float z1_, float z2_) : i(i_), j(j_), index(index_), z1(z1_), z2(z2_) {}
+	};
+	vector<cell_entry_t> cells;
+	cells.reserve(2*cids.size());
+
+	for (auto c = cids.begin(); c != cids.end(); ++c) {
+		for_each_coll_polygon_cell(coll_objects[*c], [&](int i, int j, float z1, float z2) {cells.emplace_back(i, j, *c, z1, z2);});
+	}
+	cobj_manager.end_fill(); // done with our cobj references
+
+#pragma omp critical(add_coll_polygon)
+	{
+		for (auto c = cids.begin(); c != cids.end(); ++c) {coll_objects.register_coll_obj(*c);}
+
+		for (auto e = cells.begin(); e != cells.end(); ++e) {
+			add_coll_point(e->i, e->j, e->index, e->z1, e->z2, 1, (coll_objects[e->index].status == COLL_DYNAMIC), dhcm);
+		}
+	}
+}
+
+
 void coll_obj::add_as_fixed_cobj() {
 
 	calc_volume();
@@ -713,7 +899,8 @@ void add_coll_point(int i, int j, int index, float zminv, float zmaxv, int add_t
 }
 
 
-int remove_coll_object(int index, bool reset_draw) {
+// marks the cobj as freed and removes it from the ID sets; returns 0 if it was already removed
+bool mark_coll_object_removed(int index, bool reset_draw) {
 
 	if (index < 0) return 0;
 	coll_obj &c(coll_objects.get_cobj(index));
@@ -723,10 +910,19 @@ int remove_coll_object(int index, bool reset_draw) {
 		return 0;
 	}
 	if (c.status == COLL_FREED) return 0;
+	if (c.status == COLL_STATIC) {++static_cobjs_change_count;} // invalidates broadphase static cobj candidates
 	coll_objects.remove_index_from_ids(index);
 	if (reset_draw) {c.cp.draw = 0;}
 	c.status   = COLL_FREED;
 	c.waypt_id = -1; // is this necessary?
+	return 1;
+}
+
+
+int remove_coll_object(int index, bool reset_draw) {
+
+	if (!mark_coll_object_removed(index, reset_draw)) return 0;
+	coll_obj &c(coll_objects[index]);
 	
 	if (c.status == COLL_STATIC) {
 		//free_index(index); // can't do this here - object's collision id needs to be held until purge
@@ -754,6 +950,49 @@ int remove_coll_object(int index, bool reset_draw) {
 }
 
 
+// batched version of remove_coll_object(): the ID sets are updated serially, then the coll cells are updated in parallel
+// (each cell is owned by one thread), and the slots are returned to the allocator with a single push; returns the number removed
+unsigned remove_coll_objects(vector<unsigned> const &cids, bool reset_draw) {
+
+	vector<int> removed;
+	removed.reserve(cids.size());
+
+	for (auto i = cids.begin(); i != cids.end(); ++i) {
+		if (mark_coll_object_removed(*i, reset_draw)) {removed.push_back(*i);}
+	}
+	if (removed.empty()) return 0;
+	vector<pair<unsigned, int>> cell_cobjs; // {cell index, cobj}
+
+	for (auto i = removed.begin(); i != removed.end(); ++i) {
+		int x1, y1, x2, y2;
+		get_params(x1, y1, x2, y2, coll_objects[*i].d);
+
+		for (int y = y1; y <= y2; ++y) {
+			for (int x = x1; x <= x2; ++x) {cell_cobjs.emplace_back(y*MESH_X_SIZE + x, *i);}
+		}
+	}
+	sort(cell_cobjs.begin(), cell_cobjs.end());
+	vector<unsigned> cell_starts;
+
+	for (unsigned i = 0; i < cell_cobjs.size(); ++i) {
+		if (i == 0 || cell_cobjs[i].first != cell_cobjs[i-1].first) {cell_starts.push_back(i);}
+	}
+	cell_starts.push_back(cell_cobjs.size());
+
+#pragma omp parallel for schedule(dynamic,16) if (cell_cobjs.size() > 1000)
+	for (int c = 0; c < (int)cell_starts.size()-1; ++c) {
+		auto const begin(cell_cobjs.begin() + cell_starts[c]), end(cell_cobjs.begin() + cell_starts[c+1]); // sorted by cobj
+		unsigned const cell_ix(begin->first);
+		vector<int> &cvals(v_collision_matrix[cell_ix/MESH_X_SIZE][cell_ix%MESH_X_SIZE].cvals);
+		// can't change zmin or zmax (I think)
+		cvals.erase(std::remove_if(cvals.begin(), cvals.end(), [&](int cid) {
+			return std::binary_search(begin, end, make_pair(cell_ix, cid));}), cvals.end());
+	}
+	cobj_manager.free_indices(removed);
+	return removed.size();
+}
+
+
 int remove_reset_coll_obj(int &index) {
 
 	int const retval(remove_coll_object(index));
@@ -767,6 +1006,7 @@ void purge_coll_freed(bool force) {
 	if (!force && cobj_manager.cobjs_removed < PURGE_THRESH) return;
 	//RESET_TIME;
 
+#pragma omp parallel for schedule(dynamic,4) // each row of coll cells is independent
 	for (int i = 0; i < MESH_Y_SIZE; ++i) {
 		for (int j = 0; j < MESH_X_SIZE; ++j) {
 			bool changed(0);
@@ -795,11 +1035,17 @@ void purge_coll_freed(bool force) {
 			h_collision_matrix[i][j] = vcm.zmax; // need to think about add_to_hcm...
 		}
 	}
-	unsigned const ncobjs((unsigned)coll_objects.size());
+	int const ncobjs((int)coll_objects.size());
+	vector<vector<int>> freed(omp_get_max_threads_3dw());
 
-	for (unsigned i = 0; i < ncobjs; ++i) {
-		if (coll_objects[i].status == COLL_FREED) cobj_manager.free_index(i);
+	// find the freed cobjs in parallel; with a static schedule each thread's range is contiguous and in thread order,
+	// so concatenating the per-thread lists gives the freed cobjs in increasing order, which makes allocation order deterministic
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < ncobjs; ++i) {
+		if (coll_objects[i].status == COLL_FREED) {freed[omp_get_thread_num_3dw()].push_back(i);}
 	}
+	for (unsigned t = 1; t < freed.size(); ++t) {freed[0].insert(freed[0].end(), freed[t].begin(), freed[t].end());}
+	cobj_manager.free_indices(freed[0]);
 	cobj_manager.cobjs_removed = 0;
 	//PRINT_TIME("Purge");
 }
@@ -826,6 +1072,13 @@ void remove_all_coll_obj() {
 
 
 void coll_obj_group::set_coll_obj_props(int index, int type, float radius, float radius2, int platform_id, cobj_params const &cparams) {
+
+	init_coll_obj_props(index, type, radius, radius2, platform_id, cparams);
+	register_coll_obj(index);
+}
+
+// only writes to this cobj, so can be called from multiple threads for different indices
+void coll_obj_group::init_coll_obj_props(int index, int type, float radius, float radius2, int platform_id, cobj_params const &cparams) {
 	
 	coll_obj &cobj(at(index)); // Note: this is the *only* place a new cobj is allocated/created
 	cobj.texture_offset = zero_vector;
@@ -845,20 +1098,35 @@ void coll_obj_group::set_coll_obj_props(int index, int type, float radius, float
 	cobj.is_billboard= 0;
 	cobj.falling     = 0;
 	cobj.setup_internal_state();
-	if (cparams.flags & COBJ_DYNAMIC) {dynamic_ids.must_insert(index);}
+}
+
+// adds a cobj to the shared ID sets and flags; not thread safe
+void coll_obj_group::register_coll_obj(int index) {
+
+	coll_obj const &cobj(at(index));
+	cobj_params const &cparams(cobj.cp);
+	if (cparams.flags & COBJ_DYNAMIC) {dynamic_ids.must_insert(index); log_dynamic_change(index, 1);}
 	if (cparams.draw    ) {drawn_ids.must_insert   (index);}
-	if (platform_id >= 0) {platform_ids.must_insert(index);}
-	if ((type == COLL_CUBE || type == COLL_SPHERE) && cparams.light_atten != 0.0) {has_lt_atten = 1;}
+	if (cobj.platform_id >= 0) {platform_ids.must_insert(index);}
+	if ((cobj.type == COLL_CUBE || cobj.type == COLL_SPHERE) && cparams.light_atten != 0.0) {has_lt_atten = 1;}
 	if (cparams.cobj_type == COBJ_TYPE_VOX_TERRAIN) {has_voxel_cobjs = 1;}
 }
 
 
+// records a dynamic_ids change for the incremental update of the dynamic cobj tree
+void coll_obj_group::log_dynamic_change(int index, bool added) {
+
+	if (dynamic_ids_reset) return; // will be rebuilt anyway
+	(added ? dynamic_added : dynamic_removed).push_back(index);
+	if (dynamic_added.size() + dynamic_removed.size() > 2*dynamic_ids.size() + 1024) {clear_dynamic_log(1);} // not worth tracking
+}
+
 void coll_obj_group::remove_index_from_ids(int index) {
 
 	if (index < 0)  return;
 	coll_obj &cobj(at(index));
 	if (cobj.fixed) return; // won't actually be freed
-	if (cobj.status == COLL_DYNAMIC) {coll_objects.dynamic_ids.must_erase (index);}
+	if (cobj.status == COLL_DYNAMIC) {coll_objects.dynamic_ids.must_erase (index); log_dynamic_change(index, 0);}
 	if (cobj.cp.draw               ) {coll_objects.drawn_ids.must_erase   (index);}
 	if (cobj.platform_id >= 0      ) {coll_objects.platform_ids.must_erase(index);}
 	if (cobj.cgroup_id >= 0)         {cobj_groups.remove_cobj(cobj.cgroup_id, index);}
@@ -1028,7 +1296,7 @@ bool is_point_interior(point const &pos, float radius) { // is query point inter
 bool dwobject::proc_stuck(bool static_top_coll) {
 
 	float const friction(object_types[type].friction_factor);
-	if (friction < 2.0*STICK_THRESHOLD || friction < rand_uniform(2.0, 3.0)*STICK_THRESHOLD) return 0;
+	if (friction < 2.0*STICK_THRESHOLD || friction < obj_side_effects.rand_uniform(2.0, 3.0)*STICK_THRESHOLD) return 0;
 	flags |= (static_top_coll ? ALL_COLL_STOPPED : XYZ_STOPPED); // stuck in coll object
 	status = 4;
 	return 1;
@@ -1147,7 +1415,7 @@ void gen_explosion_decal(point const &pos, float radius, vector3d const &coll_no
 
 	if (!cobj.has_flat_top_bot() && cobj.type != COLL_CYLINDER_ROT) return;
 	if (!cobj.can_be_scorched()) return;
-	float const sz(5.0*radius*rand_uniform(0.8, 1.2));
+	float const sz(5.0*radius*obj_side_effects.rand_uniform(0.8, 1.2));
 	float max_sz(sz);
 
 	if (cobj.type == COLL_CUBE) {
@@ -1155,7 +1423,7 @@ void gen_explosion_decal(point const &pos, float radius, vector3d const &coll_no
 		if (max_sz < sz && decal_contained_in_union_cube_face(cobj, pos, coll_norm, sz, dim)) {max_sz = sz;} // check for full sized decal contained in split cubes
 	}
 	else if (cobj.type == COLL_POLYGON) {max_sz = min_dist_from_pt_to_polygon_edge(pos, cobj.points, cobj.npoints);} // may not be correct for extruded polygons
-	if (max_sz > 0.5*sz) {gen_decal(pos, min(sz, max_sz), coll_norm, FLARE3_TEX, cobj.id, colorRGBA(color, 0.75), 0, 1, 240*TICKS_PER_SECOND);} // explosion (4 min.)
+	if (max_sz > 0.5*sz) {obj_side_effects.gen_decal(pos, min(sz, max_sz), coll_norm, FLARE3_TEX, cobj.id, colorRGBA(color, 0.75), 0, 1, 240*TICKS_PER_SECOND);} // explosion (4 min.)
 }
 
 
@@ -1457,7 +1725,7 @@ void vert_coll_detector::check_cobj_intersect(int index, bool enable_cfs, bool p
 				assert(TIMESTEP > 0.0);
 				float friction_adj(friction);
 				if (norm.z > 0.25 && (cobj.is_wet() || cobj.is_snow_cov())) {friction_adj *= 0.25;} // slippery when wet, icy, or snow covered
-				if (friction_adj > 0.0) {obj.velocity *= (1.0 - min(1.0f, (tstep/TIMESTEP)*friction_adj));} // apply kinetic friction
+				if (friction_adj > 0.0) {obj.velocity *= (1.0 - min(1.0f, (dt/TIMESTEP)*friction_adj));} // apply kinetic friction
 				//for (unsigned i = 0; i < 3; ++i) {obj.velocity[i] *= (1.0 - fabs(norm[i]));} // norm must be normalized
 				orthogonalize_dir(obj.velocity, norm, obj.velocity, 0); // rolling friction model
 			}
@@ -1467,18 +1735,18 @@ void vert_coll_detector::check_cobj_intersect(int index, bool enable_cfs, bool p
 		}
 		else {
 			already_bounced = 1;
-			if (otype.flags & OBJ_IS_CYLIN) {obj.init_dir.x += PI*signed_rand_float();}
+			if (otype.flags & OBJ_IS_CYLIN) {obj.init_dir.x += PI*obj_side_effects.signed_rand_float();}
 			
 			if (cobj.status == COLL_STATIC) { // only static collisions to avoid camera/smiley bounce sounds
 				if (type == BALL) {
 					float const vmag(obj.velocity.mag());
-					if (vmag > 1.0) {gen_sound(SOUND_BOING, obj.pos, min(1.0, 0.1*vmag));}
+					if (vmag > 1.0) {obj_side_effects.gen_sound(SOUND_BOING, obj.pos, min(1.0, 0.1*vmag));}
 				}
 				else if (type == SAWBLADE) {
-					gen_sound(SOUND_RICOCHET, obj.pos, 1.0, 0.5);
+					obj_side_effects.gen_sound(SOUND_RICOCHET, obj.pos, 1.0, 0.5);
 					if (cobj.cp.elastic >= 0.5) {gen_particles(obj.pos, (1 + (rand()&3)), 0.5, 1);} // create spark particles
 				}
-				else if (type == SHELLC && obj.direction == 0) {gen_sound(SOUND_SHELLC, obj.pos, 0.1, 1.0);} // M16
+				else if (type == SHELLC && obj.direction == 0) {obj_side_effects.gen_sound(SOUND_SHELLC, obj.pos, 0.1, 1.0);} // M16
 			}
 		}
 	}
@@ -1507,6 +1775,12 @@ void vert_coll_detector::check_cobj_intersect(int index, bool enable_cfs, bool p
 		if (type == PLASMA) {energy_mult *= obj.init_dir.x*obj.init_dir.x;} // size squared
 		float const energy(get_coll_energy(v_old, obj.velocity, otype.mass));
 			
+		if (obj_side_effects.is_active()) { // parallel object update; coll funcs modify game state, so this object must be advanced serially
+			obj_side_effects.defer_obj();
+			lcoll = 0;
+			obj   = temp;
+			return;
+		}
 		if (!cobj.cp.coll_func(cobj.cp.cf_index, obj_index, v_old, obj.pos, energy_mult*energy, type)) { // invalid collision - reset local collision
 			lcoll = 0;
 			obj   = temp;
@@ -1516,7 +1790,8 @@ void vert_coll_detector::check_cobj_intersect(int index, bool enable_cfs, bool p
 	if (!(otype.flags & OBJ_IS_DROP) && type != LEAF && type != CHARRED && type != SHRAPNEL &&
 		type != BEAM && type != LASER && type != FIRE && type != SMOKE && type != PARTICLE && type != WAYPOINT)
 	{
-		coll_objects[index].register_coll(TICKS_PER_SECOND, IMPACT);
+		if (obj_side_effects.is_active()) {obj_side_effects.register_coll(index, TICKS_PER_SECOND, IMPACT);}
+		else {coll_objects[index].register_coll(TICKS_PER_SECOND, IMPACT);}
 	}
 	obj.verify_data();
 		
@@ -1530,22 +1805,22 @@ void vert_coll_detector::check_cobj_intersect(int index, bool enable_cfs, bool p
 		colorRGBA color;
 		tex_range_t tex_range;
 
-		if (type == BLOOD && (fabs(obj.velocity.z) > 1.0 || v0.z > 1.0) && !(obj.flags & STATIC_COBJ_COLL) && (rand()&1) == 0) { // only when on a not-bottom surface
+		if (type == BLOOD && (fabs(obj.velocity.z) > 1.0 || v0.z > 1.0) && !(obj.flags & STATIC_COBJ_COLL) && (obj_side_effects.rand_int()&1) == 0) { // only when on a not-bottom surface
 			blood_tid = BLUR_CENT_TEX; // blood droplet splat
 			color     = BLOOD_C;
 			sz_scale  = 2.0;
 		}
 		else if (type == CHUNK && !(obj.flags & (TYPE_FLAG | FROZEN_FLAG)) && (fabs(obj.velocity.z) > 1.0 || fabs(v0.z) > 1.0)) {
 			blood_tid = BLOOD_SPLAT_TEX; // bloody chunk splat
-			tex_range = tex_range_t::from_atlas((rand()&1), (rand()&1), 2, 2); // 2x2 texture atlas
+			tex_range = tex_range_t::from_atlas((obj_side_effects.rand_int()&1), (obj_side_effects.rand_int()&1), 2, 2); // 2x2 texture atlas
 			color     = WHITE; // color is in the texture
 			sz_scale  = 4.0;
 		}
 		if (blood_tid >= 0 && !(obj.flags & OBJ_COLLIDED)) { // only on first collision
-			float const sz(sz_scale*o_radius*rand_uniform(0.6, 1.4));
+			float const sz(sz_scale*o_radius*obj_side_effects.rand_uniform(0.6, 1.4));
 			
 			if (decal_contained_in_cobj(cobj, decal_pos, norm, sz, (cdir >> 1))) {
-				gen_decal((decal_pos - norm*o_radius), sz, norm, blood_tid, index, color, 0, (blood_tid == BLOOD_SPLAT_TEX), 60*TICKS_PER_SECOND, 1.0, tex_range);
+				obj_side_effects.gen_decal((decal_pos - norm*o_radius), sz, norm, blood_tid, index, color, 0, (blood_tid == BLOOD_SPLAT_TEX), 60*TICKS_PER_SECOND, 1.0, tex_range);
 			}
 		}
 		if (!(obj.flags & FROZEN_FLAG)) {deform_obj(obj, norm, v0);} // skip deformation of frozen chunks
@@ -1571,7 +1846,7 @@ void vert_coll_detector::init_reset_pos() {
 
 int vert_coll_detector::check_coll() {
 
-	pold -= obj.velocity*tstep;
+	pold -= obj.velocity*dt;
 	assert(!is_nan(pold));
 	assert(type >= 0 && type < NUM_TOT_OBJS);
 	o_radius = obj.get_true_radius();
@@ -1583,7 +1858,10 @@ int vert_coll_detector::check_coll() {
 		return coll;
 	}
 	for (int d = 0; d < 1+!skip_dynamic; ++d) { // using v_collision_matrix doesn't seem to help
-		get_coll_sphere_cobjs_tree(obj.pos, o_radius, -1, *this, (d != 0));
+		if (d == 0 && obj_broadphase.check_static_cobjs(obj, obj_index, o_radius, *this)) { // static cobjs were found in the broadphase
+			get_voxel_coll_sphere_cobjs(obj.pos, o_radius, -1, *this);
+		}
+		else {get_coll_sphere_cobjs_tree(obj.pos, o_radius, -1, *this, (d != 0));}
 	}
 	return coll;
 }
@@ -1592,12 +1870,91 @@ int vert_coll_detector::check_coll() {
 // ************ end vert_coll_detector ************
 
 
+void obj_coll_broadphase_t::begin_group(dwobject const *objs_, unsigned num_objs) {
+	assert(!is_active());
+	assert(objs_ != nullptr);
+	group_objs     = objs_;
+	num_group_objs = num_objs;
+	objs.clear();
+	cands.clear();
+	obj_cands.clear();
+}
+void obj_coll_broadphase_t::end_group() {group_objs = nullptr; num_group_objs = 0;}
+
+void obj_coll_broadphase_t::add_obj(dwobject const &obj, unsigned obj_ix, float radius, float time, float grav_dz) {
+	assert(obj_ix < num_group_objs);
+	point p2(obj.pos + obj.velocity*time);
+	p2.z -= grav_dz;
+	cube_t bcube(obj.pos, p2);
+	bcube.expand_by(2.0*radius); // add some extra padding for bounces
+	objs.emplace_back(bcube, obj_ix);
+}
+
+void obj_coll_broadphase_t::add_batch(unsigned start, unsigned end) {
+	assert(start < end);
+	cube_t batch_bcube(objs[start]);
+	for (unsigned i = start+1; i < end; ++i) {batch_bcube.union_with_cube(objs[i]);}
+	batch_cobjs.clear();
+	get_intersecting_cobjs_tree(batch_bcube, batch_cobjs, -1, 0.0, 0, 0, -1); // static + static moving cobjs, in BVH order
+
+	for (unsigned i = start; i < end; ++i) {
+		cand_range_t &cr(obj_cands[objs[i].obj_ix]);
+		cr.bcube = objs[i];
+		cr.start = cands.size();
+
+		for (auto c = batch_cobjs.begin(); c != batch_cobjs.end(); ++c) {
+			if (coll_objects[*c].intersects(cr.bcube)) {cands.push_back(*c);}
+		}
+		cr.end = cands.size();
+	} // for i
+}
+
+void obj_coll_broadphase_t::build() {
+	assert(is_active());
+	obj_cands.resize(num_group_objs);
+	built_change_count = static_cobjs_change_count;
+	if (objs.empty()) return;
+	float const max_batch_sz(BROADPHASE_BATCH_SZ*max(DX_VAL, DY_VAL));
+	sort(objs.begin(), objs.end(), [](swept_obj_t const &a, swept_obj_t const &b) {return (a.x1() < b.x1());}); // sweep in x
+
+	for (unsigned slab_start = 0; slab_start < objs.size();) {
+		unsigned slab_end(slab_start+1);
+		while (slab_end < objs.size() && objs[slab_end].x1() < objs[slab_start].x1() + max_batch_sz) {++slab_end;}
+		sort((objs.begin() + slab_start), (objs.begin() + slab_end), [](swept_obj_t const &a, swept_obj_t const &b) {return (a.y1() < b.y1());}); // split in y
+
+		for (unsigned batch_start = slab_start; batch_start < slab_end;) {
+			unsigned batch_end(batch_start+1);
+			while (batch_end < slab_end && objs[batch_end].y1() < objs[batch_start].y1() + max_batch_sz) {++batch_end;}
+			add_batch(batch_start, batch_end);
+			batch_start = batch_end;
+		}
+		slab_start = slab_end;
+	} // for slab_start
+}
+
+// returns 1 if the static cobjs were checked, 0 if the caller must query the cobj BVH
+bool obj_coll_broadphase_t::check_static_cobjs(dwobject const &obj, int obj_index, float radius, vert_coll_detector &vcd) const {
+	if (!is_active() || obj_index < 0 || (unsigned)obj_index >= num_group_objs || &obj != (group_objs + obj_index)) return 0; // not an object in this group
+	if ((unsigned)obj_index >= obj_cands.size()) return 0; // not yet built
+	if (built_change_count != static_cobjs_change_count) return 0; // static cobjs changed since build (destroyed, fragmented, etc.), candidates may be stale
+	cand_range_t const &cr(obj_cands[obj_index]);
+	cube_t bcube(obj.pos, obj.pos);
+	bcube.expand_by(radius);
+	if (!cr.bcube.contains_cube(bcube)) return 0; // not added, or object moved outside its swept bcube
+
+	for (unsigned i = cr.start; i < cr.end; ++i) {
+		if (coll_objects[cands[i]].intersects(bcube)) {vcd.check_cobj(cands[i]);}
+	}
+	return 1;
+}
+
+
 // 0 = no vert coll, 1 = X coll, 2 = Y coll, 3 = X + Y coll
-int dwobject::check_vert_collision(int obj_index, int do_coll_funcs, int iter, vector3d *cnorm,
+int dwobject::check_vert_collision(int obj_index, int do_coll_funcs, int iter, float dt, vector3d *cnorm,
 	vector3d const &mdir, bool skip_dynamic, bool only_drawn, int only_cobj, bool skip_movable)
 {
 	if (world_mode == WMODE_INF_TERRAIN) {
-		point const p_last(pos - velocity*tstep);
+		point const p_last(pos - velocity*dt);
 		float const o_radius(get_true_radius());
 		vector3d cnorm(plus_z);
 		bool const check_interior(PLAYER_CAN_ENTER_BUILDINGS && type == CAMERA);
@@ -1610,7 +1967,7 @@ int dwobject::check_vert_collision(int obj_index, int do_coll_funcs, int iter, v
 			if (friction < STICK_THRESHOLD) {
 				if (otype.elasticity == 0.0 || (flags & IS_CUBE_FLAG) || !object_bounce(3, cnorm, 0.8, 0.0)) { // elasticity is hard-coded to 0.8 here
 					if (type != DYNAM_PART && velocity != zero_vector) {
-						if (friction > 0.0) {velocity *= (1.0 - min(1.0f, (tstep/TIMESTEP)*friction));} // apply kinetic friction
+						if (friction > 0.0) {velocity *= (1.0 - min(1.0f, (dt/TIMESTEP)*friction));} // apply kinetic friction
 						orthogonalize_dir(velocity, cnorm, velocity, 0); // rolling friction model
 					}
 				}
@@ -1633,7 +1990,7 @@ int dwobject::check_vert_collision(int obj_index, int do_coll_funcs, int iter, v
 		return 0; // no vert coll
 	}
 	if (world_mode != WMODE_GROUND) return 0;
-	vert_coll_detector vcd(*this, obj_index, do_coll_funcs, iter, cnorm, mdir, skip_dynamic, only_drawn, only_cobj, skip_movable);
+	vert_coll_detector vcd(*this, obj_index, do_coll_funcs, iter, cnorm, dt, mdir, skip_dynamic, only_drawn, only_cobj, skip_movable);
 	return vcd.check_coll();
 }
 
@@ -1645,7 +2002,7 @@ int dwobject::multistep_coll(point const &last_pos, int obj_index, unsigned nste
 	float const dist(cmove.mag()); // 0.018
 
 	if (dist < 1.0E-6 || nsteps == 1) {
-		any_coll |= check_vert_collision(obj_index, 1, 0); // collision detection
+		any_coll |= check_vert_collision(obj_index, 1, 0, tstep); // collision detection
 	}
 	else {
 		float const step(dist/(float)nsteps);
@@ -1656,7 +2013,7 @@ int dwobject::multistep_coll(point const &last_pos, int obj_index, unsigned nste
 		for (unsigned i = 0; i < nsteps && !disabled(); ++i) {
 			point const lpos(pos);
 			pos      += cmove*step;
-			any_coll |= check_vert_collision(obj_index, (i==nsteps-1), 0, NULL, dpos); // collision detection
+			any_coll |= check_vert_collision(obj_index, (i==nsteps-1), 0, tstep, NULL, dpos); // collision detection
 
 			if (type == CAMERA && !camera_change) {
 				for (unsigned d = 0; d < 2; ++d) { // x,y
@@ -314,12 +314,16 @@ class coll_obj_group : public vector<coll_obj> {
 public:
 	bool has_lt_atten, has_voxel_cobjs;
 	cobj_id_set_t dynamic_ids, drawn_ids, platform_ids;
+	vector<int> dynamic_added, dynamic_removed; // changes to dynamic_ids since the last dynamic cobj tree update
+	bool dynamic_ids_reset; // too many changes to track, or IDs cleared; the dynamic cobj tree must be rebuilt
 	vector<vector<unsigned>> to_draw_streams;
 	unsigned cur_draw_stream_id;
 	vector<unsigned> temp_cobjs; // temporary to avoid repeated memory allocation
 
-	coll_obj_group() : has_lt_atten(0), has_voxel_cobjs(0), cur_draw_stream_id(0) {to_draw_streams.resize(6);}
+	coll_obj_group() : has_lt_atten(0), has_voxel_cobjs(0), dynamic_ids_reset(1), cur_draw_stream_id(0) {to_draw_streams.resize(6);}
 	void clear_ids();
+	void log_dynamic_change(int index, bool added);
+	void clear_dynamic_log(bool reset) {dynamic_added.clear(); dynamic_removed.clear(); dynamic_ids_reset = reset;}
 	void clear();
 	void finalize();
 	void remove_invalid_cobjs();
@@ -330,6 +334,8 @@ public:
 	void subdiv_cubes();
 	void sort_cobjs_for_rendering();
 	void set_coll_obj_props(int index, int type, float radius, float radius2, int platform_id, cobj_params const &cparams);
+	void init_coll_obj_props(int index, int type, float radius, float radius2, int platform_id, cobj_params const &cparams);
+	void register_coll_obj(int index);
 	void remove_index_from_ids(int index);
 	vector<unsigned> &get_draw_stream(unsigned stream_id) {assert(stream_id < to_draw_streams.size()); return to_draw_streams[stream_id];}
 	vector<unsigned> &get_cur_draw_stream() {return get_draw_stream(cur_draw_stream_id);}
@@ -430,6 +436,8 @@ struct coll_tquad : public tquad_t { // size = 68
 
 void copy_polygon_to_cobj(polygon_t const &poly, coll_obj &cobj);
 void copy_tquad_to_cobj(coll_tquad const &tquad, coll_obj &cobj);
+void add_simple_coll_polygons(vector<coll_tquad> const &polys, vector<unsigned char> const &cp_ixs, cobj_params const *const cparams, vector<unsigned> &cids, bool fixed);
+void register_simple_coll_polygons(vector<unsigned> const &cids, int dhcm=0);
 
 
 struct coll_cell { // size = 52
@@ -489,6 +497,7 @@ class platform { // animated (player controlled) scene object
 	float cur_angle; // current angle, for rotating platforms
 	point pos; // current position for translating platforms - dist is calculated from this point (delta = pos-origin)
 	vector3d delta; // last change in position
+	bool moved; // cobjs were moved (translated or rotated) this frame
 
 	multi_trigger_t triggers;
 	sensor_t sensor;
@@ -506,7 +515,8 @@ public:
 	platform(float fs=1.0, float rs=1.0, float sd=0.0, float rd=0.0, float dst=1.0, float ad=0.0, point const &o=all_zeros,
 		vector3d const &dir_=plus_z, bool c=0, bool ir=0, bool ul=0, bool destroys_=0, int sid=-1, sensor_t const &cur_sensor=sensor_t());
 	void add_triggers(multi_trigger_t const &t) {triggers.add_triggers(t);} // deep copy
-	bool has_dynamic_shadows() const {return (cont || state >= ST_FWD);}
+	bool has_dynamic_shadows() const {return (cont || state >= ST_FWD);}
+	bool cobjs_moved()         const {return moved;}
 	bool get_update_light()    const {return update_light;}
 	vector3d get_delta()       const {return (pos - origin);}
 	vector3d get_range()       const {return (is_rot ? zero_vector : dir*ext_dist);}
@@ -516,7 +526,7 @@ public:
 	void clear_last_delta() {delta = all_zeros;}
 	void add_cobj(unsigned cobj);
 	void add_light(unsigned light) {lights.push_back(light);}
-	void next_frame() {delta = all_zeros;}
+	void next_frame() {delta = all_zeros; moved = 0;}
 	void clear_cobjs() {cobjs.clear();}
 	void shift_by(vector3d const &val);
 	void reset();
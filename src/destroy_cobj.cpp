@@ -257,6 +257,10 @@ void add_to_falling_cobjs(set<unsigned> const &ids) {
 
 void invalidate_static_cobjs() {build_cobj_tree(0, 0);}
 
+void invalidate_static_cobjs(vector<int> const &removed, vector<int> const &added) {
+	if (!update_static_cobj_trees(removed, added)) {invalidate_static_cobjs();} // full rebuild
+}
+
 
 // Note: should be named partially_destroy_cube_area() or something like that
 unsigned subtract_cube(vector<color_tid_vol> &cts, vector3d &cdir, csg_cube const &cube_in, int min_destroy) {
@@ -355,7 +359,7 @@ unsigned subtract_cube(vector<color_tid_vol> &cts, vector3d &cdir, csg_cube cons
 		cobjs[*i].remove_waypoint();
 		remove_coll_object(*i); // remove old collision object
 	}
-	if (!to_remove.empty()) {invalidate_static_cobjs();} // after destroyed cobj removal
+	if (!to_remove.empty()) {invalidate_static_cobjs(to_remove, just_added);} // after destroyed cobj removal
 
 	// add new waypoints (after build_cobj_tree and end_batch)
 	for (vector<int>::const_iterator i = just_added.begin(); i != just_added.end(); ++i) {
@@ -7,7 +7,10 @@
 #include "timetest.h"
 #include "physics_objects.h"
 #include "model3d.h"
+#include "profiler.h"
 #include <fstream>
+#include <sstream>
+#include <atomic>
 
 
 /* lights used:
@@ -32,6 +35,8 @@ float const LIGHT_W_VAL        = 0.0; // 0 = directional/light at infinity, 1 =
 float const C_RADIUS0          = 0.01;
 float const CR_SCALE           = 0.1;
 float const FOG_COLOR_ATTEN    = 0.75;
+unsigned const CAMERA_PATH_DEF_FRAMES = 60; // frames between keyframes if not specified
+unsigned const CAMERA_PATH_WARMUP     = 4;  // frames held at the first keyframe before timing starts
 
 
 bool mesh_invalidated(1), fog_enabled(0), tt_fire_button_down(0);
@@ -45,8 +50,9 @@ string lighting_update_text;
 
 
 extern bool combined_gu, have_sun, clear_landscape_vbo, show_lightning, spraypaint_mode, enable_depth_clamp, enable_multisample, water_is_lava;
-extern bool user_action_key, flashlight_on, enable_clip_plane_z, begin_motion, config_unlimited_weapons, start_maximized;
-extern unsigned inf_terrain_fire_mode, reflection_tid;
+extern bool user_action_key, flashlight_on, enable_clip_plane_z, begin_motion, config_unlimited_weapons, start_maximized, univ_lockstep_time, show_telemetry;
+extern unsigned inf_terrain_fire_mode, reflection_tid, univ_sim_bench_frames;
+extern std::atomic<unsigned long long> tot_rays, num_hits;
 extern int auto_time_adv, camera_flight, reset_timing, run_forward, window_width, window_height, voxel_editing, UNLIMITED_WEAPONS;
 extern int advanced, b2down, dynamic_mesh_scroll, spectate, animate2, used_objs, disable_inf_terrain, DISABLE_WATER;
 extern float TIMESTEP, NEAR_CLIP, FAR_CLIP, cloud_cover, univ_sun_rad, atmosphere, vegetation, zmin, zbottom, ztop, ocean_wave_height, brightness;
@@ -59,8 +65,12 @@ extern water_params_t water_params;
 extern lightning_t l_strike;
 extern vector<camera_filter> cfilters;
 extern reflective_cobjs_t reflective_cobjs;
+extern coll_obj_group coll_objects;
 
 void check_xy_offsets();
+void quit_3dworld();
+void set_camera_pos_dir(point const &pos, vector3d const &dir);
+vector3d get_global_camera_space_offset();
 void post_window_redisplay();
 void display_universe();
 void display_inf_terrain();
@@ -259,6 +269,163 @@ void log_location(point const &pos) {
 }
 
 
+void publish_frame_telemetry() { // values owned by this file or without a better place to publish them
+
+	if (!telemetry_enabled) return;
+	static unsigned long long last_rays(0), last_hits(0);
+	unsigned long long const rays(tot_rays.load()), hits(num_hits.load());
+	telemetry_set_gauge("tex_gpu_mb",   get_loaded_textures_gpu_mem()/double(1<<20));
+	telemetry_set_gauge("model_gpu_mb", get_loaded_models_gpu_mem ()/double(1<<20));
+	telemetry_set_gauge("num_cobjs",    coll_objects.size());
+	telemetry_add_count("rays_traced",  ((rays >= last_rays) ? (rays - last_rays) : rays)); // handle counter reset
+	telemetry_add_count("ray_hits",     ((hits >= last_hits) ? (hits - last_hits) : hits));
+	last_rays = rays;
+	last_hits = hits;
+}
+
+
+void draw_telemetry_overlay() {
+
+	string const text(get_telemetry_overlay_text());
+	float const ar(((float)window_width)/((float)window_height));
+	float y(0.010);
+
+	for (size_t pos = 0; pos < text.size();) {
+		size_t const end(text.find('\n', pos));
+		draw_text(YELLOW, -0.011*ar, y, -0.02, text.substr(pos, (end - pos)), 0.8);
+		y  -= 0.0005;
+		if (end == string::npos) break;
+		pos = end + 1;
+	}
+}
+
+
+// scripted camera path benchmark: moves the player along a list of keyframes with a fixed timestep for a fixed number of frames,
+// then writes frame time and frame profiler zone stats to a report file and exits;
+// each line of the path file is "x y z dx dy dz [frames]": player pos in global space, view dir, and frames to reach the next keyframe
+class camera_path_bench_t {
+	struct keyframe_t {
+		point pos;
+		vector3d dir;
+		unsigned frames;
+		keyframe_t(point const &pos_, vector3d const &dir_, unsigned frames_) : pos(pos_), dir(dir_), frames(frames_) {}
+	};
+	vector<keyframe_t> keys;
+	vector<float> frame_ms;
+	string path_fn;
+	unsigned num_frames=0, path_len=0, cur_frame=0;
+	bool active=0;
+	high_resolution_clock::time_point last_time;
+
+	void get_pos_dir(unsigned frame, point &pos, vector3d &dir) const {
+		if (path_len > 0) {
+			unsigned f(frame % path_len); // loop the path if more frames were requested than it contains
+
+			for (unsigned i = 0; i+1 < keys.size(); ++i) {
+				keyframe_t const &k1(keys[i]), &k2(keys[i+1]);
+				if (f >= k1.frames) {f -= k1.frames; continue;}
+				float const t(float(f)/float(k1.frames));
+				pos = k1.pos*(1.0 - t) + k2.pos*t;
+				dir = k1.dir*(1.0 - t) + k2.dir*t;
+				dir = ((dir.mag() < TOLERANCE) ? k2.dir : dir.get_norm()); // opposing directions
+				return;
+			}
+		}
+		pos = keys.back().pos;
+		dir = keys.back().dir;
+	}
+	void write_report(string const &fn) const {
+		std::ofstream out(fn);
+		if (!out.good()) {cout << "Error: Failed to open camera path report file " << fn << " for writing" << endl; return;}
+		vector<float> v(frame_ms);
+		sort(v.begin(), v.end());
+		double total(0.0);
+		for (auto i = v.begin(); i != v.end(); ++i) {total += *i;}
+		auto pct([&v](float p) {return v[min(v.size()-1, size_t(p*v.size()))];});
+		double const avg(total/max(v.size(), (size_t)1));
+		out << "Camera path: " << path_fn << ", " << keys.size() << " keyframes, " << v.size() << " frames, " << CAMERA_PATH_WARMUP << " warmup frames" << endl;
+		out << "World mode: " << world_mode << ", window: " << window_width << "x" << window_height << endl;
+		out << "Frame time ms: min " << v.front() << " avg " << avg << " p50 " << pct(0.5) << " p95 " << pct(0.95) << " p99 " << pct(0.99) << " max " << v.back() << endl;
+		out << "Avg FPS: " << ((avg > 0.0) ? 1000.0/avg : 0.0) << endl << endl;
+		write_frame_profiler_stats(out);
+		out << endl << "Frame times ms:" << endl;
+		for (auto i = frame_ms.begin(); i != frame_ms.end(); ++i) {out << *i << endl;}
+		if (!out.good()) {cout << "Error: Failed to write camera path report file " << fn << endl; return;}
+		cout << "Wrote camera path benchmark report to " << fn << endl;
+	}
+public:
+	bool load(string const &fn, unsigned num_frames_) {
+		std::ifstream in(fn);
+		if (!in.good()) {cout << "Error: Failed to open camera path file " << fn << endl; return 0;}
+		keys.clear();
+		string line;
+
+		for (unsigned line_num = 1; std::getline(in, line); ++line_num) {
+			size_t const start(line.find_first_not_of(" \t\r"));
+			if (start == string::npos || line[start] == '#') continue; // blank line or comment
+			std::istringstream iss(line);
+			point pos;
+			vector3d dir;
+			unsigned frames(0);
+
+			if (!(iss >> pos.x >> pos.y >> pos.z >> dir.x >> dir.y >> dir.z) || dir == zero_vector) {
+				cout << "Error: Invalid keyframe in camera path file " << fn << " line " << line_num << ": " << line << endl;
+				return 0;
+			}
+			if (!(iss >> frames)) {frames = CAMERA_PATH_DEF_FRAMES;} // optional
+			keys.emplace_back(pos, dir.get_norm(), max(frames, 1U));
+		}
+		if (keys.empty()) {cout << "Error: No keyframes in camera path file " << fn << endl; return 0;}
+		path_fn  = fn;
+		path_len = 0;
+		for (unsigned i = 0; i+1 < keys.size(); ++i) {path_len += keys[i].frames;} // the last keyframe's frame count is unused
+		num_frames = ((num_frames_ > 0) ? num_frames_ : (path_len + 1)); // default is one pass, ending on the last keyframe
+		cur_frame  = 0;
+		active     = 1;
+		frame_ms.clear();
+		frame_ms.reserve(num_frames);
+		frame_profiler_enabled = 1; // for per-subsystem timing
+		cout << "Running camera path benchmark " << fn << " with " << keys.size() << " keyframes for " << num_frames << " frames" << endl;
+		return 1;
+	}
+	bool is_active() const {return active;}
+
+	void next_frame() { // call once per frame, before the camera is updated
+		if (!active) return;
+
+		if (world_mode == WMODE_UNIVERSE) {
+			cout << "Error: Camera path benchmark is not supported in universe mode" << endl;
+			active = 0;
+			return;
+		}
+		high_resolution_clock::time_point const now(high_resolution_clock::now());
+		if (cur_frame > CAMERA_PATH_WARMUP) {frame_ms.push_back(1000.0*duration_cast<duration<double>>(now - last_time).count());} // previous frame
+		last_time = now;
+		if (cur_frame == CAMERA_PATH_WARMUP) {clear_frame_profiler();} // drop zones from warmup frames
+
+		if (cur_frame == CAMERA_PATH_WARMUP + num_frames) { // done
+			write_report("camera_path_report.txt");
+			export_frame_profiler_chrome_trace("camera_path_profile.json");
+			active = 0;
+			quit_3dworld();
+			return;
+		}
+		point pos;
+		vector3d dir;
+		get_pos_dir((max(cur_frame, CAMERA_PATH_WARMUP) - CAMERA_PATH_WARMUP), pos, dir);
+		set_camera_pos_dir((pos - get_global_camera_space_offset()), dir); // convert to local camera space
+		camera_mode = 1; // walking mode, so that the camera is placed at surface_pos
+		camera_surf_collide = 0; // don't snap to the mesh or collide with objects
+		run_forward = 0;
+		++cur_frame;
+	}
+};
+
+camera_path_bench_t camera_path_bench;
+
+bool load_camera_path_bench(string const &fn, unsigned num_frames) {return camera_path_bench.load(fn, num_frames);}
+
+
 void draw_frame_rate(float framerate) {
 
 	if (show_framerate) {
@@ -275,6 +442,7 @@ void draw_frame_rate(float framerate) {
 		draw_framerate(fr2);
 		++fr_counter;
 	}
+	if (show_telemetry && !is_video_recording()) {draw_telemetry_overlay();}
 }
 
 
@@ -736,15 +904,20 @@ void display() {
 	RESET_TIME;
 	static int init(0), frame_index(0), time_index(0), global_time(0), tticks(0);
 	static point old_spos(0.0, 0.0, 0.0);
+	prof_next_frame(); // aggregate zones from the previous frame
+	publish_frame_telemetry();
+	telemetry_next_frame();
+	PROFILE_ZONE("Frame");
 	++cur_display_iter;
-	proc_kbd_events();
+	camera_path_bench.next_frame();
+	if (!camera_path_bench.is_active()) {proc_kbd_events();} // ignore held keys when the camera is scripted
 
 	if (!init) { // the first frame
 		init   = 1;
 		fticks = 1.0;
 		time0  = timer1;
 	}
-	else if (animate && !DETERMINISTIC_TIME) {
+	else if (animate && !DETERMINISTIC_TIME && !(univ_lockstep_time && world_mode == WMODE_UNIVERSE) && !camera_path_bench.is_active()) { // lockstep time makes recorded universe events replay the same way
 		double ftick(0.0);
 		static float carry(0.0);
 		double const time_delta((TICKS_PER_SECOND*(timer1 - time0))/1000.0f);
@@ -900,6 +1073,7 @@ void display() {
 			if (TIMETEST) PRINT_TIME("B");
 		}
 		if (world_mode == WMODE_INF_TERRAIN) { // infinite terrain mode
+			PROFILE_ZONE("Draw Tiled Terrain");
 			display_inf_terrain();
 		}
 		else { // finite terrain mode
@@ -914,7 +1088,10 @@ void display() {
 			if (TIMETEST) PRINT_TIME("D");
 
 			// run physics and collision detection
-			process_groups();
+			{
+				PROFILE_ZONE("Process Groups");
+				process_groups();
+			}
 			check_gl_error(12);
 			if (TIMETEST) PRINT_TIME("E");
 			if (b2down) {fire_weapon();}
@@ -932,10 +1109,15 @@ void display() {
 
 			// create shadow map
 			if (combined_gu) {do_look_at();}
-			create_shadow_map(); // where should this go? must be after draw_universe_bkg()
+			{
+				PROFILE_ZONE("Shadow Map");
+				create_shadow_map(); // where should this go? must be after draw_universe_bkg()
+			}
 			if (TIMETEST) PRINT_TIME("G");
-
-			create_reflection_and_portal_textures();
+			{
+				PROFILE_ZONE("Reflections");
+				create_reflection_and_portal_textures();
+			}
 
 			// draw background
 			if (combined_gu) {draw_universe_bkg(0);} // infinite universe as background
@@ -959,7 +1141,10 @@ void display() {
 			draw_camera_weapon(0);
 			if (TIMETEST) PRINT_TIME("H");
 
-			draw_coll_surfaces(0, 0);
+			{
+				PROFILE_ZONE("Draw Cobjs");
+				draw_coll_surfaces(0, 0);
+			}
 			if (TIMETEST) PRINT_TIME("I");
 			
 			if (display_mode & 0x01) {display_mesh();} // draw mesh
@@ -1070,7 +1255,10 @@ void display_universe() { // infinite universe
 	check_gl_error(30);
 	auto_advance_camera();
 	if (TIMETEST) PRINT_TIME("\nSetup");
-	apply_univ_physics(); // physics loop
+	{
+		PROFILE_ZONE("Univ Physics");
+		apply_univ_physics(); // physics loop
+	}
 	if (TIMETEST) PRINT_TIME("Physics");
 	int const last_csc(camera_surf_collide);
 	camera_mode         = 1;
@@ -1082,7 +1270,10 @@ void display_universe() { // infinite universe
 	do_look_at();
 	if (b2down) {fire_weapon();} // just sets fire_key=1
 	check_gl_error(31);
-	draw_universe();
+	{
+		PROFILE_ZONE("Draw Universe");
+		draw_universe();
+	}
 	check_gl_error(32);
 	if (TIMETEST) PRINT_TIME("Draw Universe");
 	draw_universe_blasts();
@@ -1092,6 +1283,11 @@ void display_universe() { // infinite universe
 	if (display_framerate && !is_video_recording()) {draw_universe_stats();}
 	camera_surf_collide = last_csc;
 	check_gl_error(33);
+
+	if (univ_sim_bench_frames > 0) { // run the simulation benchmark once the universe has been generated and drawn, then exit
+		run_univ_sim_benchmark(univ_sim_bench_frames);
+		quit_3dworld();
+	}
 }
 
 
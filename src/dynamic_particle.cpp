@@ -22,7 +22,7 @@ dpart_params_t dp_params;
 
 extern bool begin_motion, enable_dpart_shadows;
 extern int window_width, iticks, animate2, display_mode, frame_counter;
-extern float zbottom, ztop, fticks, base_gravity, TIMESTEP, XY_SCENE_SIZE;
+extern float zbottom, ztop, fticks, tstep, base_gravity, TIMESTEP, XY_SCENE_SIZE;
 extern obj_type object_types[];
 extern vector<light_source_trig> light_sources_d;
 
@@ -105,7 +105,7 @@ void dynamic_particle::apply_physics(float stepsize, int index) { // begin_motio
 		dwobject obj(DYNAM_PART, pos, velocity, 1, 10000.0); // make a DYNAM_PART object for collision detection
 		object_types[DYNAM_PART].radius = radius;
 		//obj.multistep_coll(last_pos, index, NUM_COLL_STEPS);
-		obj.check_vert_collision(index, 0, 0); // ignoring return value
+		obj.check_vert_collision(index, 0, 0, tstep); // ignoring return value
 		pos = obj.pos;
 		float const vmag(obj.velocity.mag());
 		if (vmag > TOLERANCE) {velocity = obj.velocity*(velocity.mag()/vmag);} // same magnitude
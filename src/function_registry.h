@@ -9,6 +9,7 @@ struct xform_matrix;
 struct cube_with_zval_t;
 
 int omp_get_thread_num_3dw();
+int omp_get_max_threads_3dw();
 
 // function prototypes - main (3DWorld.cpp, etc.)
 bool get_gl_error(unsigned loc_id=0);
@@ -43,6 +44,9 @@ bool is_alt_key_pressed();
 // function prototypes - visibility
 void calc_mesh_shadows(unsigned l, point const &lpos, float const *const mh, unsigned char *smask, int xsize, int ysize,
 					   float const *sh_in_x=NULL, float const *sh_in_y=NULL, float *sh_out_x=NULL, float *sh_out_y=NULL);
+void calc_mesh_horizons(float const *const mh, int xsize, int ysize, unsigned num_az, vector<unsigned char> &horizons);
+void calc_mesh_shadows_from_horizons(unsigned l, point const &lpos, vector<unsigned char> const &horizons, unsigned num_az,
+	unsigned char *smask, int xsize, int ysize);
 void calc_visibility(unsigned light_sources);
 bool is_visible_to_light_cobj(point const &pos, int light, float radius, int cobj, int skip_dynamic, int *cobj_ix=NULL);
 bool coll_pt_vis_test(point pos, point pos2, float dist, int &index, int cobj, int skip_dynamic, int test_alpha);
@@ -88,6 +92,7 @@ point get_sun_pos();
 point get_moon_pos();
 colorRGBA get_bkg_color(point const &p1, vector3d const &v12);
 void draw_scene_from_custom_frustum(pos_dir_up const &pdu, int cobj_id, int reflection_pass, bool inc_mesh, bool inc_grass, bool inc_water);
+bool load_camera_path_bench(std::string const &fn, unsigned num_frames);
 
 // function prototypes - draw_world
 void set_fill_mode();
@@ -295,6 +300,7 @@ void draw_underwater_particles(float terrain_zmin);
 
 // function prototypes - map_view
 void draw_overhead_map();
+bool write_map_tiles_headless(std::string const &dir, unsigned max_zoom, float x1, float y1, float x2, float y2);
 
 // function prototypes - gen_obj
 void gen_and_draw_stars(float alpha, bool half_sphere=0, bool no_update=0);
@@ -321,6 +327,7 @@ bool bmp_to_chars(char const *const fname, unsigned char **&data);
 void gen_mesh(int surface_type, int keep_sin_table, int update_zvals);
 float do_glaciate_exp(float value);
 float get_rel_wpz();
+uint64_t get_mesh_gen_params_hash();
 void init_terrain_mesh();
 float eval_mesh_sin_terms(float xv, float yv);
 float get_exact_zval(float xval, float yval);
@@ -423,6 +430,7 @@ int  add_coll_sphere(point const &pt, float radius, cobj_params const &cparams,
 int  add_coll_polygon(const point *points, int npoints, cobj_params const &cparams, float thickness, int platform_id=-1, int dhcm=0);
 int  add_simple_coll_polygon(const point *points, int npoints, cobj_params const &cparams, vector3d const &normal, int dhcm=0);
 int  remove_coll_object(int index, bool reset_draw=1);
+unsigned remove_coll_objects(vector<unsigned> const &cids, bool reset_draw=1);
 int  remove_reset_coll_obj(int &index);
 void purge_coll_freed(bool force);
 void remove_all_coll_obj();
@@ -445,7 +453,9 @@ void free_cobj_draw_group_vbos();
 
 // function prototypes - coll_cell_search
 void build_static_moving_cobj_tree();
+void invalidate_moving_cobj_trees();
 void build_cobj_tree(bool dynamic=0, bool verbose=1);
+bool update_static_cobj_trees(vector<int> const &removed, vector<int> const &added);
 bool check_coll_line_exact_tree(point const &p1, point const &p2, point &cpos, vector3d &cnorm, int &cindex, int ignore_cobj,
 	bool dynamic=0, int test_alpha=0, bool skip_non_drawn=0, bool include_voxels=1, bool skip_init_colls=0, bool skip_movable=0, bool no_stat_moving=0);
 bool check_coll_line_tree(point const &p1, point const &p2, int &cindex, int ignore_cobj, bool dynamic=0, int test_alpha=0,
@@ -790,6 +800,7 @@ void init_universe_display();
 void set_univ_pdu();
 void setup_current_system(float sun_intensity=1.0);
 void apply_univ_physics();
+void run_univ_sim_benchmark(unsigned num_frames);
 void draw_universe(bool static_only=0, bool skip_closest=0, bool no_move=0, int no_distant=0, bool gen_only=0, bool no_asteroid_dust=0);
 void draw_universe_stats();
 void clear_univ_obj_contexts();
@@ -1021,6 +1032,8 @@ int create_buildings_tile(int x, int y, bool allow_flatten);
 bool remove_buildings_tile(int x, int y);
 void free_building_indir_texture();
 void end_building_rt_job();
+void end_building_rt_job_and_flush_cache();
+float get_building_indir_cell_xy_size();
 
 // function prototypes - csg
 void expand_cubes_by_xy(vect_cube_t &cubes, float val);
@@ -244,7 +244,7 @@ public:
 	}
 	bool setup_for_building(shader_t &s) const {
 		if (!enabled()) return 0; // no texture set
-		float const dx(lighting_bcube.dx()/MESH_X_SIZE), dy(lighting_bcube.dy()/MESH_Y_SIZE), dxy_offset(0.5f*(dx + dy));
+		float const dxy_offset(get_building_indir_cell_xy_size());
 		set_3d_texture_as_current(tid, 1); // indir texture uses TU_ID=1
 		s.add_uniform_vector3d("alt_scene_llc",   lighting_bcube.get_llc());
 		s.add_uniform_vector3d("alt_scene_scale", lighting_bcube.get_size());
@@ -1603,19 +1603,23 @@ class building_creator_t {
 		else {
 			float const extra_spacing(non_city_only ? params.sec_extra_spacing : 0.0); // absolute value of expand
 			test_bc.expand_by_xy(extra_spacing);
-			unsigned ixr[2][2];
-			get_grid_range(test_bc, ixr);
-
-			for (unsigned y = ixr[0][1]; y <= ixr[1][1]; ++y) {
-				for (unsigned x = ixr[0][0]; x <= ixr[1][0]; ++x) {
-					grid_elem_t const &ge(get_grid_elem(x, y));
-					if (!test_bc.intersects_xy(ge.bcube)) continue;
-					if (check_for_overlaps(ge.bc_ixs, test_bc, b, expand_val, max(min_building_spacing, extra_spacing), points)) {return 0;}
-				} // for x
-			} // for y
+			if (check_grid_overlaps(test_bc, b, expand_val, max(min_building_spacing, extra_spacing), points)) return 0;
 		}
 		return 1;
 	}
+	bool check_grid_overlaps(cube_t const &test_bc, building_t const &b, float expand_rel, float expand_abs, vector<point> &points) const {
+		unsigned ixr[2][2];
+		get_grid_range(test_bc, ixr);
+
+		for (unsigned y = ixr[0][1]; y <= ixr[1][1]; ++y) {
+			for (unsigned x = ixr[0][0]; x <= ixr[1][0]; ++x) {
+				grid_elem_t const &ge(get_grid_elem(x, y));
+				if (!test_bc.intersects_xy(ge.bcube)) continue;
+				if (check_for_overlaps(ge.bc_ixs, test_bc, b, expand_rel, expand_abs, points)) return 1;
+			} // for x
+		} // for y
+		return 0;
+	}
 
 	struct building_cand_t : public building_t {
 		vect_cube_t &temp_parts;
@@ -1623,6 +1627,234 @@ class building_creator_t {
 		~building_cand_t() {parts.swap(temp_parts);} // memory returned from parts to temp_parts
 	};
 
+	// selects the footprint and rotation of a building within pos_range, with its center in center_range; returns 0 if the placement is rejected
+	bool gen_building_footprint(building_params_t const &params, building_cand_t &b, building_mat_t const &mat, cube_t const &pos_range,
+		cube_t const &center_range, point &center, float &size_scale, bool is_tile, bool use_city_plots, rand_gen_t &rgen) const
+	{
+		vector3d const pos_range_sz(pos_range.get_size());
+		assert(pos_range_sz.x > 0.0 && pos_range_sz.y > 0.0);
+		point const place_center(pos_range.get_cube_center());
+		bool keep(0);
+
+		for (unsigned m = 0; m < params.num_tries; ++m) {
+			for (unsigned d = 0; d < 2; ++d) {center[d] = rgen.rand_uniform(center_range.d[d][0], center_range.d[d][1]);} // x,y
+			if (is_tile || mat.place_radius == 0.0 || dist_xy_less_than(center, place_center, mat.place_radius)) {keep = 1; break;} // place_radius ignored for tiles
+		}
+		if (!keep) return 0; // placement failed, skip
+		b.is_house = (mat.house_prob > 0.0 && rgen.rand_float() < mat.house_prob);
+		size_scale = (b.is_house ? mat.gen_size_scale(rgen) : 1.0);
+				
+		for (unsigned d = 0; d < 2; ++d) { // x,y
+			float const sz(0.5*size_scale*rgen.rand_uniform(min(mat.sz_range.d[d][0], 0.3f*pos_range_sz[d]),
+				                                            min(mat.sz_range.d[d][1], 0.5f*pos_range_sz[d]))); // use pos range size for max
+			b.bcube.d[d][0] = center[d] - sz;
+			b.bcube.d[d][1] = center[d] + sz;
+		}
+		if ((use_city_plots || is_tile) && !pos_range.contains_cube_xy(b.bcube)) return 0; // not completely contained in plot/tile (pre-rot)
+		if (!use_city_plots) {b.gen_rotation(rgen);} // city plots are Manhattan (non-rotated) - must rotate before bcube checks below
+		if (is_tile && !pos_range.contains_cube_xy(b.bcube)) return 0; // not completely contained in tile
+		if (start_in_inf_terrain && b.bcube.contains_pt_xy(get_camera_pos())) return 0; // don't place a building over the player appearance spot
+		return 1;
+	}
+	// sets the building zval, height, and colors after a successful overlap check; returns 0 if the building fails the altitude checks
+	bool gen_building_height(building_cand_t &b, building_mat_t const &mat, cube_t const &pos_range, point &center, float size_scale,
+		float def_water_level, vector3d const &xlate, bool use_city_plots, rand_gen_t &rgen) const
+	{
+		if (!use_city_plots) {center.z = get_exact_zval(center.x+xlate.x, center.y+xlate.y);} // only calculate when needed
+		float const z_sea_level(center.z - def_water_level);
+		if (z_sea_level < 0.0) return 0; // skip underwater buildings, failed placement
+		if (z_sea_level < mat.min_alt || z_sea_level > mat.max_alt) return 0; // skip bad altitude buildings, failed placement
+		float const hmin(use_city_plots ? pos_range.z1() : 0.0), hmax(use_city_plots ? pos_range.z2() : 1.0);
+		assert(hmin <= hmax);
+		float const height_range(mat.sz_range.dz());
+		assert(height_range >= 0.0);
+		float const z_size_scale(size_scale*(b.is_house ? rgen.rand_uniform(0.6, 0.8) : 1.0)); // make houses slightly shorter on average to offset extra height added by roof
+		float const height_val(z_size_scale*(mat.sz_range.z1() + height_range*rgen.rand_uniform(hmin, hmax)));
+		assert(height_val > 0.0);
+		b.set_z_range(center.z, (center.z + 0.5*height_val));
+		assert(b.bcube.is_strictly_normalized());
+		mat.side_color.gen_color(b.side_color, rgen);
+		mat.roof_color.gen_color(b.roof_color, rgen);
+		return 1;
+	}
+	void add_placed_building(building_t const &b) {
+		add_to_grid(b.bcube, buildings.size());
+		vector3d const sz(b.bcube.get_size());
+		float const mult[3] = {0.5, 0.5, 1.0}; // half in X,Y and full in Z
+		UNROLL_3X(max_extent[i_] = max(max_extent[i_], mult[i_]*sz[i_]);)
+		buildings.push_back(b);
+	}
+
+	// Parallel placement: the range is split into cells, each with its own rgen seeded from the cell index, that place buildings independently.
+	// Cells are processed in four phases by XY index parity so that cells running concurrently are never adjacent. Each building (including its spacing)
+	// must stay within half a cell of its own cell, so concurrent cells can't conflict, and buildings are checked against the grid filled by earlier phases.
+	// Results are merged in cell order after each phase, which makes the output independent of the number of threads.
+	void place_buildings_parallel(building_params_t const &params, bool city_only, bool non_city_only, vect_cube_t const &avoid_bcubes,
+		cube_t const &avoid_bcubes_bcube, float min_building_spacing, float def_water_level, vector3d const &delta_range, vector3d const &xlate,
+		int rseed, unsigned &num_tries, unsigned &num_gen, unsigned &max_consec_fail)
+	{
+		vector<unsigned> const &mat_ix_list(params.get_mat_list(city_only, non_city_only));
+		float max_bldg_sz(0.0); // upper bound on building size, used to choose the cell size
+		float const extra_spacing(non_city_only ? params.sec_extra_spacing : 0.0);
+
+		for (auto i = mat_ix_list.begin(); i != mat_ix_list.end(); ++i) {
+			building_mat_t const &mat(params.get_material(*i));
+			max_eq(max_bldg_sz, max(mat.sz_range.x2(), mat.sz_range.y2())*max(mat.house_scale_max, 1.0f));
+		}
+		max_bldg_sz = SQRT2*(1.2*max_bldg_sz + 2.0*(min_building_spacing + extra_spacing)); // add spacing and account for rotation
+		unsigned ncells[2] = {};
+		for (unsigned d = 0; d < 2; ++d) {ncells[d] = max(1U, min(grid_sz, unsigned(range_sz[d]/(2.0*max_bldg_sz))));} // cells must be at least 2x the max building size
+		unsigned const num_cells(ncells[0]*ncells[1]);
+		vector<cube_t> cells(num_cells);
+		vector<unsigned> num_to_place(num_cells, 0);
+		vector<vector<pair<unsigned, float>>> cell_mats(num_cells); // {mat_ix, cumulative weight} of materials that can be placed in each cell
+		vector<pair<unsigned, float>> mat_probs; // {mat_ix, probability}; materials are repeated in mat_ix_list by their probability
+		vector<unsigned> sorted_mats(mat_ix_list);
+		sort(sorted_mats.begin(), sorted_mats.end());
+
+		for (auto i = sorted_mats.begin(); i != sorted_mats.end(); ++i) {
+			if (mat_probs.empty() || mat_probs.back().first != *i) {mat_probs.emplace_back(*i, 0.0);}
+			mat_probs.back().second += 1.0/sorted_mats.size();
+		}
+		float cum_weight(0.0);
+
+		for (unsigned y = 0, cix = 0; y < ncells[1]; ++y) {
+			for (unsigned x = 0; x < ncells[0]; ++x, ++cix) {
+				cube_t &c(cells[cix]);
+				c = range;
+				c.x1() = range.x1() + x*range_sz.x/ncells[0]; c.x2() = range.x1() + (x+1)*range_sz.x/ncells[0];
+				c.y1() = range.y1() + y*range_sz.y/ncells[1]; c.y2() = range.y1() + (y+1)*range_sz.y/ncells[1];
+				// distribute num_place across cells by each material's probability times the fraction of its pos_range covered by the cell, using cumulative rounding;
+				// materials are then chosen within the cell by the same weights, so each material gets the same expected share of buildings as in serial placement
+				float weight(0.0);
+
+				for (auto i = mat_probs.begin(); i != mat_probs.end(); ++i) {
+					cube_t const mat_range(params.get_material(i->first).pos_range + delta_range);
+					cube_t overlap(c);
+					if (!overlap.intersects_xy(mat_range)) continue;
+					overlap.intersect_with_cube_xy(mat_range);
+					weight += i->second*overlap.get_area_xy()/mat_range.get_area_xy();
+					cell_mats[cix].emplace_back(i->first, weight);
+				}
+				float const prev_weight(cum_weight);
+				cum_weight += weight*params.num_place;
+				num_to_place[cix] = unsigned(cum_weight) - unsigned(prev_weight);
+			} // for x
+		} // for y
+		vector<vector<building_t>> cell_bldgs(num_cells);
+		vector<unsigned> cell_num_tries(num_cells, 0), cell_num_gen(num_cells, 0), cell_max_consec_fail(num_cells, 0), cell_gave_up_iter(num_cells, 0);
+		unsigned const LOCAL_GRID_SZ = 8; // per-cell grid used for overlap tests against buildings placed in the same cell
+
+		for (unsigned phase = 0; phase < 4; ++phase) {
+			vector<unsigned> phase_cells;
+
+			for (unsigned cix = 0; cix < num_cells; ++cix) {
+				unsigned const x(cix % ncells[0]), y(cix / ncells[0]);
+				if ((x&1) == (phase&1) && (y&1) == (phase>>1) && num_to_place[cix] > 0) {phase_cells.push_back(cix);}
+			}
+#pragma omp parallel for schedule(dynamic,1)
+			for (int ci = 0; ci < (int)phase_cells.size(); ++ci) {
+				unsigned const cix(phase_cells[ci]);
+				cube_t const &cell(cells[cix]);
+				cube_t valid_area(cell);
+				valid_area.expand_by_xy(0.5*cell.get_size()); // test cubes must be contained in this area
+				vector<building_t> &placed(cell_bldgs[cix]);
+				vector<unsigned> local_grid[LOCAL_GRID_SZ][LOCAL_GRID_SZ]; // indexes into placed
+				vector3d const va_sz(valid_area.get_size());
+				vector<pair<unsigned, float>> const &mats(cell_mats[cix]);
+				assert(!mats.empty());
+				auto const get_local_range([&](cube_t const &c, unsigned lr[2][2]) { // {lo,hi}x{x,y}
+					for (unsigned d = 0; d < 2; ++d) {
+						for (unsigned e = 0; e < 2; ++e) {lr[e][d] = unsigned(max(0.0f, min(LOCAL_GRID_SZ-1.0f, LOCAL_GRID_SZ*(c.d[d][e] - valid_area.d[d][0])/va_sz[d])));}
+					}
+				});
+				vector<point> thread_points;
+				vect_cube_t temp_parts;
+				rand_gen_t cell_rgen;
+				cell_rgen.set_state(rand_gen_index + 12345*(cix + 1), rseed + 67891*cix);
+				cell_rgen.rand_mix();
+				unsigned num_consec_fail(0);
+				unsigned const max_fails(max(50U, 5000U/num_cells));
+				point center(all_zeros);
+
+				for (unsigned i = 0; i < num_to_place[cix]; ++i) {
+					bool success(0);
+
+					for (unsigned n = 0; n < params.num_tries; ++n) {
+						building_cand_t b(temp_parts);
+						float const mat_val(cell_rgen.rand_float()*mats.back().second);
+						b.mat_ix = mats.back().first;
+
+						for (auto m = mats.begin(); m != mats.end(); ++m) {
+							if (mat_val < m->second) {b.mat_ix = m->first; break;} // choose material by weight
+						}
+						building_mat_t const &mat(b.get_material());
+						cube_t const pos_range(mat.pos_range + delta_range);
+						++cell_num_tries[cix];
+						cube_t center_range(pos_range);
+						center_range.intersect_with_cube_xy(cell); // only the center is restricted to the cell
+						float size_scale(1.0);
+						if (!gen_building_footprint(params, b, mat, pos_range, center_range, center, size_scale, 0, 0, cell_rgen)) continue;
+						float const expand_val(b.is_rotated() ? 0.05 : 0.1); // same as check_valid_building_placement()
+						vector3d expand(expand_val*b.bcube.get_size());
+						for (unsigned d = 0; d < 2; ++d) {max_eq(expand[d], min_building_spacing);}
+						cube_t test_bc(b.bcube);
+						test_bc.expand_by_xy(expand);
+						if (!avoid_bcubes.empty() && avoid_bcubes_bcube.intersects_xy(test_bc) && has_bcube_int_xy(test_bc, avoid_bcubes, params.sec_extra_spacing)) continue;
+						test_bc.expand_by_xy(extra_spacing);
+						if (!valid_area.contains_cube_xy(test_bc)) continue; // may conflict with a concurrent cell
+						float const expand_abs(max(min_building_spacing, extra_spacing));
+						if (check_grid_overlaps(test_bc, b, expand_val, expand_abs, thread_points)) continue; // overlaps a building from an earlier phase
+						unsigned lr[2][2];
+						get_local_range(test_bc, lr);
+						bool overlaps(0);
+
+						for (unsigned y = lr[0][1]; y <= lr[1][1] && !overlaps; ++y) {
+							for (unsigned x = lr[0][0]; x <= lr[1][0] && !overlaps; ++x) {
+								for (auto ob = local_grid[y][x].begin(); ob != local_grid[y][x].end() && !overlaps; ++ob) {
+									building_t const &obldg(placed[*ob]);
+									overlaps = (test_bc.intersects_xy(obldg.bcube) && obldg.check_bcube_overlap_xy(b, expand_val, expand_abs, thread_points));
+								}
+							}
+						}
+						if (overlaps) continue;
+						++cell_num_gen[cix];
+						if (!gen_building_height(b, mat, pos_range, center, size_scale, def_water_level, xlate, 0, cell_rgen)) break;
+						get_local_range(b.bcube, lr);
+
+						for (unsigned y = lr[0][1]; y <= lr[1][1]; ++y) {
+							for (unsigned x = lr[0][0]; x <= lr[1][0]; ++x) {local_grid[y][x].push_back(placed.size());}
+						}
+						placed.push_back(b);
+						success = 1;
+						break; // done
+					} // for n
+					if (success) {num_consec_fail = 0; continue;}
+					++num_consec_fail;
+					max_eq(cell_max_consec_fail[cix], num_consec_fail);
+					if (num_consec_fail >= max_fails) {cell_gave_up_iter[cix] = i+1; break;} // too many failures - give up on this cell
+				} // for i
+			} // for ci
+			for (auto ci = phase_cells.begin(); ci != phase_cells.end(); ++ci) { // serial merge in deterministic cell order
+				for (auto b = cell_bldgs[*ci].begin(); b != cell_bldgs[*ci].end(); ++b) {add_placed_building(*b);}
+				cell_bldgs[*ci].clear();
+			}
+		} // for phase
+		unsigned num_gave_up(0), gave_up_iters(0);
+
+		for (unsigned cix = 0; cix < num_cells; ++cix) {
+			num_tries += cell_num_tries[cix];
+			num_gen   += cell_num_gen  [cix];
+			max_eq(max_consec_fail, cell_max_consec_fail[cix]);
+			if (cell_gave_up_iter[cix] > 0) {++num_gave_up; gave_up_iters += cell_gave_up_iter[cix] - 1;}
+		}
+		if (num_gave_up > 0) {
+			cout << "Failed to place a building after " << max_consec_fail << " tries, giving up in " << num_gave_up << " of " << num_cells
+				 << " cells after " << gave_up_iters << " total iterations" << endl;
+		}
+		cout << "Parallel building placement with " << ncells[0] << "x" << ncells[1] << " cells" << endl;
+	}
+
 public:
 	building_creator_t(bool is_city=0) : grid_sz(1), gpu_mem_usage(0), max_extent(zero_vector), building_draw(is_city), building_draw_vbo(is_city), use_smap_this_frame(0) {}
 	bool empty() const {return buildings.empty();}
@@ -1704,86 +1936,53 @@ public:
 		unsigned num_consec_fail(0), max_consec_fail(0);
 		vect_cube_t temp_parts;
 
-		for (unsigned i = 0; i < params.num_place; ++i) {
-			bool success(0);
-
-			for (unsigned n = 0; n < params.num_tries; ++n) { // 10 tries to find a non-overlapping building placement
-				building_cand_t b(temp_parts);
-				b.mat_ix = params.choose_rand_mat(rgen, city_only, non_city_only); // set material
-				building_mat_t const &mat(b.get_material());
-				cube_t pos_range;
-				unsigned plot_ix(0);
+		if (params.parallel_place && !is_tile && !use_city_plots) {
+			place_buildings_parallel(params, city_only, non_city_only, avoid_bcubes, avoid_bcubes_bcube, min_building_spacing, def_water_level,
+				delta_range, xlate, rseed, num_tries, num_gen, max_consec_fail);
+		}
+		else {
+			for (unsigned i = 0; i < params.num_place; ++i) {
+				bool success(0);
+
+				for (unsigned n = 0; n < params.num_tries; ++n) { // 10 tries to find a non-overlapping building placement
+					building_cand_t b(temp_parts);
+					b.mat_ix = params.choose_rand_mat(rgen, city_only, non_city_only); // set material
+					building_mat_t const &mat(b.get_material());
+					cube_t pos_range;
+					unsigned plot_ix(0);
 				
-				if (use_city_plots) { // select a random plot, if available
-					plot_ix   = rgen.rand()%city_plot_bcubes.size();
-					pos_range = city_plot_bcubes[plot_ix];
-					center.z  = city_plot_bcubes[plot_ix].zval; // optimization: take zval from plot rather than calling get_exact_zval()
-					pos_range.expand_by_xy(-min_building_spacing); // force min spacing between building and edge of plot
-				}
+					if (use_city_plots) { // select a random plot, if available
+						plot_ix   = rgen.rand()%city_plot_bcubes.size();
+						pos_range = city_plot_bcubes[plot_ix];
+						center.z  = city_plot_bcubes[plot_ix].zval; // optimization: take zval from plot rather than calling get_exact_zval()
+						pos_range.expand_by_xy(-min_building_spacing); // force min spacing between building and edge of plot
+					}
+					else {
+						pos_range = mat.pos_range + delta_range;
+					}
+					++num_tries;
+					float size_scale(1.0);
+					if (!gen_building_footprint(params, b, mat, pos_range, pos_range, center, size_scale, is_tile, use_city_plots, rgen)) continue;
+					if (!check_valid_building_placement(params, b, avoid_bcubes, avoid_bcubes_bcube,
+						min_building_spacing, plot_ix, non_city_only, use_city_plots, check_plot_coll)) continue; // check overlap
+					++num_gen;
+					if (!gen_building_height(b, mat, pos_range, center, size_scale, def_water_level, xlate, use_city_plots, rgen)) break;
+					add_placed_building(b);
+					success = 1;
+					break; // done
+				} // for n
+				if (success) {num_consec_fail = 0;}
 				else {
-					pos_range = mat.pos_range + delta_range;
-				}
-				vector3d const pos_range_sz(pos_range.get_size());
-				assert(pos_range_sz.x > 0.0 && pos_range_sz.y > 0.0);
-				point const place_center(pos_range.get_cube_center());
-				bool keep(0);
-				++num_tries;
-
-				for (unsigned m = 0; m < params.num_tries; ++m) {
-					for (unsigned d = 0; d < 2; ++d) {center[d] = rgen.rand_uniform(pos_range.d[d][0], pos_range.d[d][1]);} // x,y
-					if (is_tile || mat.place_radius == 0.0 || dist_xy_less_than(center, place_center, mat.place_radius)) {keep = 1; break;} // place_radius ignored for tiles
-				}
-				if (!keep) continue; // placement failed, skip
-				b.is_house = (mat.house_prob > 0.0 && rgen.rand_float() < mat.house_prob);
-				float const size_scale(b.is_house ? mat.gen_size_scale(rgen) : 1.0);
-				
-				for (unsigned d = 0; d < 2; ++d) { // x,y
-					float const sz(0.5*size_scale*rgen.rand_uniform(min(mat.sz_range.d[d][0], 0.3f*pos_range_sz[d]),
-						                                            min(mat.sz_range.d[d][1], 0.5f*pos_range_sz[d]))); // use pos range size for max
-					b.bcube.d[d][0] = center[d] - sz;
-					b.bcube.d[d][1] = center[d] + sz;
-				}
-				if ((use_city_plots || is_tile) && !pos_range.contains_cube_xy(b.bcube)) continue; // not completely contained in plot/tile (pre-rot)
-				if (!use_city_plots) {b.gen_rotation(rgen);} // city plots are Manhattan (non-rotated) - must rotate before bcube checks below
-				if (is_tile && !pos_range.contains_cube_xy(b.bcube)) continue; // not completely contained in tile
-				if (start_in_inf_terrain && b.bcube.contains_pt_xy(get_camera_pos())) continue; // don't place a building over the player appearance spot
-				if (!check_valid_building_placement(params, b, avoid_bcubes, avoid_bcubes_bcube,
-					min_building_spacing, plot_ix, non_city_only, use_city_plots, check_plot_coll)) continue; // check overlap
-				++num_gen;
-				if (!use_city_plots) {center.z = get_exact_zval(center.x+xlate.x, center.y+xlate.y);} // only calculate when needed
-				float const z_sea_level(center.z - def_water_level);
-				if (z_sea_level < 0.0) break; // skip underwater buildings, failed placement
-				if (z_sea_level < mat.min_alt || z_sea_level > mat.max_alt) break; // skip bad altitude buildings, failed placement
-				float const hmin(use_city_plots ? pos_range.z1() : 0.0), hmax(use_city_plots ? pos_range.z2() : 1.0);
-				assert(hmin <= hmax);
-				float const height_range(mat.sz_range.dz());
-				assert(height_range >= 0.0);
-				float const z_size_scale(size_scale*(b.is_house ? rgen.rand_uniform(0.6, 0.8) : 1.0)); // make houses slightly shorter on average to offset extra height added by roof
-				float const height_val(z_size_scale*(mat.sz_range.z1() + height_range*rgen.rand_uniform(hmin, hmax)));
-				assert(height_val > 0.0);
-				b.set_z_range(center.z, (center.z + 0.5*height_val));
-				assert(b.bcube.is_strictly_normalized());
-				mat.side_color.gen_color(b.side_color, rgen);
-				mat.roof_color.gen_color(b.roof_color, rgen);
-				add_to_grid(b.bcube, buildings.size());
-				vector3d const sz(b.bcube.get_size());
-				float const mult[3] = {0.5, 0.5, 1.0}; // half in X,Y and full in Z
-				UNROLL_3X(max_extent[i_] = max(max_extent[i_], mult[i_]*sz[i_]);)
-				buildings.push_back(b);
-				success = 1;
-				break; // done
-			} // for n
-			if (success) {num_consec_fail = 0;}
-			else {
-				++num_consec_fail;
-				max_eq(max_consec_fail, num_consec_fail);
+					++num_consec_fail;
+					max_eq(max_consec_fail, num_consec_fail);
 
-				if (num_consec_fail >= (is_tile ? 50U : 5000U)) { // too many failures - give up
-					if (!is_tile) {cout << "Failed to place a building after " << num_consec_fail << " tries, giving up after " << i << " iterations" << endl;}
-					break;
+					if (num_consec_fail >= (is_tile ? 50U : 5000U)) { // too many failures - give up
+						if (!is_tile) {cout << "Failed to place a building after " << num_consec_fail << " tries, giving up after " << i << " iterations" << endl;}
+						break;
+					}
 				}
-			}
-		} // for i
+			} // for i
+		}
 		if (buildings.capacity() > 2*buildings.size()) {buildings.shrink_to_fit();}
 		bix_by_x1 cmp_x1(buildings);
 		for (auto i = bix_by_plot.begin(); i != bix_by_plot.end(); ++i) {sort(i->begin(), i->end(), cmp_x1);}
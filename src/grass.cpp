@@ -17,7 +17,7 @@ float grass_length(0.02), grass_width(0.002), flower_density(0.0);
 
 extern int default_ground_tex, read_landscape, display_mode, animate2, frame_counter, draw_model;
 extern unsigned create_voxel_landscape;
-extern float vegetation, zmin, zmax, fticks, h_dirt[], leaf_color_coherence, tree_deadness, relh_adj_tex, zmax_est, snow_cov_amt, tt_grass_scale_factor;
+extern float vegetation, zmin, zmax, fticks, tstep, h_dirt[], leaf_color_coherence, tree_deadness, relh_adj_tex, zmax_est, snow_cov_amt, tt_grass_scale_factor;
 extern double tfticks;
 extern colorRGBA leaf_base_color, flower_color;
 extern vector3d wind;
@@ -414,7 +414,7 @@ public:
 						if (density < 1.0 && rgen_.randd() >= density) continue; // skip - density too low
 					}
 					// skip grass intersecting cobjs
-					if (do_cobj_check && dwobject(GRASS, pos).check_vert_collision(0, 0, 0)) continue; // make a GRASS object for collision detection
+					if (do_cobj_check && dwobject(GRASS, pos).check_vert_collision(0, 0, 0, tstep)) continue; // make a GRASS object for collision detection
 
 					if (create_voxel_landscape) {
 						if (point_inside_voxel_terrain(pos)) continue; // inside voxel volume
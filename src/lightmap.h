@@ -225,6 +225,12 @@ public:
 	void assign_smap_mgr_id(unsigned id) {smap_mgr_id  = id;}
 	bool operator<(light_source const &l) const {return (radius < l.radius);} // compare radius
 	bool operator>(light_source const &l) const {return (radius > l.radius);} // compare radius
+
+	template<typename L, typename F> static void xfer_fields(L &l, F &f) { // visits each serialized field; L may be const for writing
+		f(l.dynamic); f(l.enabled); f(l.user_placed); f(l.is_cube_face); f(l.is_cube_light); f(l.no_shadows); f(l.smap_index); f(l.user_smap_id);
+		f(l.smap_mgr_id); f(l.cube_eflags); f(l.num_dlight_rays); f(l.radius); f(l.radius_inv); f(l.r_inner); f(l.bwidth); f(l.near_clip);
+		f(l.pos); f(l.pos2); f(l.dir); f(l.color); f(l.custom_bcube);
+	}
 };
 
 
@@ -283,6 +289,13 @@ public:
 	unsigned get_indir_dlight_ix() const {return indir_dlight_ix;}
 	bool need_update_indir(); // Note: modifies last_pos/last_dir, not const
 	void write_to_cobj_file(std::ostream &out, bool is_diffuse) const;
+
+	template<typename L, typename F> static void xfer_fields(L &l, F &f) { // triggers and sensor are not included
+		light_source::xfer_fields(l, f);
+		f(l.bound); f(l.valid); f(l.disabled); f(l.dynamic_cobj); f(l.bind_cobj); f(l.bind_pos);
+		f(l.use_smap); f(l.outdoor_shadows); f(l.dynamic_indir); f(l.platform_id); f(l.indir_dlight_ix); f(l.sm_size);
+		f(l.active_time); f(l.inactive_time); f(l.last_pos); f(l.last_dir); f(l.rot_rate); f(l.rot_axis);
+	}
 };
 
 
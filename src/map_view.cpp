@@ -9,10 +9,21 @@
 #include "shaders.h"
 #include "heightmap.h"
 #include <cfloat> // for FLT_MAX
+#include <map>
+#include <fstream>
+#include <cerrno>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
 
 
 bool const MAP_VIEW_LIGHTING = 1;
 bool const MAP_VIEW_SHADOWS  = 1;
+unsigned const MAP_TILE_SIZE     = 256; // in pixels
+unsigned const MAP_TILE_ZOOM_ONE = 4;   // zoom level where one pixel is one mesh texel
+unsigned const MAP_TILE_VERSION  = 1;   // increment when tile shading changes to invalidate cached tiles
+unsigned const MAX_MAP_TILES     = 1000000;
 
 int map_drag_x(0), map_drag_y(0);
 float map_zoom(0.0);
@@ -22,6 +33,7 @@ extern bool water_is_lava, begin_motion, show_map_view_mandelbrot;
 extern int window_width, window_height, xoff2, yoff2, map_mode, map_color, read_landscape, read_heightmap, do_read_mesh;
 extern int world_mode, game_mode, display_mode, num_smileys, DISABLE_WATER, cache_counter, default_ground_tex;
 extern float zmax_est, zmin, zmax, water_plane_z, water_h_off, glaciate_exp, glaciate_exp_inv, vegetation, relh_adj_tex, temperature, mesh_height_scale, mesh_scale;
+extern bool mesh_gen_cpu_only;
 extern int coll_id[];
 extern obj_group obj_groups[];
 extern coll_obj_group coll_objects;
@@ -31,6 +43,7 @@ bool setup_height_gen(mesh_xy_grid_cache_t &height_gen, float x0, float y0, floa
 bool using_hmap_with_detail();
 void set_temp_clear_color(colorRGBA const &clear_color);
 float get_heightmap_scale();
+void reset_planet_defaults();
 
 
 struct complex_num {
@@ -87,6 +100,88 @@ void colorize(float val, unsigned char *rgb) {
 }
 
 
+// per-pixel terrain coloring and lighting shared by the overhead map and the map tile writer
+struct map_terrain_shader_t {
+	float zmax2, hscale, map_heights[6];
+	colorRGBA ground_color, map_colors[6];
+	vector3d light_dir;
+	bool lighting;
+
+	map_terrain_shader_t(bool uses_hmap) {
+		bool const no_water((DISABLE_WATER == 2) || !(display_mode & 0x04));
+		bool const is_ice(((world_mode == WMODE_GROUND) ? temperature : get_cur_temperature()) <= W_FREEZE_POINT);
+		zmax2  = zmax_est*((map_color || no_water) ? 1.0 : 0.855);
+		hscale = 0.5/zmax2;
+		float const relh_water(get_rel_height_no_clamp(water_plane_z, -zmax_est, zmax_est));
+		map_heights[0] = 0.9f*lttex_dirt[3].zval  + 0.1f*lttex_dirt[4].zval;
+		map_heights[1] = 0.5f*(lttex_dirt[2].zval + lttex_dirt[3].zval);
+		map_heights[2] = 0.5f*(lttex_dirt[1].zval + lttex_dirt[2].zval);
+		map_heights[3] = 0.5f*(lttex_dirt[0].zval + lttex_dirt[1].zval);
+		map_heights[4] = relh_water; // Note: can be negative
+		map_heights[5] = min(0.5f*relh_water, relh_water-0.01f); // handle negative case
+		
+		for (unsigned i = 0; i < 6; ++i) {
+			if (map_heights[i] > 0.0) {map_heights[i] = pow(map_heights[i], glaciate_exp);} // handle negative case
+		}
+		ground_color  = ((default_ground_tex >= 0) ? texture_color(default_ground_tex) : BLACK);
+		map_colors[0] = ((water_is_lava || DISABLE_WATER == 2) ? DK_GRAY : WHITE);
+		map_colors[1] = GRAY;
+		map_colors[2] = ((vegetation == 0.0) ? colorRGBA(0.55,0.45,0.35,1.0) : GREEN);
+		map_colors[3] = LT_BROWN;
+		map_colors[4] = (no_water ? BROWN    : (water_is_lava ? RED        : colorRGBA(0.3,0.2,0.6)));
+		map_colors[5] = (no_water ? DK_BROWN : (water_is_lava ? LAVA_COLOR : (is_ice ? LT_BLUE : BLUE)));
+		light_dir     = get_light_pos().get_norm(); // assume directional lighting to origin
+		lighting      = (MAP_VIEW_LIGHTING && !uses_hmap && !(display_mode & 0x20));
+	}
+	// get_prev_row_mh() returns the mesh height of the pixel in the previous row (one texel toward -y); only called when needed, since it can be slow
+	template<typename F> void shade(float mh, float &last_height, bool first_col, bool shadowed, F const &get_prev_row_mh, unsigned char *rgb) const {
+		float height(min(1.0f, hscale*(mh + zmax2))); // can be negative
+
+		if (!map_color) { // grayscale
+			float const val(pow(height, glaciate_exp_inv)); // un-glaciate: slow
+			//rgb[0] = rgb[1] = rgb[2] = (unsigned char)(255.0*val);
+			// http://c0de517e.blogspot.com/2017/11/coder-color-palettes-for-data.html
+			rgb[0] = (unsigned char)(255.0*(-0.121 + 0.893 * val + 0.276 * sin (1.94 - 5.69 * val)));
+			rgb[1] = (unsigned char)(255.0*(0.07 + 0.947 * val));
+			rgb[2] = (unsigned char)(255.0*(0.107 + (1.5 - 1.22 * val) * val));
+			return;
+		}
+		height += relh_adj_tex;
+		colorRGBA color;
+		if      (height <= map_heights[5]) {color = map_colors[5];} // deep water
+		else if (height <= map_heights[3]) {color = map_colors[3];} // sand
+		else if (height >= map_heights[0]) {color = map_colors[0];} // snow
+		else {
+			color = BLACK;
+			for (unsigned k = 0; k < 4; ++k) { // mixed
+				if (height > map_heights[k+1]) {
+					float const h((height - map_heights[k+1])/(map_heights[k] - map_heights[k+1])), v(cubic_interpolate(h));
+					blend_color(color, map_colors[k], map_colors[k+1], v);
+					break;
+				}
+			}
+		}
+		if (height <= map_heights[4] && height > map_heights[5]) { // shallow water
+			float const h(0.5f*(height - map_heights[5])/(map_heights[4] - map_heights[5])), v(cubic_interpolate(h));
+			blend_color(color, color, map_colors[5], v);
+		}
+		if (lighting) {
+			vector3d normal(plus_z);
+
+			if (height > map_heights[4]) {
+				float const hx(first_col ? height : last_height);
+				float const hy(CLIP_TO_01(hscale*(get_prev_row_mh() + zmax2)));
+				normal = vector3d(DY_VAL*(hx - height), DX_VAL*(hy - height), dxdy).get_norm();
+			}
+			last_height = height;
+			color *= (0.2 + (shadowed ? 0.0 : 0.8)*max(0.0f, dot_product(light_dir, normal)));
+			shadowed = 0; // handled correctly above
+		}
+		unpack_color(rgb, color*(shadowed ? 0.5 : 1.0));
+	}
+};
+
+
 void draw_overhead_map() {
 
 	unsigned tid(0);
@@ -101,9 +196,6 @@ void draw_overhead_map() {
 
 	//timer_t timer("Map Draw");
 	int const nx2(nx/2), ny2(ny/2);
-	bool const no_water((DISABLE_WATER == 2) || !(display_mode & 0x04));
-	bool const is_ice(((world_mode == WMODE_GROUND) ? temperature : get_cur_temperature()) <= W_FREEZE_POINT);
-	float const zmax2(zmax_est*((map_color || no_water) ? 1.0 : 0.855)), hscale(0.5/zmax2);
 	float const window_ar((float(window_width)*ny)/(float(window_height)*nx)), scene_ar(X_SCENE_SIZE/Y_SCENE_SIZE);
 	float const xscale(2.0*map_zoom*window_ar*HALF_DXY), yscale(2.0*map_zoom*scene_ar*HALF_DXY);
 	float const xscale_val(xscale/64), yscale_val(yscale/64);
@@ -134,29 +226,7 @@ void draw_overhead_map() {
 	}
 	else {
 		float x0((float)map_x + xoff2*DX_VAL), y0((float)map_y + yoff2*DY_VAL);
-		float const relh_water(get_rel_height_no_clamp(water_plane_z, -zmax_est, zmax_est));
 		point const camera(get_camera_pos());
-		float map_heights[6];
-		map_heights[0] = 0.9f*lttex_dirt[3].zval  + 0.1f*lttex_dirt[4].zval;
-		map_heights[1] = 0.5f*(lttex_dirt[2].zval + lttex_dirt[3].zval);
-		map_heights[2] = 0.5f*(lttex_dirt[1].zval + lttex_dirt[2].zval);
-		map_heights[3] = 0.5f*(lttex_dirt[0].zval + lttex_dirt[1].zval);
-		map_heights[4] = relh_water; // Note: can be negative
-		map_heights[5] = min(0.5f*relh_water, relh_water-0.01f); // handle negative case
-		
-		for (unsigned i = 0; i < 6; ++i) {
-			if (map_heights[i] > 0.0) {map_heights[i] = pow(map_heights[i], glaciate_exp);} // handle negative case
-		}
-		colorRGBA ground_color(BLACK);
-		if (default_ground_tex >= 0) {ground_color = texture_color(default_ground_tex);}
-
-		colorRGBA const map_colors[6] = {
-			((water_is_lava || DISABLE_WATER == 2) ? DK_GRAY : WHITE),
-			GRAY,
-			((vegetation == 0.0) ? colorRGBA(0.55,0.45,0.35,1.0) : GREEN),
-			LT_BROWN,
-			(no_water ? BROWN    : (water_is_lava ? RED        : colorRGBA(0.3,0.2,0.6))),
-			(no_water ? DK_BROWN : (water_is_lava ? LAVA_COLOR : (is_ice ? LT_BLUE : BLUE)))};
 
 		if (world_mode == WMODE_GROUND) {
 			float const xv(-(camera.x + map_x)/X_SCENE_SIZE), yv(-(camera.y + map_y)/Y_SCENE_SIZE);
@@ -179,7 +249,7 @@ void draw_overhead_map() {
 		mesh_xy_grid_cache_t height_gen;
 		if (!uses_hmap && !show_map_view_mandelbrot) {setup_height_gen(height_gen, xstart, ystart, xscale, yscale, nx, ny, 1);} // cache_values=1
 		point const lpos(get_light_pos());
-		vector3d const light_dir(lpos.get_norm()); // assume directional lighting to origin
+		map_terrain_shader_t const shader(uses_hmap);
 		float const texels_per_pixel(mesh_scale*0.5f*(xscale*DX_VAL_INV + yscale*DY_VAL_INV));
 		bool const nearest_texel(texels_per_pixel >= 1.0);
 
@@ -260,54 +330,12 @@ void draw_overhead_map() {
 						}
 					}
 					if (default_ground_tex >= 0 && map_color) {
-						unpack_color(rgb, ground_color*(shadowed ? 0.5 : 1.0));
+						unpack_color(rgb, shader.ground_color*(shadowed ? 0.5 : 1.0));
 						continue;
 					}
 					if (!mh_set) {mh = get_mesh_height(height_gen, xstart, ystart, xscale, yscale, i, j, nearest_texel);} // calculate mesh height here if not yet set
-					float height(min(1.0f, hscale*(mh + zmax2))); // can be negative
-
-					if (!map_color) { // grayscale
-						float const val(pow(height, glaciate_exp_inv)); // un-glaciate: slow
-						//rgb[0] = rgb[1] = rgb[2] = (unsigned char)(255.0*val);
-						// http://c0de517e.blogspot.com/2017/11/coder-color-palettes-for-data.html
-						rgb[0] = (unsigned char)(255.0*(-0.121 + 0.893 * val + 0.276 * sin (1.94 - 5.69 * val)));
-						rgb[1] = (unsigned char)(255.0*(0.07 + 0.947 * val));
-						rgb[2] = (unsigned char)(255.0*(0.107 + (1.5 - 1.22 * val) * val));
-					}
-					else {
-						height += relh_adj_tex;
-						colorRGBA color;
-						if      (height <= map_heights[5]) {color = map_colors[5];} // deep water
-						else if (height <= map_heights[3]) {color = map_colors[3];} // sand
-						else if (height >= map_heights[0]) {color = map_colors[0];} // snow
-						else {
-							color = BLACK;
-							for (unsigned k = 0; k < 4; ++k) { // mixed
-								if (height > map_heights[k+1]) {
-									float const h((height - map_heights[k+1])/(map_heights[k] - map_heights[k+1])), v(cubic_interpolate(h));
-									blend_color(color, map_colors[k], map_colors[k+1], v);
-									break;
-								}
-							}
-						}
-						if (height <= map_heights[4] && height > map_heights[5]) { // shallow water
-							float const h(0.5f*(height - map_heights[5])/(map_heights[4] - map_heights[5])), v(cubic_interpolate(h));
-							blend_color(color, color, map_colors[5], v);
-						}
-						if (MAP_VIEW_LIGHTING && !uses_hmap && !(display_mode & 0x20)) {
-							vector3d normal(plus_z);
-
-							if (height > map_heights[4]) {
-								float const hx((j == 0) ? height : last_height);
-								float const hy(CLIP_TO_01(hscale*(get_mesh_height(height_gen, xstart, ystart, xscale, yscale, max(i-1, 0), j, nearest_texel) + zmax2)));
-								normal = vector3d(DY_VAL*(hx - height), DX_VAL*(hy - height), dxdy).get_norm();
-							}
-							last_height = height;
-							color *= (0.2 + (shadowed ? 0.0 : 0.8)*max(0.0f, dot_product(light_dir, normal)));
-							shadowed = 0; // handled correctly above
-						}
-						unpack_color(rgb, color*(shadowed ? 0.5 : 1.0));
-					}
+					auto const get_prev_row_mh([&]() {return get_mesh_height(height_gen, xstart, ystart, xscale, yscale, max(i-1, 0), j, nearest_texel);});
+					shader.shade(mh, last_height, (j == 0), shadowed, get_prev_row_mh, rgb);
 				}
 			} // for j
 		} // for i
@@ -381,3 +409,151 @@ void write_map_mode_heightmap_image() {
 	timer_t timer("Heightmap Image Write");
 	texture.write_to_png(fn);
 }
+
+
+// headless map tile pyramid: tiles are anchored to world space (not to the region) so that panning reuses the cached tiles;
+// tile (z, x, y) covers world x in [x*sz, (x+1)*sz] and y in [-(y+1)*sz, -y*sz], so +y (north) is up and y increases down as in z/x/y tile servers
+struct map_tile_id_t {
+	unsigned z;
+	int x, y;
+	map_tile_id_t(unsigned z_=0, int x_=0, int y_=0) : z(z_), x(x_), y(y_) {}
+	bool operator<(map_tile_id_t const &t) const {return ((z != t.z) ? (z < t.z) : ((x != t.x) ? (x < t.x) : (y < t.y)));}
+};
+
+float get_map_tile_world_size(unsigned zoom) {return MAP_TILE_SIZE*DX_VAL*pow(2.0f, (float(MAP_TILE_ZOOM_ONE) - float(zoom)));}
+
+string get_map_tile_fn(string const &dir, map_tile_id_t const &t) {
+	return (dir + "/" + std::to_string(t.z) + "/" + std::to_string(t.x) + "/" + std::to_string(t.y) + ".png");
+}
+
+bool make_dir(string const &dir) {
+#ifdef _WIN32
+	int const ret(_mkdir(dir.c_str()));
+#else
+	int const ret(mkdir(dir.c_str(), 0755));
+#endif
+	return (ret == 0 || errno == EEXIST);
+}
+
+uint64_t get_map_tile_params_hash(map_terrain_shader_t const &shader) { // everything that affects the tile colors except for the tile position
+
+	fnv1a_hasher_t hasher;
+	hasher(MAP_TILE_VERSION);
+	hasher(MAP_TILE_SIZE);
+	hasher(get_mesh_gen_params_hash()); // depends on the seed and mesh config
+	hasher(MESH_X_SIZE); // mesh and scene size determine the world space texel size used for heights and normals
+	hasher(MESH_Y_SIZE);
+	hasher(X_SCENE_SIZE);
+	hasher(Y_SCENE_SIZE);
+	hasher(Z_SCENE_SIZE);
+	hasher(DX_VAL);
+	hasher(DY_VAL);
+	hasher(relh_adj_tex);
+	hasher(map_color);
+	hasher(shader.map_heights);
+	hasher(shader.map_colors);
+	hasher(shader.light_dir);
+	hasher(shader.lighting);
+	return hasher.get();
+}
+
+bool write_map_tile(map_terrain_shader_t const &shader, map_tile_id_t const &tile, string const &fn) {
+
+	unsigned const sz(MAP_TILE_SIZE);
+	float const tile_sz(get_map_tile_world_size(tile.z)), pix(tile_sz/sz);
+	// one extra column to the left and row below so that lighting normals are continuous across tile boundaries
+	float const xstart(tile.x*tile_sz - 0.5*pix), ystart(-tile.y*tile_sz - 0.5*pix);
+	mesh_xy_grid_cache_t height_gen;
+	setup_height_gen(height_gen, xstart, ystart, pix, -pix, sz+1, sz+1, 1); // cache_values=1
+	texture_t texture(0, 6, sz, sz, 0, 3, 0, fn);
+	texture.alloc();
+
+	for (unsigned i = 0; i < sz; ++i) {
+		float last_height(0.0);
+		unsigned char unused[3];
+		auto const get_mh([&](unsigned r, unsigned c) {return get_mesh_height(height_gen, xstart, ystart, pix, -pix, r, c);});
+		shader.shade(get_mh(i, 0), last_height, 1, 0, [&]() {return get_mh(i+1, 0);}, unused); // sets last_height for the first column
+
+		for (unsigned j = 0; j < sz; ++j) {
+			shader.shade(get_mh(i, j+1), last_height, 0, 0, [&]() {return get_mh(i+1, j+1);}, (texture.get_data() + 3*(i*sz + j)));
+		}
+	}
+	bool const ret(texture.write_to_png(fn) != 0);
+	texture.free_client_mem();
+	return ret;
+}
+
+// generates PNG tiles <dir>/<z>/<x>/<y>.png for zoom levels [0, max_zoom] covering world region {x1,y1}-{x2,y2};
+// tiles listed in <dir>/tiles.txt with a matching parameters hash are reused rather than regenerated
+bool write_map_tiles(string const &dir, unsigned max_zoom, float x1, float y1, float x2, float y2) {
+
+	if (!(x1 < x2 && y1 < y2)) {std::cerr << "Error: invalid map tile region" << endl; return 0;}
+	timer_t timer("Map Tiles");
+	map_terrain_shader_t const shader(0); // uses_hmap=0
+	uint64_t const params_hash(get_map_tile_params_hash(shader));
+	string const manifest_fn(dir + "/tiles.txt");
+	map<map_tile_id_t, uint64_t> manifest;
+	vector<map_tile_id_t> to_gen;
+	unsigned num_cached(0);
+	if (!make_dir(dir)) {std::cerr << "Error: failed to create map tile directory " << dir << endl; return 0;}
+	{ // open a scope
+		std::ifstream in(manifest_fn);
+		map_tile_id_t t;
+		uint64_t hash(0);
+		while (in >> t.z >> t.x >> t.y >> hash) {manifest[t] = hash;}
+	}
+	for (unsigned z = 0; z <= max_zoom; ++z) {
+		float const tile_sz(get_map_tile_world_size(z));
+		int const tx1(floor(x1/tile_sz)), tx2(floor(x2/tile_sz)), ty1(floor(-y2/tile_sz)), ty2(floor(-y1/tile_sz));
+
+		if (to_gen.size() + uint64_t(tx2 - tx1 + 1)*uint64_t(ty2 - ty1 + 1) > MAX_MAP_TILES) {
+			std::cerr << "Error: too many map tiles at zoom level " << z << "; reduce the region size or max zoom" << endl;
+			return 0;
+		}
+		if (!make_dir(dir + "/" + std::to_string(z))) return 0;
+
+		for (int x = tx1; x <= tx2; ++x) {
+			if (!make_dir(dir + "/" + std::to_string(z) + "/" + std::to_string(x))) return 0;
+
+			for (int y = ty1; y <= ty2; ++y) {
+				map_tile_id_t const tile(z, x, y);
+				fnv1a_hasher_t hasher;
+				hasher(params_hash);
+				hasher(tile);
+				uint64_t const hash(hasher.get());
+				auto it(manifest.find(tile));
+				bool const cached(it != manifest.end() && it->second == hash && std::ifstream(get_map_tile_fn(dir, tile)).good());
+				if (cached) {++num_cached; continue;}
+				manifest[tile] = hash;
+				to_gen.push_back(tile);
+			}
+		}
+	} // for z
+	cout << "Map tiles: " << to_gen.size() << " to generate, " << num_cached << " cached" << endl;
+	int const num_gen(to_gen.size());
+	vector<unsigned char> failed(num_gen, 0);
+
+#pragma omp parallel for schedule(dynamic,1) if (num_gen > 1)
+	for (int i = 0; i < num_gen; ++i) {failed[i] = !write_map_tile(shader, to_gen[i], get_map_tile_fn(dir, to_gen[i]));}
+	bool success(1);
+
+	for (int i = 0; i < num_gen; ++i) {
+		if (failed[i]) {manifest.erase(to_gen[i]); success = 0;} // don't record failed tiles as cached
+	}
+	std::ofstream out(manifest_fn);
+	if (!out.good()) {std::cerr << "Error: failed to write map tile manifest " << manifest_fn << endl; return 0;}
+	for (auto const &t : manifest) {out << t.first.z << " " << t.first.x << " " << t.first.y << " " << t.second << endl;}
+	return success;
+}
+
+// command line entry point: generates the terrain for the current config/seed without a GL context, then writes tiles
+bool write_map_tiles_headless(string const &dir, unsigned max_zoom, float x1, float y1, float x2, float y2) {
+
+	mesh_gen_cpu_only = 1;
+	reset_planet_defaults();
+	alloc_matrices();
+	init_terrain_mesh();
+	gen_mesh(0, 0, 0);
+	update_sun_and_moon();
+	return write_map_tiles(dir, max_zoom, x1, y1, x2, y2);
+}
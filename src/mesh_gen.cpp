@@ -46,6 +46,7 @@ float sthresh[2][2] = {{0.68, 0.86}, {0.48, 0.72}}; // {grass, snow}, {lo, hi}
 ttex lttex_dirt[NTEX_DIRT];
 vector<float> height_histogram;
 hmap_params_t hmap_params;
+bool mesh_gen_cpu_only(0); // no GL context (headless map tiles); GPU noise modes are evaluated on the CPU
 
 
 extern bool combined_gu;
@@ -67,6 +68,7 @@ void update_temperature(bool verbose);
 void compute_scale();
 
 bool using_hmap_with_detail();
+float get_noise_zval(float xval, float yval, int mode, int shape);
 
 
 
@@ -355,6 +357,21 @@ float do_glaciate_exp(float value) {
 
 float get_rel_wpz() {return CLIP_TO_01(W_PLANE_Z + water_h_off_rel);}
 
+uint64_t get_mesh_gen_params_hash() { // changes when the procedural terrain height function changes (seed, mesh config, etc.)
+	fnv1a_hasher_t hasher;
+	hasher(sinTable);
+	hasher(hmap_params);
+	hasher(mesh_gen_mode);
+	hasher(mesh_gen_shape);
+	hasher(start_eval_sin);
+	hasher(GLACIATE);
+	hasher(glaciate_exp);
+	hasher(mesh_scale);
+	hasher(mesh_scale_z);
+	hasher(zmax_est);
+	return hasher.get();
+}
+
 float get_volcano_height(float xi, float yi) {
 	float const freq(mesh_scale/hmap_params.volcano_width), x(freq*xi), y(freq*yi), dist(sqrt(x*x + y*y));
 	if (dist > 2.0) return 0.0; // too far, no effect (optimization)
@@ -592,6 +609,14 @@ bool mesh_xy_grid_cache_t::build_arrays(float x0, float y0, float dx, float dy,
 	do_glaciate = 0; // must set enable_glaciate() after this call if needed
 	cached_vals.clear();
 
+	if (gen_mode >= MGEN_SIMPLEX_GPU && mesh_gen_cpu_only) { // same noise function on the CPU - slow, but doesn't need a GL context
+		cached_vals.resize(nx*ny);
+#pragma omp parallel for schedule(static,1)
+		for (int y = 0; y < (int)ny; ++y) {
+			for (unsigned x = 0; x < nx; ++x) {cached_vals[y*nx + x] = get_noise_zval((x*dx + x0)*DX_VAL_INV, (y*dy + y0)*DY_VAL_INV, gen_mode, gen_shape);}
+		}
+		return 1;
+	}
 	if (gen_mode >= MGEN_SIMPLEX_GPU) { // GPU simplex noise - always cache values
 		bool const is_running(cshader && cshader->get_is_running());
 		if (!is_running) {run_gpu_simplex();} // launch the job
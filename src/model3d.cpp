@@ -12,12 +12,14 @@
 #include "lightmap.h" // for lmap_manager_t
 #include <fstream>
 #include <queue>
+#include <chrono>
 #include "meshoptimizer.h"
 
 bool const ENABLE_BUMP_MAPS  = 1;
 bool const ENABLE_SPEC_MAPS  = 1;
 bool const ENABLE_INTER_REFLECTIONS = 1;
 unsigned const MAGIC_NUMBER  = 42987143; // arbitrary file signature
+unsigned const MAGIC_NUMBER_BLOCKS = 42987145; // file signature for files that also store the block mode and subdivision/LOD blocks
 unsigned const BLOCK_SIZE    = 32768; // in vertex indices
 
 bool model_calc_tan_vect(1); // slower and more memory but sometimes better quality/smoother transitions
@@ -302,7 +304,10 @@ template<typename T> void indexed_vntc_vect_t<T>::gen_lod_blocks(unsigned npts)
 	indices.swap(ixs);
 }
 
-template<typename T> void indexed_vntc_vect_t<T>::finalize(unsigned npts) { // Note: called when reading obj files, not model3d files
+// which type of blocks finalize() generates: 0=none, 1=LOD blocks, 2=subdivision blocks
+unsigned get_model_block_mode() {return (use_model_lod_blocks ? 1 : (no_subdiv_model ? 0 : 2));}
+
+template<typename T> void indexed_vntc_vect_t<T>::finalize(unsigned npts) { // Note: called when reading obj files, and model3d files with mismatched blocks
 
 	optimize(npts);
 
@@ -645,16 +650,14 @@ template<typename T> unsigned indexed_vntc_vect_t<T>::add_vertex(T const &v, ver
 
 	T v2(v);
 	if (vmap.get_average_normals()) {v2.n = zero_vector;}
-	auto it(vmap.find(v2));
-	unsigned ix;
+	unsigned ix(vmap.find(v2));
 
-	if (it == vmap.end()) { // not found
+	if (ix == VMAP_NOT_FOUND) { // not found
 		ix = (unsigned)size();
 		this->push_back(v);
-		vmap[v2] = ix;
+		vmap.insert(v2, ix);
 	}
 	else { // found
-		ix = it->second;
 		assert(ix < size());
 
 		if (vmap.get_average_normals()) {
@@ -666,6 +669,29 @@ template<typename T> unsigned indexed_vntc_vect_t<T>::add_vertex(T const &v, ver
 	return ix;
 }
 
+// compares welding of a model's vertices (in input order, without per-material clears) using the old std::map vs. the hash table
+void benchmark_vertex_welding(vector<vert_norm_tc> const &verts) {
+
+	typedef std::chrono::high_resolution_clock hr_clock_t;
+	auto get_ms([](hr_clock_t::time_point const &t1) {return 1000.0f*std::chrono::duration_cast<std::chrono::duration<float>>(hr_clock_t::now() - t1).count();});
+	cout << "Vertex welding benchmark for " << verts.size() << " vertices:" << endl;
+	{
+		hr_clock_t::time_point const t1(hr_clock_t::now());
+		map<vert_norm_tc, unsigned> vmap;
+		for (auto i = verts.begin(); i != verts.end(); ++i) {vmap.insert(make_pair(*i, (unsigned)vmap.size()));}
+		cout << "  std::map: " << get_ms(t1) << " ms, " << vmap.size() << " unique" << endl;
+	}
+	for (unsigned n = 0; n < ((model_weld_epsilon > 0.0) ? 2U : 1U); ++n) {
+		hr_clock_t::time_point const t1(hr_clock_t::now());
+		vntc_map_t vmap(0, (n ? model_weld_epsilon : 0.0f));
+
+		for (auto i = verts.begin(); i != verts.end(); ++i) {
+			if (vmap.find(*i) == VMAP_NOT_FOUND) {vmap.insert(*i, (unsigned)vmap.size());}
+		}
+		cout << "  hash eps=" << (n ? model_weld_epsilon : 0.0f) << ": " << get_ms(t1) << " ms, " << vmap.size() << " unique" << endl;
+	}
+}
+
 
 template<typename T> float indexed_vntc_vect_t<T>::get_prim_area(unsigned i, unsigned npts) const {
 
@@ -766,11 +792,27 @@ template<typename T> void indexed_vntc_vect_t<T>::invert_tcy() {
 template<typename T> void indexed_vntc_vect_t<T>::write(ostream &out) const {
 	vntc_vect_t<T>::write(out);
 	write_vector(out, indices);
+	// write the subdivision and LOD blocks so that they don't need to be recomputed when reading; indices are already reordered to match
+	write_vector(out, blocks);
+	write_vector(out, lod_blocks);
+	out.write((char const *)&amin, sizeof(float));
+	out.write((char const *)&amax, sizeof(float));
 }
 
-template<typename T> void indexed_vntc_vect_t<T>::read(istream &in) {
+// blocks_valid: the file has blocks that were generated with the same block mode as the current config
+template<typename T> void indexed_vntc_vect_t<T>::read(istream &in, bool has_blocks, bool blocks_valid) {
 	vntc_vect_t<T>::read(in);
 	read_vector(in, indices);
+	optimized = 1; // vertices were optimized before writing
+
+	if (has_blocks) { // newer file format
+		read_vector(in, blocks);
+		read_vector(in, lod_blocks);
+		in.read((char *)&amin, sizeof(float));
+		in.read((char *)&amax, sizeof(float));
+	}
+	if (blocks_valid) {finalized = 1;} // else leave finalized = 0 so that finalize() generates the blocks for the current mode
+	else {clear_blocks();}
 }
 
 
@@ -839,6 +881,10 @@ template<typename T> void vntc_vect_block_t<T>::finalize(unsigned npts) {
 	for (auto i = begin(); i != end(); ++i) {i->finalize(npts);}
 }
 
+template<typename T> void vntc_vect_block_t<T>::add_finalize_jobs(vector<model_finalize_job_t<T> > &jobs, unsigned npts) {
+	for (auto i = begin(); i != end(); ++i) {jobs.push_back(model_finalize_job_t<T>(&(*i), npts));}
+}
+
 template<typename T> void vntc_vect_block_t<T>::free_vbos() {
 	for (auto i = begin(); i != end(); ++i) {i->clear_vbos();}
 }
@@ -919,6 +965,7 @@ template<typename T> void vntc_vect_block_t<T>::merge_into_single_vector() {
 		vector_add_to(i->indices, dest.indices); // merge indices
 	}
 	dest.calc_bounding_volumes(); // can be optimized
+	dest.clear_blocks(); // blocks only cover the first vector's indices
 	this->resize(1); // remove all but the first block
 }
 
@@ -929,11 +976,11 @@ template<typename T> bool vntc_vect_block_t<T>::write(ostream &out) const {
 	return 1;
 }
 
-template<typename T> bool vntc_vect_block_t<T>::read(istream &in) {
+template<typename T> bool vntc_vect_block_t<T>::read(istream &in, bool has_blocks, bool blocks_valid) {
 
 	this->clear();
 	this->resize(read_uint(in));
-	for (auto i = begin(); i != end(); ++i) {i->read(in);}
+	for (auto i = begin(); i != end(); ++i) {i->read(in, has_blocks, blocks_valid);}
 	if (merge_model_objects) {merge_into_single_vector();} // model was split per object, and we don't want that; merge into a single vector
 	return 1;
 }
@@ -1230,12 +1277,12 @@ bool material_t::write(ostream &out) const {
 }
 
 
-bool material_t::read(istream &in) {
+bool material_t::read(istream &in, bool has_blocks, bool blocks_valid) {
 
 	in.read((char *)this, sizeof(material_params_t));
 	read_vector(in, name);
 	read_vector(in, filename);
-	return (geom.read(in) && geom_tan.read(in));
+	return (geom.read(in, has_blocks, blocks_valid) && geom_tan.read(in, has_blocks, blocks_valid));
 }
 
 
@@ -1558,9 +1605,23 @@ void model3d::mark_mat_as_used(int mat_id) {
 
 void model3d::finalize() {
 
-#pragma omp parallel for schedule(dynamic)
-	for (int i = 0; i < (int)materials.size(); ++i) {materials[i].finalize();}
-	unbound_geom.finalize();
+	// finalize each geometry block in parallel rather than each material, since a few materials often contain most of the triangles
+	vector<model_finalize_job_t<vert_norm_tc    > > jobs;
+	vector<model_finalize_job_t<vert_norm_tc_tan> > jobs_tan;
+	unbound_geom.add_finalize_jobs(jobs);
+
+	for (deque<material_t>::iterator m = materials.begin(); m != materials.end(); ++m) {
+		m->geom.add_finalize_jobs(jobs);
+		m->geom_tan.add_finalize_jobs(jobs_tan);
+	}
+	sort(jobs.begin(), jobs.end()); // start the largest blocks first for better load balancing
+	sort(jobs_tan.begin(), jobs_tan.end());
+	int const num_jobs(jobs.size()), tot_jobs(num_jobs + jobs_tan.size());
+
+#pragma omp parallel for schedule(dynamic) if (tot_jobs > 1)
+	for (int i = 0; i < tot_jobs; ++i) {
+		if (i < num_jobs) {jobs[i].ivv->finalize(jobs[i].npts);} else {jobs_tan[i-num_jobs].ivv->finalize(jobs_tan[i-num_jobs].npts);}
+	}
 }
 
 
@@ -2167,7 +2228,8 @@ bool model3d::write_to_disk(string const &fn) const { // Note: transforms not wr
 		return 0;
 	}
 	cout << "Writing model3d file " << fn << endl;
-	write_uint(out, MAGIC_NUMBER);
+	write_uint(out, MAGIC_NUMBER_BLOCKS);
+	write_uint(out, get_model_block_mode());
 	out.write((char const *)&bcube, sizeof(cube_t));
 	if (!unbound_geom.write(out)) return 0;
 	write_uint(out, (unsigned)materials.size());
@@ -2193,25 +2255,31 @@ bool model3d::read_from_disk(string const &fn) { // Note: transforms not read
 	clear(); // ???
 	unsigned const magic_number_comp(read_uint(in));
 
-	if (magic_number_comp != MAGIC_NUMBER) {
+	bool const has_blocks(magic_number_comp == MAGIC_NUMBER_BLOCKS);
+
+	if (magic_number_comp != MAGIC_NUMBER && !has_blocks) {
 		cerr << "Error reading model3d file " << fn << ": Invalid file format (magic number check failed)." << endl;
 		return 0;
 	}
 	cout << "Reading model3d file " << fn << endl;
 	from_model3d_file = 1;
+	// blocks written with a different mode (or not written) are dropped and regenerated by finalize() below
+	bool const blocks_valid(has_blocks && read_uint(in) == get_model_block_mode());
 	in.read((char *)&bcube, sizeof(cube_t));
-	if (!unbound_geom.read(in)) return 0;
+	if (!unbound_geom.read(in, has_blocks, blocks_valid)) return 0;
 	materials.resize(read_uint(in));
 	
 	for (deque<material_t>::iterator m = materials.begin(); m != materials.end(); ++m) {
-		if (!m->read(in)) {
+		if (!m->read(in, has_blocks, blocks_valid)) {
 			cerr << "Error reading material" << endl;
 			return 0;
 		}
 		mat_map[m->name] = (m - materials.begin());
 	}
 	//simplify_indices(0.1); // TESTING
-	return in.good();
+	if (!in.good()) return 0;
+	finalize(); // only generates blocks for geometry that isn't already finalized
+	return 1;
 }
 
 
@@ -181,21 +181,93 @@ template<typename T> struct hash_by_bytes { // should work with all packed verte
 	//uint32_t operator()(T const &v) const {return jenkins_one_at_a_time_hash((const uint32_t*)&v, sizeof(T)>>2);} // faster but lower quality hash
 };
 
-//template<typename T> class vertex_map_t : public unordered_map<T, unsigned, hash_by_bytes<T>> {
-template<typename T> class vertex_map_t : public map<T, unsigned> {
+extern float model_weld_epsilon;
+
+unsigned const VMAP_NOT_FOUND = (unsigned)-1;
+
+// open addressing hash table of unique vertices => vertex index, used for welding vertices when building models;
+// T must be a packed vertex type made of floats with the position (v) first;
+// if pos_eps > 0, positions are snapped to a grid of that spacing and vertices in the same grid cell with equal other attributes are welded
+template<typename T> class vertex_map_t {
 
 	int last_mat_id;
 	unsigned last_obj_id;
 	bool average_normals;
+	float pos_eps_inv;
+	vector<T> keys;
+	vector<unsigned> vals, key_hash, slots; // slots store key index+1, 0 = empty; size is a power of 2
+
+	static unsigned const NUM_WORDS = sizeof(T)/sizeof(float);
+
+	void get_qpos(T const &v, int qpos[3]) const {UNROLL_3X(qpos[i_] = round_fp(pos_eps_inv*v.v[i_]);)}
+
+	uint32_t hash_vertex(T const &v) const { // FNV-1a over the float bit patterns, with a 32-bit avalanche finalizer
+		float const *const f((float const *)&v);
+		int qpos[3] = {0,0,0};
+		if (pos_eps_inv > 0.0f) {get_qpos(v, qpos);}
+		uint32_t h(2166136261U);
 
+		for (unsigned i = 0; i < NUM_WORDS; ++i) {
+			uint32_t w;
+			if (i < 3 && pos_eps_inv > 0.0f) {w = (uint32_t)qpos[i];}
+			else {float const val(f[i] + 0.0f); memcpy(&w, &val, sizeof(uint32_t));} // adding 0.0 maps -0.0 to 0.0 so that equal values hash equally
+			h = (h ^ w)*16777619U;
+		}
+		h ^= h >> 16; h *= 0x85ebca6bU; h ^= h >> 13; h *= 0xc2b2ae35U; h ^= h >> 16;
+		return h;
+	}
+	bool keys_equal(T const &a, T const &b) const {
+		if (pos_eps_inv == 0.0f) {return (a == b);}
+		int qa[3], qb[3];
+		get_qpos(a, qa);
+		get_qpos(b, qb);
+		if (qa[0] != qb[0] || qa[1] != qb[1] || qa[2] != qb[2]) return 0;
+		T a2(a);
+		a2.v = b.v; // compare everything other than position exactly
+		return (a2 == b);
+	}
+	void insert_slot(unsigned key_ix) {
+		unsigned const mask(slots.size() - 1);
+		for (unsigned s = (key_hash[key_ix] & mask); ; s = ((s + 1) & mask)) {
+			if (slots[s] == 0) {slots[s] = key_ix + 1; return;}
+		}
+	}
+	void rehash(unsigned new_sz) {
+		slots.clear();
+		slots.resize(new_sz, 0);
+		for (unsigned i = 0; i < keys.size(); ++i) {insert_slot(i);}
+	}
 public:
-	vertex_map_t(bool average_normals_=0) : last_mat_id(-1), last_obj_id(0), average_normals(average_normals_) {}
+	vertex_map_t(bool average_normals_=0, float pos_eps=model_weld_epsilon) :
+		last_mat_id(-1), last_obj_id(0), average_normals(average_normals_), pos_eps_inv((pos_eps > 0.0f) ? 1.0f/pos_eps : 0.0f) {}
 	bool get_average_normals() const {return average_normals;}
-	
+	size_t size() const {return keys.size();}
+	bool empty() const {return keys.empty();}
+	void clear() {keys.clear(); vals.clear(); key_hash.clear(); slots.clear();} // keeps capacity for reuse by the next material/object
+
+	unsigned find(T const &v) const { // returns the vertex index, or VMAP_NOT_FOUND
+		if (keys.empty()) return VMAP_NOT_FOUND;
+		uint32_t const h(hash_vertex(v));
+		unsigned const mask(slots.size() - 1);
+
+		for (unsigned s = (h & mask); slots[s] != 0; s = ((s + 1) & mask)) {
+			unsigned const ix(slots[s] - 1);
+			if (key_hash[ix] == h && keys_equal(keys[ix], v)) return vals[ix];
+		}
+		return VMAP_NOT_FOUND;
+	}
+	void insert(T const &v, unsigned val) { // caller must ensure v is not already present
+		if (slots.empty()) {slots.resize(1024, 0);}
+		else if (2*(keys.size() + 1) > slots.size()) {rehash(2*slots.size());} // max load factor of 0.5
+		keys.push_back(v);
+		vals.push_back(val);
+		key_hash.push_back(hash_vertex(v));
+		insert_slot(keys.size() - 1);
+	}
 	void check_for_clear(int mat_id) {
-		if (mat_id != last_mat_id || this->size() >= MAX_VMAP_SIZE) {
+		if (mat_id != last_mat_id || size() >= MAX_VMAP_SIZE) {
 			last_mat_id = mat_id;
-			this->clear();
+			clear();
 		}
 	}
 };
@@ -313,19 +385,28 @@ public:
 	void get_polygons(get_polygon_args_t &args, unsigned npts) const;
 	unsigned get_gpu_mem() const {return (vntc_vect_t<T>::get_gpu_mem() + (this->ivbo_valid() ? indices.size()*sizeof(unsigned) : 0));}
 	void invert_tcy();
+	void clear_blocks() {blocks.clear(); lod_blocks.clear(); finalized = 0;} // finalize() will regenerate them
 	void write(ostream &out) const;
-	void read(istream &in);
+	void read(istream &in, bool has_blocks, bool blocks_valid);
 	bool indexing_enabled() const {return !indices.empty();}
 	void mark_need_normalize() {need_normalize = 1;}
 };
 
 
+template<typename T> struct model_finalize_job_t { // one geometry block to be finalized, possibly in parallel with others
+	indexed_vntc_vect_t<T> *ivv;
+	unsigned npts;
+	model_finalize_job_t(indexed_vntc_vect_t<T> *ivv_, unsigned npts_) : ivv(ivv_), npts(npts_) {}
+	bool operator<(model_finalize_job_t const &j) const {return (ivv->indices.size() > j.ivv->indices.size());} // largest first
+};
+
 template<typename T> struct vntc_vect_block_t : public deque<indexed_vntc_vect_t<T> > {
 
 	using deque<indexed_vntc_vect_t<T> >::begin;
 	using deque<indexed_vntc_vect_t<T> >::end;
 	
 	void finalize(unsigned npts);
+	void add_finalize_jobs(vector<model_finalize_job_t<T> > &jobs, unsigned npts);
 	void clear() {free_vbos(); deque<indexed_vntc_vect_t<T> >::clear();}
 	void free_vbos();
 	cube_t get_bcube() const;
@@ -340,7 +421,7 @@ template<typename T> struct vntc_vect_block_t : public deque<indexed_vntc_vect_t
 	void simplify_indices(float reduce_target);
 	void merge_into_single_vector();
 	bool write(ostream &out) const;
-	bool read(istream &in);
+	bool read(istream &in, bool has_blocks, bool blocks_valid);
 };
 
 
@@ -360,13 +441,14 @@ template<typename T> struct geometry_t {
 	cube_t get_bcube() const;
 	void invert_tcy() {triangles.invert_tcy(); quads.invert_tcy();}
 	void finalize  () {triangles.finalize(3); quads.finalize(4);}
+	void add_finalize_jobs(vector<model_finalize_job_t<T> > &jobs) {triangles.add_finalize_jobs(jobs, 3); quads.add_finalize_jobs(jobs, 4);}
 	void free_vbos () {triangles.free_vbos(); quads.free_vbos();}
 	void clear();
 	void get_stats(model3d_stats_t &stats) const;
 	void calc_area(float &area, unsigned &ntris);
 	void simplify_indices(float reduce_target);
 	bool write(ostream &out) const {return (triangles.write(out) && quads.write(out));}
-	bool read(istream &in)         {return (triangles.read (in ) && quads.read (in ));}
+	bool read(istream &in, bool has_blocks, bool blocks_valid) {return (triangles.read(in, has_blocks, blocks_valid) && quads.read(in, has_blocks, blocks_valid));}
 };
 
 
@@ -445,7 +527,7 @@ struct material_t : public material_params_t {
 	colorRGBA get_ad_color() const;
 	colorRGBA get_avg_color(texture_manager const &tmgr, int default_tid=-1) const;
 	bool write(ostream &out) const;
-	bool read(istream &in);
+	bool read(istream &in, bool has_blocks, bool blocks_valid);
 };
 
 
@@ -634,6 +716,7 @@ void free_model_context();
 void render_models(int shadow_pass, int reflection_pass, int trans_op_mask=3, vector3d const &xlate=zero_vector);
 void ensure_model_reflection_cube_maps();
 void auto_calc_model_zvals();
+void benchmark_vertex_welding(vector<vert_norm_tc> const &verts);
 void get_cur_model_polygons(vector<coll_tquad> &ppts, model3d_xform_t const &xf=model3d_xform_t(), unsigned lod_level=0);
 unsigned get_loaded_models_gpu_mem();
 void get_cur_model_edges_as_cubes(vector<cube_t> &cubes, model3d_xform_t const &xf);
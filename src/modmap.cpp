@@ -116,10 +116,12 @@ bool named_obj::rename(s_object const &sobj, string const &name_) {
 }
 
 
-bool named_obj::lookup_given_name(s_object const &sobj) {
+bool named_obj::lookup_given_name(s_object const &sobj) {return lookup_given_name(sobj, modmaps[MOD_NAME]);}
 
-	modmap::const_iterator it(modmaps[MOD_NAME].find(sobj));
-	if (it == modmaps[MOD_NAME].end()) return 0;
+bool named_obj::lookup_given_name(s_object const &sobj, modmap const &given_names) {
+
+	modmap::const_iterator it(given_names.find(sobj));
+	if (it == given_names.end()) return 0;
 	name = it->second;
 	return 1;
 }
@@ -12,7 +12,7 @@
 #include "fast_atof.h"
 
 
-extern bool use_obj_file_bump_grayscale;
+extern bool use_obj_file_bump_grayscale, model_weld_benchmark;
 extern float model_auto_tc_scale, model_mat_lod_thresh;
 extern model3ds all_models;
 
@@ -742,6 +742,7 @@ public:
 		PRINT_TIME("Model Texture Load");
 		size_t const num_blocks(pblocks.size());
 		model3d::proc_model_normals(vn, recalc_normals); // if recalc_normals
+		vector<vert_norm_tc> bench_verts; // only used if model_weld_benchmark
 
 		while (!pblocks.empty()) {
 			poly_data_block const &pd(pblocks.back());
@@ -780,10 +781,12 @@ public:
 				} // for p
 				if (!colors.empty()) {poly.color = poly.color/j->npts; poly.color.A = 1.0;} // FIXME: uses average vertex color for each face/polygon
 				num_faces += model.add_polygon(poly, vmap, vmap_tan, j->mat_id, j->obj_id);
+				if (model_weld_benchmark) {bench_verts.insert(bench_verts.end(), poly.begin(), poly.end());}
 				pix += j->npts;
 			} // for j
 			pblocks.pop_back();
 		}
+		if (model_weld_benchmark) {benchmark_vertex_welding(bench_verts);}
 		model.finalize(); // optimize vertices, remove excess capacity, compute bounding cube, subdivide, generate LOD blocks
 		PRINT_TIME("Model3d Build");
 		
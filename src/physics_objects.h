@@ -234,16 +234,16 @@ struct dwobject : public basic_physics_obj { // size = 67(68) (dynamic world obj
 	float get_true_radius() const;
 	float get_true_density() const;
 	float get_true_mass() const;
-	void advance_object(bool disable_motionless_objects, int iter, int obj_index);
-	int surface_advance();
+	void advance_object(bool disable_motionless_objects, int iter, int obj_index, float dt);
+	int surface_advance(float dt);
 	void set_orient_for_coll(vector3d const *const forced_norm);
-	int check_water_collision(float vz_old);
+	int check_water_collision(float vz_old, float dt);
 	void surf_collide_obj() const;
 	void elastic_collision(point const &obj_pos, float energy, int obj_type);
 	int object_bounce(int coll_type, vector3d &norm, float elasticity2, float z_offset, vector3d const &obj_vel=zero_vector);
-	int object_still_stopped(int obj_index);
+	int object_still_stopped(int obj_index, float dt);
 	void do_coll_damage();
-	int check_vert_collision(int obj_index, int do_coll_funcs, int iter, vector3d *cnorm=NULL,
+	int check_vert_collision(int obj_index, int do_coll_funcs, int iter, float dt, vector3d *cnorm=NULL,
 		vector3d const &mdir=all_zeros, bool skip_dynamic=0, bool only_drawn=0, int only_cobj=-1, bool skip_movable=0);
 	int multistep_coll(point const &last_pos, int obj_index, unsigned nsteps);
 	void update_vel_from_damage(vector3d const &dv);
@@ -268,7 +268,7 @@ class vert_coll_detector {
 	bool player, already_bounced, skip_dynamic, only_drawn, skip_movable;
 	int coll, obj_index, do_coll_funcs, only_cobj;
 	unsigned cdir, lcoll;
-	float z_old, o_radius, z1, z2;
+	float dt, z_old, o_radius, z1, z2;
 	point pos, pold;
 	vector3d motion_dir, obj_vel;
 	vector3d *cnorm;
@@ -278,11 +278,11 @@ class vert_coll_detector {
 	void check_cobj_intersect(int index, bool enable_cfs, bool player_step);
 	void init_reset_pos();
 public:
-	vert_coll_detector(dwobject &obj_, int obj_index_, int do_coll_funcs_, int iter_, vector3d *cnorm_,
+	vert_coll_detector(dwobject &obj_, int obj_index_, int do_coll_funcs_, int iter_, vector3d *cnorm_, float dt_,
 		vector3d const &mdir=zero_vector, bool skip_dynamic_=0, bool only_drawn_=0, int only_cobj_=-1, bool skip_movable_=0) :
 	obj(obj_), type(obj.type), iter(iter_), player(type == CAMERA || type == SMILEY || type == WAYPOINT),
 	already_bounced(0), skip_dynamic(skip_dynamic_), only_drawn(only_drawn_), skip_movable(skip_movable_), coll(0), obj_index(obj_index_),
-	do_coll_funcs(do_coll_funcs_), only_cobj(only_cobj_), cdir(0), lcoll(0), z_old(obj.pos.z), o_radius(0.0),
+	do_coll_funcs(do_coll_funcs_), only_cobj(only_cobj_), cdir(0), lcoll(0), dt(dt_), z_old(obj.pos.z), o_radius(0.0),
 	z1(0.0), z2(0.0), pos(obj.pos), pold(obj.pos), motion_dir(mdir), obj_vel(obj.velocity), cnorm(cnorm_) {}
 
 	void check_cobj(int index);
@@ -290,6 +290,119 @@ public:
 };
 
 
+// per-frame broadphase for a group of moving objects vs. static cobjs: swept sphere bcubes are sorted by x (sweep and prune) into slabs,
+// each slab is sorted by y and split into batches of nearby objects, and the static cobj BVH is queried once per batch;
+// vert_coll_detector then only tests each object's precomputed candidates, as long as the object stays within its swept bcube
+// and no static cobjs have changed since the build; otherwise it falls back to querying the cobj BVH
+class obj_coll_broadphase_t {
+
+	struct swept_obj_t : public cube_t {
+		unsigned obj_ix;
+		swept_obj_t(cube_t const &c, unsigned ix) : cube_t(c), obj_ix(ix) {}
+	};
+	struct cand_range_t {
+		cube_t bcube; // swept bcube; zero area if not added
+		unsigned start, end;
+		cand_range_t() : bcube(all_zeros), start(0), end(0) {}
+	};
+	vector<swept_obj_t> objs;
+	vector<cand_range_t> obj_cands; // indexed by object index within the group
+	vector<unsigned> cands, batch_cobjs; // static cobj indices
+	dwobject const *group_objs;
+	unsigned num_group_objs, built_change_count; // static_cobjs_change_count at the time of build()
+
+	void add_batch(unsigned start, unsigned end);
+public:
+	obj_coll_broadphase_t() : group_objs(nullptr), num_group_objs(0), built_change_count(0) {}
+	bool is_active() const {return (group_objs != nullptr);}
+	void begin_group(dwobject const *objs_, unsigned num_objs);
+	void add_obj(dwobject const &obj, unsigned obj_ix, float radius, float time, float grav_dz);
+	void build();
+	void end_group();
+	bool check_static_cobjs(dwobject const &obj, int obj_index, float radius, vert_coll_detector &vcd) const;
+};
+
+
+// side effects of object physics that modify shared state; when active, these are queued per-thread during a parallel object update
+// and applied serially afterward; with static scheduling, applying the queues in thread order reproduces the serial object order;
+// an object that needs a result from shared state (a cobj collision function) is deferred: its queued effects are dropped, and the
+// caller must restore it and advance it again serially
+class obj_side_effects_t {
+
+	struct splash_t {
+		point pos;
+		int xpos, ypos;
+		float water_z, draw_size, energy, radius;
+		splash_t(point const &p, int x, int y, float wz, float ds, float e, float r) : pos(p), xpos(x), ypos(y), water_z(wz), draw_size(ds), energy(e), radius(r) {}
+	};
+	struct coll_reg_t {
+		int cindex;
+		unsigned char coll_time, coll_type;
+		coll_reg_t(int c, unsigned char ct, unsigned char t) : cindex(c), coll_time(ct), coll_type(t) {}
+	};
+	struct decal_t {
+		point pos;
+		vector3d orient;
+		colorRGBA color;
+		tex_range_t tr;
+		float radius, min_dist_scale;
+		int tid, cid, lifetime;
+		bool is_glass, rand_angle;
+		decal_t(point const &p, float r, vector3d const &o, int t, int c, colorRGBA const &col, bool ig, bool ra, int lt, float mds, tex_range_t const &tr_) :
+			pos(p), orient(o), color(col), tr(tr_), radius(r), min_dist_scale(mds), tid(t), cid(c), lifetime(lt), is_glass(ig), rand_angle(ra) {}
+	};
+	struct sound_t {
+		point pos;
+		unsigned id;
+		float gain, pitch;
+		sound_t(unsigned i, point const &p, float g, float pi) : pos(p), id(i), gain(g), pitch(pi) {}
+	};
+	struct land_color_t {
+		colorRGBA color;
+		float x, y, radius;
+		land_color_t(colorRGBA const &c, float x_, float y_, float r) : color(c), x(x_), y(y_), radius(r) {}
+	};
+	struct thread_queue_t {
+		vector<splash_t> splashes;
+		vector<coll_reg_t> coll_regs;
+		vector<decal_t> decals;
+		vector<sound_t> sounds;
+		vector<land_color_t> land_colors;
+		unsigned marks[5] = {0}; // queue sizes at the start of the current object
+		bool obj_deferred = 0;
+		rand_gen_t rgen; // reseeded for each object
+		void set_marks();
+		void drop_to_marks();
+		void clear();
+	};
+	vector<thread_queue_t> queues; // one per thread
+	unsigned num_begins;
+	bool active;
+
+	thread_queue_t &get_queue();
+public:
+	obj_side_effects_t() : num_begins(0), active(0) {}
+	bool is_active() const {return active;}
+	void begin();
+	void apply_and_end();
+	// random numbers for object physics: when active, each object uses its own generator seeded from its index, which makes the results
+	// independent of thread scheduling and avoids racing on the global rand() state; otherwise these use the global rand()
+	void begin_obj(unsigned obj_ix);
+	bool end_obj(); // returns true if the object was deferred
+	void defer_obj();
+	int   rand_int();
+	float rand_uniform(float val1, float val2);
+	float signed_rand_float();
+	void add_splash(point const &pos, int xpos, int ypos, float water_z, float draw_size, float energy, float radius);
+	void register_coll(int cindex, unsigned char coll_time, unsigned char coll_type);
+	// these are applied immediately when not active
+	void gen_decal(point const &pos, float radius, vector3d const &orient, int tid, int cid, colorRGBA const &color, bool is_glass=0,
+		bool rand_angle=0, int lifetime=60*TICKS_PER_SECOND, float min_dist_scale=1.0, tex_range_t const &tr=tex_range_t());
+	void gen_sound(unsigned id, point const &pos, float gain=1.0, float pitch=1.0);
+	void add_color_to_landscape_texture(colorRGBA const &color, float xval, float yval, float radius);
+};
+
+
 struct enabled_pos {
 
 	point pos;
@@ -223,7 +223,7 @@ void multi_sensor_t::write_to_cobj_file(std::ostream &out) const { // one per li
 
 platform::platform(float fs, float rs, float sd, float rd, float dst, float ad, point const &o, vector3d const &dir_, bool c, bool ir, bool ul, bool destroys_, int sid, sensor_t const &cur_sensor) :
 	cont(c), is_rot(ir), update_light(ul), destroys(destroys_), fspeed(fs), rspeed(rs), sdelay(sd), rdelay(rd), ext_dist(dst), act_dist(ad),
-	origin(o), dir(dir_.get_norm()), sound_id(sid), delta(all_zeros), sensor(cur_sensor)
+	origin(o), dir(dir_.get_norm()), sound_id(sid), delta(all_zeros), moved(0), sensor(cur_sensor)
 {
 	assert(dir_ != all_zeros);
 	assert(fspeed > 0.0 && sdelay >= 0.0 && act_dist >= 0.0);
@@ -299,6 +299,7 @@ void platform::move_platform(float dist_traveled) { // linear distance or rotati
 	for (auto i = cobjs.begin(); i != cobjs.end(); ++i) { // handle rotation
 		coll_objects.get_cobj(*i).rotate_about(origin, dir, dist_traveled, 1);
 	}
+	moved |= !cobjs.empty();
 }
 
 void platform::check_play_sound() const {
@@ -384,6 +385,7 @@ void platform::advance_timestep() {
 	}
 	if (pos != last_pos) {
 		delta = (pos - last_pos); // can accumulate error, fix?
+		moved |= !cobjs.empty();
 
 		for (vector<unsigned>::const_iterator i = cobjs.begin(); i != cobjs.end(); ++i) {
 			coll_obj &cobj(coll_objects.get_cobj(*i));
@@ -4,9 +4,23 @@
 
 #include "3DWorld.h"
 #include "profiler.h"
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+#include <sstream>
 
 using std::string;
 
+unsigned const PROF_RING_SIZE    = (1<<14); // zone events per thread; must be a power of 2
+unsigned const PROF_MAX_DEPTH    = 32;
+unsigned const PROF_FRAME_WINDOW = 1024; // number of per-frame samples kept for percentile stats
+unsigned const TELEMETRY_WINDOW  = 300;  // number of frames averaged for the overlay
+
+bool frame_profiler_enabled(0), telemetry_enabled(0);
+
 
 template <typename T> class timing_profiler {
 
@@ -45,7 +59,7 @@ public:
 timing_profiler<int> global_profiler;
 timing_profiler<float> global_highres_profiler;
 
-void toggle_timing_profiler() {global_profiler.enabled ^= 1; global_highres_profiler.enabled ^= 1;}
+void toggle_timing_profiler() {global_profiler.enabled ^= 1; global_highres_profiler.enabled ^= 1; frame_profiler_enabled ^= 1;}
 void register_timing_value(const char *str, int delta_time) {global_profiler.register_time(str, delta_time);}
 
 void timing_profiler_stats() {
@@ -53,6 +67,7 @@ void timing_profiler_stats() {
 	global_profiler.clear();
 	global_highres_profiler.stats();
 	global_highres_profiler.clear();
+	frame_profiler_stats();
 }
 
 void highres_timer_t::end() {
@@ -62,3 +77,312 @@ void highres_timer_t::end() {
 	name.clear(); // make sure we don't double count this
 }
 
+
+
+// *** hierarchical frame profiler ***
+
+
+high_resolution_clock::time_point const prof_start_time(high_resolution_clock::now());
+
+inline uint64_t get_prof_time_ns() {return duration_cast<nanoseconds>(high_resolution_clock::now() - prof_start_time).count();}
+
+// events are read by the main thread while the owning thread may be overwriting them, so they're guarded by a sequence number (seqlock):
+// seq is 0 while the event is being written, then the event index + 1; the fields are relaxed atomics so that torn reads are detected rather than UB
+struct prof_event_t {
+	std::atomic<uint64_t> seq, t_start, t_end; // t_end: 0 = still open
+	std::atomic<char const *> name;
+	std::atomic<unsigned> depth;
+	prof_event_t() : seq(0), t_start(0), t_end(0), name(nullptr), depth(0) {}
+};
+
+struct prof_event_snap_t { // consistent copy of a prof_event_t
+	char const *name=nullptr;
+	uint64_t t_start=0, t_end=0;
+	unsigned depth=0;
+};
+
+class prof_thread_buf_t { // written only by the owning thread; read by the main thread for aggregation and export
+	std::unique_ptr<prof_event_t[]> events;
+	std::atomic<uint64_t> head; // total number of events begun on this thread
+	uint64_t open_stack[PROF_MAX_DEPTH];
+	unsigned depth=0, overflow=0; // overflow = number of zones past PROF_MAX_DEPTH that were not recorded
+public:
+	unsigned const tid;
+	// aggregation state (main thread only)
+	uint64_t agg_pos=0; // next event to aggregate
+	char const *agg_path_names[PROF_MAX_DEPTH] = {}; // name of the most recent zone at each depth, so that paths span frames
+	vector<pair<uint64_t, string>> agg_open; // {event index, zone path} of zones that were still open when reached
+
+	prof_thread_buf_t(unsigned tid_) : events(new prof_event_t[PROF_RING_SIZE]), head(0), tid(tid_) {}
+
+	void begin(char const *const name) {
+		if (depth == PROF_MAX_DEPTH) {++overflow; return;}
+		uint64_t const ix(head.load(std::memory_order_relaxed));
+		prof_event_t &e(events[ix & (PROF_RING_SIZE-1)]);
+		e.seq.store(0, std::memory_order_relaxed); // mark as being written
+		std::atomic_thread_fence(std::memory_order_release);
+		e.name   .store(name, std::memory_order_relaxed);
+		e.t_start.store(get_prof_time_ns(), std::memory_order_relaxed);
+		e.depth  .store(depth, std::memory_order_relaxed);
+		e.t_end  .store(0, std::memory_order_relaxed);
+		e.seq.store(ix+1, std::memory_order_release);
+		open_stack[depth++] = ix;
+		head.store(ix+1, std::memory_order_release);
+	}
+	void end() {
+		if (overflow > 0) {--overflow; return;}
+		if (depth == 0) return; // profiler was enabled inside of a zone
+		prof_event_t &e(events[open_stack[--depth] & (PROF_RING_SIZE-1)]);
+		e.t_end.store(max(get_prof_time_ns(), e.t_start.load(std::memory_order_relaxed)+1), std::memory_order_release); // never zero
+	}
+	uint64_t get_head() const {return head.load(std::memory_order_acquire);}
+
+	bool read_event(uint64_t ix, prof_event_snap_t &s) const { // returns 0 if the event was overwritten or is being written by the owning thread
+		prof_event_t const &e(events[ix & (PROF_RING_SIZE-1)]);
+		uint64_t const seq(e.seq.load(std::memory_order_acquire));
+		if (seq != ix+1) return 0;
+		s.name    = e.name   .load(std::memory_order_relaxed);
+		s.t_start = e.t_start.load(std::memory_order_relaxed);
+		s.t_end   = e.t_end  .load(std::memory_order_relaxed);
+		s.depth   = e.depth  .load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return (e.seq.load(std::memory_order_relaxed) == seq);
+	}
+};
+
+class frame_profiler_t {
+	struct zone_stats_t {
+		uint64_t calls=0;
+		double total_ms=0.0, cur_frame_ms=0.0;
+		vector<float> frame_ms; // ring of per-frame totals over the last PROF_FRAME_WINDOW frames in which the zone was active
+		unsigned frame_pos=0;
+
+		void add_frame() {
+			if (cur_frame_ms == 0.0) return; // not active this frame
+			if (frame_ms.size() < PROF_FRAME_WINDOW) {frame_ms.push_back(cur_frame_ms);} else {frame_ms[frame_pos] = cur_frame_ms;}
+			frame_pos = (frame_pos + 1) % PROF_FRAME_WINDOW;
+			cur_frame_ms = 0.0;
+		}
+	};
+	std::mutex bufs_mutex;
+	vector<std::unique_ptr<prof_thread_buf_t>> bufs; // never freed, since thread_local pointers reference them
+	map<string, zone_stats_t> zones; // keyed by zone path, "parent/child"
+	unsigned num_frames=0;
+	uint64_t num_dropped=0;
+
+	void add_zone_time(string const &path, prof_event_snap_t const &e) {
+		zone_stats_t &zs(zones[path]);
+		double const ms(1.0E-6*(e.t_end - e.t_start));
+		++zs.calls;
+		zs.total_ms     += ms;
+		zs.cur_frame_ms += ms;
+	}
+	void aggregate_thread(prof_thread_buf_t &buf) {
+		uint64_t const head(buf.get_head());
+		if (head - buf.agg_pos > PROF_RING_SIZE) {num_dropped += head - PROF_RING_SIZE - buf.agg_pos; buf.agg_pos = head - PROF_RING_SIZE;} // overwritten
+		prof_event_snap_t e;
+		unsigned num_open(0);
+
+		for (auto i = buf.agg_open.begin(); i != buf.agg_open.end(); ++i) { // zones left open in earlier frames
+			if (!buf.read_event(i->first, e)) {++num_dropped; continue;} // overwritten before it was closed
+			if (e.t_end == 0) {buf.agg_open[num_open++] = *i; continue;} // still open
+			add_zone_time(i->second, e);
+		}
+		buf.agg_open.resize(num_open);
+
+		for (uint64_t ix = buf.agg_pos; ix < head; ++ix) {
+			if (!buf.read_event(ix, e)) {++num_dropped; continue;} // overwritten while reading
+			assert(e.depth < PROF_MAX_DEPTH);
+			buf.agg_path_names[e.depth] = e.name;
+			string path;
+			
+			for (unsigned d = 0; d <= e.depth; ++d) {
+				if (d > 0) {path.push_back('/');}
+				path += (buf.agg_path_names[d] ? buf.agg_path_names[d] : "?"); // parent may have been dropped
+			}
+			if (e.t_end == 0) {buf.agg_open.emplace_back(ix, path);} // still open; check again next frame, but continue with its children
+			else {add_zone_time(path, e);}
+		}
+		buf.agg_pos = head;
+	}
+public:
+	prof_thread_buf_t *register_thread() {
+		std::lock_guard<std::mutex> lock(bufs_mutex);
+		bufs.emplace_back(new prof_thread_buf_t(bufs.size()));
+		return bufs.back().get();
+	}
+	void next_frame() {
+		{
+			std::lock_guard<std::mutex> lock(bufs_mutex);
+			for (auto i = bufs.begin(); i != bufs.end(); ++i) {aggregate_thread(**i);}
+		}
+		for (auto i = zones.begin(); i != zones.end(); ++i) {i->second.add_frame();}
+		++num_frames;
+	}
+	void stats(std::ostream &out) {
+		if (zones.empty()) return;
+		out << "Frame profiler: " << num_frames << " frames, " << bufs.size() << " threads, " << num_dropped << " dropped zones" << endl;
+		out << "zone calls total_ms avg_ms/frame p50 p95 p99 max" << endl;
+
+		for (auto i = zones.begin(); i != zones.end(); ++i) {
+			zone_stats_t const &zs(i->second);
+			vector<float> v(zs.frame_ms);
+			if (v.empty()) continue;
+			sort(v.begin(), v.end());
+			auto pct([&v](float p) {return v[min(v.size()-1, size_t(p*v.size()))];});
+			unsigned const depth(std::count(i->first.begin(), i->first.end(), '/'));
+			out << string(2*depth, ' ') << i->first.substr(i->first.find_last_of('/')+1) << ": " << zs.calls << "\t" << zs.total_ms << "\t"
+				 << zs.total_ms/max(num_frames, 1U) << "\t" << pct(0.5) << "\t" << pct(0.95) << "\t" << pct(0.99) << "\t" << v.back() << endl;
+		}
+	}
+	void clear() {zones.clear(); num_frames = 0; num_dropped = 0;}
+
+	// call from the main thread; includes all completed zones still in the thread ring buffers; events that are overwritten by their thread while being read are skipped
+	bool export_chrome_trace(string const &fn) {
+		std::ofstream out(fn);
+		if (!out.good()) {cout << "Error: Failed to open chrome trace file " << fn << " for writing" << endl; return 0;}
+		out << std::fixed << std::setprecision(3); // ns resolution for ts/dur in us; the default format loses precision and uses scientific notation for large times
+		out << "{\"traceEvents\":[";
+		bool first(1);
+		std::lock_guard<std::mutex> lock(bufs_mutex);
+
+		for (auto i = bufs.begin(); i != bufs.end(); ++i) {
+			prof_thread_buf_t const &buf(**i);
+			uint64_t const head(buf.get_head());
+			prof_event_snap_t e;
+
+			for (uint64_t ix = ((head > PROF_RING_SIZE) ? (head - PROF_RING_SIZE) : 0); ix < head; ++ix) {
+				if (!buf.read_event(ix, e)) continue; // overwritten
+				if (e.t_end == 0 || e.name == nullptr) continue; // still open
+				if (!first) {out << ",";}
+				out << "\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buf.tid
+					<< ",\"ts\":" << 0.001*e.t_start << ",\"dur\":" << 0.001*(e.t_end - e.t_start) << "}"; // in us
+				first = 0;
+			}
+		}
+		out << "\n]}" << endl;
+		if (!out.good()) {cout << "Error: Failed to write chrome trace file " << fn << endl; return 0;}
+		cout << "Wrote frame profiler chrome trace to " << fn << endl;
+		return 1;
+	}
+};
+
+frame_profiler_t frame_profiler;
+thread_local prof_thread_buf_t *prof_thread_buf(nullptr);
+
+void prof_zone_begin(char const *const name) {
+	if (prof_thread_buf == nullptr) {prof_thread_buf = frame_profiler.register_thread();}
+	prof_thread_buf->begin(name);
+}
+void prof_zone_end() {
+	if (prof_thread_buf) {prof_thread_buf->end();}
+}
+void prof_next_frame() {
+	if (frame_profiler_enabled) {frame_profiler.next_frame();}
+}
+void frame_profiler_stats() {
+	frame_profiler.stats(cout);
+	if (frame_profiler_enabled) {export_frame_profiler_chrome_trace("frame_profile.json");}
+	frame_profiler.clear();
+}
+void write_frame_profiler_stats(std::ostream &out) {frame_profiler.stats(out);}
+void clear_frame_profiler() {frame_profiler.clear();}
+bool export_frame_profiler_chrome_trace(string const &fn) {return frame_profiler.export_chrome_trace(fn);}
+
+
+// *** telemetry ***
+
+class telemetry_t {
+	struct value_t {
+		bool is_counter=0;
+		double cur=0.0; // current frame value
+		vector<float> window; // last TELEMETRY_WINDOW frames
+		unsigned pos=0, col=0; // col = file column
+		value_t(bool is_counter_=0) : is_counter(is_counter_) {}
+
+		void next_frame() {
+			if (window.size() < TELEMETRY_WINDOW) {window.push_back(cur);} else {window[pos] = cur;}
+			pos = (pos + 1) % TELEMETRY_WINDOW;
+			if (is_counter) {cur = 0.0;} // counters restart each frame; gauges keep their last value
+		}
+		float get_avg() const {return (window.empty() ? 0.0f : std::accumulate(window.begin(), window.end(), 0.0f)/window.size());}
+		float get_max() const {return (window.empty() ? 0.0f : *std::max_element(window.begin(), window.end()));}
+		float get_last() const {return (window.empty() ? 0.0f : window[((pos == 0) ? window.size() : pos) - 1]);}
+	};
+	std::mutex mutex; // values may be published from worker threads
+	map<string, value_t> values;
+	vector<map<string, value_t>::const_iterator> cols; // in file column order
+	std::ofstream out;
+	bool use_json=0, need_header=1;
+	unsigned frame=0;
+	high_resolution_clock::time_point last_frame_time=high_resolution_clock::now();
+
+	value_t &get_value(char const *const name, bool is_counter) {
+		auto it(values.find(name));
+		if (it == values.end()) {it = values.emplace(name, value_t(is_counter)).first; need_header = 1;}
+		return it->second;
+	}
+	void write_frame() {
+		if (use_json) {
+			out << "{\"frame\":" << frame;
+			for (auto i = values.begin(); i != values.end(); ++i) {out << ",\"" << i->first << "\":" << i->second.cur;}
+			out << "}\n";
+			return;
+		}
+		if (need_header) { // new values were added; CSV readers should split the file on header lines
+			cols.clear();
+			for (auto i = values.begin(); i != values.end(); ++i) {cols.push_back(i);}
+			out << "frame";
+			for (auto i = cols.begin(); i != cols.end(); ++i) {out << "," << (*i)->first;}
+			out << "\n";
+			need_header = 0;
+		}
+		out << frame;
+		for (auto i = cols.begin(); i != cols.end(); ++i) {out << "," << (*i)->second.cur;}
+		out << "\n";
+	}
+public:
+	void set_gauge(char const *const name, double val) {
+		std::lock_guard<std::mutex> lock(mutex);
+		get_value(name, 0).cur = val;
+	}
+	void add_count(char const *const name, double val) {
+		std::lock_guard<std::mutex> lock(mutex);
+		get_value(name, 1).cur += val;
+	}
+	bool open_file(string const &fn) {
+		out.open(fn);
+		if (!out.good()) {cout << "Error: Failed to open telemetry file " << fn << " for writing" << endl; return 0;}
+		use_json = (fn.size() >= 6 && fn.substr(fn.size()-6) == ".jsonl");
+		return 1;
+	}
+	void next_frame() {
+		high_resolution_clock::time_point const now(high_resolution_clock::now());
+		std::lock_guard<std::mutex> lock(mutex);
+		get_value("frame_ms", 0).cur = 1000.0*duration_cast<duration<double>>(now - last_frame_time).count();
+		last_frame_time = now;
+		if (out.is_open()) {write_frame();}
+		for (auto i = values.begin(); i != values.end(); ++i) {i->second.next_frame();}
+		++frame;
+		if ((frame & 255) == 0) {out.flush();} // flush periodically for long runs that may not exit cleanly
+	}
+	string get_overlay_text() {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::ostringstream oss;
+		oss.precision(4);
+		
+		for (auto i = values.begin(); i != values.end(); ++i) {
+			oss << i->first << ": " << i->second.get_last() << " avg " << i->second.get_avg() << " max " << i->second.get_max() << "\n";
+		}
+		return oss.str();
+	}
+};
+
+telemetry_t telemetry;
+
+void telemetry_set_gauge(char const *const name, double val) {if (telemetry_enabled) {telemetry.set_gauge(name, val);}}
+void telemetry_add_count(char const *const name, double val) {if (telemetry_enabled) {telemetry.add_count(name, val);}}
+void telemetry_next_frame() {if (telemetry_enabled) {telemetry.next_frame();}}
+bool open_telemetry_file(string const &fn) {return telemetry.open_file(fn);}
+string get_telemetry_overlay_text() {return telemetry.get_overlay_text();}
+
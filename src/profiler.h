@@ -5,6 +5,7 @@
 
 #include <string>
 #include <chrono>
+#include <iosfwd>
 
 using namespace std::chrono;
 
@@ -20,3 +21,44 @@ public:
 	void end();
 };
 
+// hierarchical frame profiler: zones nest per thread (including OpenMP workers), are aggregated per frame, and can be exported as a Chrome trace
+// Note: zone names must be string literals or otherwise outlive the profiler
+extern bool frame_profiler_enabled;
+
+void prof_zone_begin(char const *const name);
+void prof_zone_end();
+void prof_next_frame(); // call once per frame from the main thread
+void frame_profiler_stats();
+void write_frame_profiler_stats(std::ostream &out);
+void clear_frame_profiler();
+bool export_frame_profiler_chrome_trace(std::string const &fn);
+
+class prof_zone_t {
+	bool active;
+public:
+	prof_zone_t(char const *const name) : active(frame_profiler_enabled) {if (active) {prof_zone_begin(name);}}
+	~prof_zone_t() {if (active) {prof_zone_end();}}
+};
+
+#define PROF_ZONE_CAT2(a, b) a##b
+#define PROF_ZONE_CAT(a, b) PROF_ZONE_CAT2(a, b)
+#define PROFILE_ZONE(name) prof_zone_t const PROF_ZONE_CAT(prof_zone_, __LINE__)(name)
+
+// telemetry: named gauges (last value in the frame) and counters (summed over the frame) published by subsystems each frame,
+// kept in a rolling window for the onscreen overlay and optionally written to a .csv or .jsonl file
+extern bool telemetry_enabled;
+
+void telemetry_set_gauge(char const *const name, double val);
+void telemetry_add_count(char const *const name, double val=1.0);
+void telemetry_next_frame(); // call once per frame from the main thread; also records frame_ms
+bool open_telemetry_file(std::string const &fn);
+std::string get_telemetry_overlay_text(); // one line per value
+
+class accum_timer_t { // adds the elapsed time in ms to *val if val is non-null
+	double *val;
+	high_resolution_clock::time_point timer1;
+public:
+	accum_timer_t(double *val_) : val(val_) {if (val) {timer1 = high_resolution_clock::now();}}
+	~accum_timer_t() {if (val) {*val += 1000.0*duration_cast<duration<double>>(high_resolution_clock::now() - timer1).count();}}
+};
+
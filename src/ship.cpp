@@ -7,6 +7,7 @@
 #include "explosion.h"
 #include "obj_sort.h"
 #include "timetest.h"
+#include "profiler.h"
 #include "shaders.h"
 #include "draw_utils.h"
 #include "gl_ext_arb.h"
@@ -559,20 +560,40 @@ void apply_univ_physics() {
 
 	if (animate2) {
 		// before or after advance time and collision detection?
-		for (unsigned i = 0; i < nobjs; ++i) { // can create new objects here
-			if (c_uobjs[i].flags & (OBJ_FLAGS_SHIP | OBJ_FLAGS_PROJ)) {c_uobjs[i].obj->ai_action();}
+		{
+			PROFILE_ZONE("Ship AI");
+			accum_timer_t const timer(get_usim_phase_time(USIM_PHASE_AI));
+
+			// ships choose their targets in parallel from the current object state, which isn't modified until the serial pass below;
+			// target line of sight tests transform lines into static object space, so fill their lazily cached rotations first
+			for (auto i = stat_objs.begin(); i != stat_objs.end(); ++i) {i->obj->calc_rotation_vectors();}
+			#pragma omp parallel for schedule(dynamic,16)
+			for (int i = 0; i < (int)nobjs; ++i) {
+				if (c_uobjs[i].flags & OBJ_FLAGS_SHIP) {c_uobjs[i].obj->prepare_ai_action();}
+			}
+			for (unsigned i = 0; i < nobjs; ++i) { // can create new objects here
+				if (c_uobjs[i].flags & (OBJ_FLAGS_SHIP | OBJ_FLAGS_PROJ)) {c_uobjs[i].obj->ai_action();}
+			}
 		}
 		if (player_autopilot) {update_cpos();}
 		if (TIMETEST) PRINT_TIME("  AI Action");
 
 		// c_uobjs is invalid at this point
 		// don't update nobjs - delay first physics event for new objects until next frame
-		for (unsigned i = 0; i < nobjs; ++i) {uobjs[i]->apply_physics();}
+		{
+			PROFILE_ZONE("Ship Physics");
+			accum_timer_t const timer(get_usim_phase_time(USIM_PHASE_PHYSICS));
+			for (unsigned i = 0; i < nobjs; ++i) {uobjs[i]->apply_physics();}
+		}
 		if (TIMETEST) PRINT_TIME("  Apply Physics");
 		float const timestep(fticks/NUM_TIMESTEPS);
 
 		for (unsigned t = 0; t < NUM_TIMESTEPS; ++t) { // here is where the objects move
-			collision_detect_objects(coll_objs, t);
+			{
+				PROFILE_ZONE("Ship Collision");
+				accum_timer_t const timer(get_usim_phase_time(USIM_PHASE_COLL));
+				collision_detect_objects(coll_objs, t);
+			}
 			if (t == 0) {remove_bad_cobjs_and_particles(coll_objs);}
 
 			for (unsigned i = 0; i < nobjs; ++i) {
@@ -607,7 +628,7 @@ void sort_uobjects() { // originally part of apply_univ_physics()
 }
 
 
-bool proc_coll(free_obj *o1, free_obj *o2) {
+bool coll_pair_might_int(free_obj const *o1, free_obj const *o2) { // thread safe, read only
 
 	assert(o1 != NULL && o2 != NULL);
 
@@ -616,7 +637,14 @@ bool proc_coll(free_obj *o1, free_obj *o2) {
 		if (o1->get_src() != NULL && o1->get_src() == o2->get_src()) return 0; // ship's projectiles don't collide with each other
 	}
 	if (o1->is_stationary() && o2->is_stationary()) return 0; // two stationary objects - if they collide we can't do anything
-	if (!o1->obj_int_obj(o2)) return 0;
+	return 1;
+}
+
+// known_int: obj_int_obj() has already been tested for these object positions
+bool proc_coll(free_obj *o1, free_obj *o2, bool known_int) {
+
+	if (!coll_pair_might_int(o1, o2)) return 0;
+	if (!known_int && !o1->obj_int_obj(o2)) return 0;
 	point const p1(o1->get_pos()), p2(o2->get_pos()); // cache these in case they change
 	vector3d const v1(o1->get_tot_vel_at(p2)), v2(o2->get_tot_vel_at(p1)); // cache these in case they change
 	float const elasticity(o1->get_elasticity()*o2->get_elasticity());
@@ -633,9 +661,14 @@ void collision_detect_objects(vector<cached_obj> &objs, unsigned t) {
 
 	//RESET_TIME;
 	unsigned const size((unsigned)objs.size());
-	static vector<interval> intervals;
-	intervals.clear();
-	intervals.reserve(2*size);
+	static vector<unsigned> order; // indices of objects to test, sorted by x-min
+	static vector<float> xlo, xhi;
+	static vector<unsigned char> collided;
+	static vector<vector<pair<unsigned, unsigned> > > thread_pairs; // {order index, order index}, with the first < the second
+	static vector<pair<unsigned, unsigned> > pairs;
+	order.clear();
+	xlo.resize(size);
+	xhi.resize(size);
 
 	for (unsigned i = 0; i < size; ++i) {
 		if (objs[i].flags & OBJ_FLAGS_BAD_) continue;
@@ -650,54 +683,57 @@ void collision_detect_objects(vector<cached_obj> &objs, unsigned t) {
 		assert(radius > 0.0);
 		if (left == right) continue; // floating point precision limitation or bug?
 		assert(left < right);
-		intervals.push_back(interval(left,  i, 1));
-		intervals.push_back(interval(right, i, 0));
+		xlo[i] = left;
+		xhi[i] = right;
+		order.push_back(i);
 	}
-	unsigned const size2((unsigned)intervals.size());
-	static vector<unsigned> locs, work;
-	locs.resize(size);
-	work.clear();
-	sort(intervals.begin(), intervals.end());
-
-	for (unsigned i = 0; i < size2; ++i) {
-		unsigned const ix(intervals[i].ix & ~LEFT_EDGE_BIT), ix_flags(objs[ix].flags);
-		unsigned bad_flags(OBJ_FLAGS_BAD_);
-		if ( ix_flags & OBJ_FLAGS_PART) {bad_flags |= OBJ_FLAGS_PART;} // skip particle-particle collisions
-		if ( ix_flags & OBJ_FLAGS_NOC2) {bad_flags |= OBJ_FLAGS_NOC2;} // both objects have their C2 flags set, skip the collision
-		if ((ix_flags & OBJ_FLAGS_PROJ) && (ix_flags & OBJ_FLAGS_NOPC)) {bad_flags |= OBJ_FLAGS_PROJ;} // no projectile-projectile collision
-		
-		if (intervals[i].ix & LEFT_EDGE_BIT) { // start a new sphere
-			unsigned const wsize((unsigned)work.size());
-
-			if (wsize > 0) {
-				point const pos_i(objs[ix].pos);
-				float const c_radius_i(objs[ix].radius), pisd(pos_i.y);
-
-				for (unsigned k = 0; k < wsize; ++k) {
-					cached_obj &obj(objs[work[k]]);
-					if (obj.flags & bad_flags) continue;
-					float const radius(c_radius_i + obj.radius);
-					if (fabs(pisd - obj.pos.y) > radius || !dist_less_than(pos_i, obj.pos, radius)) continue; // no intersection
-
-					if (proc_coll(objs[ix].obj, obj.obj)) {
-						objs[ix].refresh(); // ???
-						obj.refresh(); // ???
-					}
-				}
-			}
-			locs[ix] = wsize;
-			work.push_back(ix);
-		}
-		else { // end a current sphere
-			assert(!work.empty());
-			unsigned const lix(locs[ix]);
-			//assert(ix < size && lix < work.size() && work[lix] == ix && locs[work.back()] == work.size()-1);
-			swap(work[lix], work.back());
-			locs[work[lix]] = lix;
-			work.pop_back();
+	sort(order.begin(), order.end(), [](unsigned a, unsigned b) {return ((xlo[a] == xlo[b]) ? (a < b) : (xlo[a] < xlo[b]));});
+	unsigned const num((unsigned)order.size());
+	thread_pairs.resize(max(1, omp_get_max_threads_3dw()));
+	// the narrowphase transforms points into object space, so fill the lazily cached rotations serially (they're invalidated each frame)
+	for (auto i = order.begin(); i != order.end(); ++i) {objs[*i].obj->calc_rotation_vectors();}
+
+	// broadphase + narrowphase: each object is tested against the objects that start within its x-range; read only, so can run in parallel
+	#pragma omp parallel for schedule(dynamic,64)
+	for (int n = 0; n < (int)num; ++n) {
+		unsigned const ix(order[n]);
+		cached_obj const &obj1(objs[ix]);
+		vector<pair<unsigned, unsigned> > &tpairs(thread_pairs[omp_get_thread_num_3dw()]);
+
+		for (unsigned m = n+1; m < num && xlo[order[m]] <= xhi[ix]; ++m) {
+			cached_obj const &obj2(objs[order[m]]);
+			unsigned const ix_flags(obj2.flags), flags_and(obj1.flags & ix_flags); // obj2 starts later, so it's ix in the original 1D sweep
+			if (flags_and & OBJ_FLAGS_PART) continue; // skip particle-particle collisions
+			if (flags_and & OBJ_FLAGS_NOC2) continue; // both objects have their C2 flags set, skip the collision
+			if ((ix_flags & OBJ_FLAGS_PROJ) && (ix_flags & OBJ_FLAGS_NOPC) && (obj1.flags & OBJ_FLAGS_PROJ)) continue; // no projectile-projectile collision
+			float const radius(obj1.radius + obj2.radius);
+			if (fabs(obj1.pos.y - obj2.pos.y) > radius || !dist_less_than(obj1.pos, obj2.pos, radius)) continue; // no intersection
+			// obj2 starts later, so it's the first object in the collision, as in the original 1D sweep
+			if (!coll_pair_might_int(obj2.obj, obj1.obj)) continue;
+			intersect_params ip; // local so that the shared def_int_params isn't written by multiple threads
+			if (!obj2.obj->obj_int_obj(obj1.obj, ip)) continue;
+			tpairs.push_back(make_pair(unsigned(n), m));
 		}
 	}
-	assert(work.empty());
+	pairs.clear();
+
+	for (auto i = thread_pairs.begin(); i != thread_pairs.end(); ++i) {
+		pairs.insert(pairs.end(), i->begin(), i->end());
+		i->clear();
+	}
+	sort(pairs.begin(), pairs.end()); // deterministic order, independent of thread scheduling
+	collided.clear();
+	collided.resize(size, 0);
+
+	// apply collision responses serially; objects that have already collided have moved, so must be re-tested
+	for (auto i = pairs.begin(); i != pairs.end(); ++i) {
+		unsigned const ix1(order[i->second]), ix2(order[i->first]);
+		if ((objs[ix1].flags | objs[ix2].flags) & OBJ_FLAGS_BAD_) continue; // destroyed by an earlier collision
+		if (!proc_coll(objs[ix1].obj, objs[ix2].obj, !(collided[ix1] || collided[ix2]))) continue;
+		objs[ix1].refresh(); // ???
+		objs[ix2].refresh(); // ???
+		collided[ix1] = collided[ix2] = 1;
+	}
 	//PRINT_TIME("Collision");
 }
 
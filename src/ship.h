@@ -807,6 +807,7 @@ public:
 	virtual void draw_flares_only() const {assert(0);}
 	virtual void set_temp(float temp, point const &tcenter, free_obj const *source=NULL);
 	virtual void ai_action() {} // default: no AI
+	virtual void prepare_ai_action() {} // called for all ships in parallel before ai_action(); may only modify this object
 	virtual void first_frame_hook() {}
 	virtual void apply_physics();
 	virtual void advance_time(float timestep);
@@ -1192,6 +1193,15 @@ class u_ship : public free_obj, public u_ship_base {
 	string name;
 	mesh2d surface_mesh;
 
+	struct targ_decision_t { // target chosen by choose_target() from the current object state, applied later by commit_target()
+		free_obj const *prev_target=NULL, *target=NULL, *new_target=NULL; // prev_target is target_obj at the time of the choice
+		unsigned time=0, tup_time=0;
+		float min_dist=0.0;
+		bool valid=0, update_tup=0, set_target_set=0;
+	};
+	targ_decision_t targ_decision; // computed by prepare_ai_action()
+	rand_gen_t ai_rgen; // per-ship so that target choice doesn't use the global rand()
+
 	u_ship(u_ship const &) = delete; // forbidden
 	void operator=(u_ship const &) = delete; // forbidden
 
@@ -1229,7 +1239,7 @@ public:
 	int get_move_dir();
 	vector3d get_tot_vel_at(point const &cpos) const;
 	bool do_multi_target() const;
-	free_obj const *find_closest_target(point const &pos0, float min_dist, float max_dist, bool req_shields) const;
+	free_obj const *find_closest_target(point const &pos0, free_obj const *cur_targ, float min_dist, float max_dist, bool req_shields, rand_gen_t &rgen) const;
 	void acquire_target(float min_dist);
 	free_obj *get_closest_dock(float max_dist) const;
 	int get_line_query_obj_types(float qdist) const {return ((sobj_dist < qdist) ? OBJ_TYPE_LGU : OBJ_TYPE_LARGE);} // only test planets, etc. if close to sobj
@@ -1252,6 +1262,7 @@ public:
 	bool has_slow_fighters() const;
 	void fire_at_target(free_obj const *const targ_obj, float min_dist);
 	virtual void ai_action();
+	void prepare_ai_action();
 	void fire_point_defenses();
 	bool find_coll_enemy_proj(float dmax, point &p_int) const;
 	virtual bool has_clear_line_of_fire(us_weapon const &weap, vector3d const &fire_dir, float target_dist) const;
@@ -1375,6 +1386,10 @@ private:
 	bool is_enemy(free_obj const *obj) const;
 	bool is_hostile_to(free_obj const *obj) const;
 	float get_min_att_dist() const;
+	float get_ai_min_dist() const;
+	bool is_ai_acquire_frame() const;
+	void choose_target(float min_dist, targ_decision_t &td);
+	bool commit_target(targ_decision_t const &td);
 }; // end u_ship
 
 
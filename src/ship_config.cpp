@@ -792,6 +792,12 @@ bool ship_defs_file_reader::setup_and_read_file(const char *fn) {
 	// postprocessing and error checking
 	for (unsigned i = 0; i < NUM_US_CLASS; ++i) {sclasses[i].setup(i);}
 	for (unsigned i = 0; i < NUM_UWEAP   ; ++i) {us_weapons[i].setup(i);}
+
+	for (unsigned i = 0; i < NUM_US_CLASS; ++i) { // fill the lazily cached values now, since ship target queries read them from multiple threads
+		sclasses[i].offense_rating();
+		sclasses[i].defense_rating();
+		sclasses[i].get_weap_range();
+	}
 	return 1;
 }
 
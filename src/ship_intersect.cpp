@@ -450,10 +450,11 @@ bool u_ship::ship_int_obj(u_ship const *const ship, intersect_params &ip) const
 	if (cobjs1.empty()) return ship->sphere_int_obj(pos, c_radius, ip);
 	cobj_vector_t const &cobjs2(ship->get_cobjs());
 	if (cobjs2.empty()) return sphere_int_obj(ship->get_pos(), ship->get_c_radius(), ip);
-	if (!sphere_int_obj(ship->get_pos(), ship->get_c_radius())) return 0; // bounding sphere test, no intersect calc
-	if (!ship->sphere_int_obj(pos, c_radius, (NO_OBJ_OBJ_INT ? ip : def_int_params))) return 0; // bounding sphere test
+	intersect_params bs_ip; // local rather than def_int_params, since this may be called from multiple threads
+	if (!sphere_int_obj(ship->get_pos(), ship->get_c_radius(), bs_ip)) return 0; // bounding sphere test, no intersect calc
+	if (!ship->sphere_int_obj(pos, c_radius, (NO_OBJ_OBJ_INT ? ip : bs_ip))) return 0; // bounding sphere test
 	if (NO_OBJ_OBJ_INT) return 1;
-	return (cobjs_int_obj(cobjs2, ship) && ship->cobjs_int_obj(cobjs1, this)); // *** add ip to call? ***
+	return (cobjs_int_obj(cobjs2, ship, bs_ip) && ship->cobjs_int_obj(cobjs1, this, bs_ip)); // *** add ip to call? ***
 }
 
 
@@ -52,7 +52,7 @@ tile_offset_t model3d_offset;
 
 extern bool inf_terrain_scenery, enable_tiled_mesh_ao, underwater, fog_enabled, volume_lighting, combined_gu, enable_depth_clamp, tt_triplanar_tex, use_grass_tess;
 extern bool use_instanced_pine_trees, enable_tt_model_reflect, water_is_lava, tt_fire_button_down, flashlight_on;
-extern unsigned grass_density, max_unique_trees, shadow_map_sz, num_birds_per_tile, num_fish_per_tile, erosion_iters_tt, num_rnd_grass_blocks;
+extern unsigned mesh_horizon_azimuths, grass_density, max_unique_trees, shadow_map_sz, num_birds_per_tile, num_fish_per_tile, erosion_iters_tt, num_rnd_grass_blocks;
 extern int DISABLE_WATER, display_mode, tree_mode, leaf_color_changed, ground_effects_level, animate2, iticks, num_trees, window_width, window_height;
 extern int invert_mh_image, is_cloudy, camera_surf_collide, show_fog, mesh_gen_mode, mesh_gen_shape, cloud_model, precip_mode, auto_time_adv, draw_model;
 extern float zmax, zmin, water_plane_z, mesh_scale, mesh_scale_z, vegetation, relh_adj_tex, grass_length, grass_width, fticks, cloud_height_offset, clouds_per_tile;
@@ -371,6 +371,7 @@ void tile_t::clear() {
 	mesh_weight_data.clear();
 	weight_data.clear();
 	zvals.clear();
+	horizons.clear();
 	clear_shadows();
 	pine_trees.clear_all();
 	decid_trees.clear();
@@ -425,6 +426,7 @@ bool tile_t::create_zvals(mesh_xy_grid_cache_t &height_gen, bool no_wait) {
 	//timer_t timer("Create Zvals");
 	if (enable_terrain_env) {update_terrain_params();}
 	zvals.resize(zvsize*zvsize);
+	horizons.clear(); // recomputed from the new zvals below
 	mzmin =  FAR_DISTANCE;
 	mzmax = -FAR_DISTANCE;
 	unsigned const block_size(zvsize/4), context_sz(stride + 2*AO_RAY_LEN);
@@ -468,6 +470,7 @@ bool tile_t::create_zvals(mesh_xy_grid_cache_t &height_gen, bool no_wait) {
 		} // for x
 	} // for y
 	if (!using_hmap) {apply_erosion(&zvals.front(), zvsize, zvsize, zmin, erosion_iters_tt);} // heightmap is eroded during load
+	if (mesh_horizon_azimuths > 0 && !is_distant) {calc_mesh_horizons(&zvals.front(), zvsize, zvsize, mesh_horizon_azimuths, horizons);}
 
 	for (unsigned yy = 0; yy < 4; ++yy) {
 		for (unsigned xx = 0; xx < 4; ++xx) {
@@ -649,6 +652,17 @@ void tile_t::calc_shadows_for_light(unsigned l) {
 }
 
 
+// light direction changes only require a lookup into the horizon table, but shadows cast across tile boundaries are not included
+void tile_t::calc_shadows_from_horizons(unsigned l) {
+
+	if (is_distant) return;
+	assert(!smask[l].empty());
+	assert(!horizons.empty()); // computed in create_zvals()
+	calc_mesh_shadows_from_horizons(l, get_light_pos(l), horizons, mesh_horizon_azimuths, &smask[l].front(), zvsize, zvsize);
+	((l == LIGHT_SUN) ? sun_shadows_invalid : moon_shadows_invalid) = 1;
+}
+
+
 void tile_t::proc_tile_queue(tile_t *init_tile, unsigned l) {
 
 	point const lpos(get_light_pos(l));
@@ -688,6 +702,7 @@ void tile_t::calc_shadows(bool calc_sun, bool calc_moon, bool no_push) {
 		if (!calc_light[l])    continue; // light not enabled
 		if (!smask[l].empty()) continue; // already calculated (cached)
 		smask[l].resize(zvals.size(), 0);
+		if (mesh_horizon_azimuths > 0) {calc_shadows_from_horizons(l); continue;}
 		//if (normal_zmin < 1.0 && get_light_pos(l).get_norm().xy_mag() < normal_zmin) { // terrain slope lower than sun slope
 		if (no_push) {calc_shadows_for_light(l);} else {proc_tile_queue(this, l);}
 	}
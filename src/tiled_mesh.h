@@ -175,6 +175,7 @@ private:
 	vector<tree_map_val> tree_map;
 	vector<unsigned char> mesh_weight_data, weight_data, ao_lighting;
 	vector<unsigned char> smask[NUM_LIGHT_SRC];
+	vector<unsigned char> horizons; // quantized horizon angle per azimuth per zval, if mesh_horizon_azimuths > 0
 	vector<float> sh_out[NUM_LIGHT_SRC][2];
 	vect_smap_t<tile_smap_data_t> smap_data;
 	small_tree_group pine_trees;
@@ -294,6 +295,7 @@ public:
 	// *** shadows ***
 	void calc_mesh_ao_lighting();
 	void calc_shadows_for_light(unsigned l);
+	void calc_shadows_from_horizons(unsigned l);
 	static void proc_tile_queue(tile_t *init_tile, unsigned l);
 	void calc_shadows(bool calc_sun, bool calc_moon, bool no_push=0);
 
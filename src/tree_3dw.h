@@ -133,9 +133,10 @@ struct tree_xform_t {
 
 class tree_builder_t : public tree_xform_t {
 
-	static vector<tree_cylin >   cylin_cache;
-	static vector<tree_branch>   branch_cache;
-	static vector<tree_branch *> branch_ptr_cache;
+	// per-thread so that trees can be generated in parallel
+	static thread_local vector<tree_cylin >   cylin_cache;
+	static thread_local vector<tree_branch>   branch_cache;
+	static thread_local vector<tree_branch *> branch_ptr_cache;
 
 	tree_branch base, roots, *branches_34[2], **branches;
 	int base_num_cylins, root_num_cylins, ncib, num_1_branches, num_big_branches_min, num_big_branches_max;
@@ -201,6 +202,8 @@ class tree_data_t {
 	vector<leaf_vert_type_t> leaf_data;
 	vector<draw_cylin> all_cylins;
 	vector<tree_leaf> leaves;
+	vector<float> leaf_bend_angles; // last bend angle applied to each leaf, used to skip leaves whose wind angle hasn't changed
+	vector<unsigned char> leaf_dirty_blocks; // one flag per block of leaves to upload, so that only modified ranges are sent to the GPU
 	tree_bb_tex_t render_leaf_texture, render_branch_texture;
 	int last_update_frame;
 	unsigned leaf_change_start, leaf_change_end;
@@ -238,6 +241,8 @@ public:
 	void remove_leaf_ix(unsigned i, bool update_data);
 	bool spraypaint_leaves(point const &pos, float radius, colorRGBA const &color, bool check_only);
 	void bend_leaf(unsigned i, float angle);
+	void bend_leaves_batched(vector<float> const &angles);
+	float get_leaf_bend_angle(unsigned i) const {return ((i < leaf_bend_angles.size()) ? leaf_bend_angles[i] : 0.0f);}
 	void draw_leaf_quads_from_vbo(unsigned max_leaves) const;
 	void draw_leaves_shadow_only(float size_scale);
 	void ensure_branch_vbo();
@@ -250,7 +255,7 @@ public:
 	void check_render_textures();
 	void update_normal_for_leaf(unsigned i);
 	void reset_leaf_pos_norm();
-	void alloc_leaf_data() {leaf_data.resize(4*leaves.size());}
+	void alloc_leaf_data() {leaf_data.resize(4*leaves.size()); leaf_bend_angles.resize(leaves.size(), 0.0);}
 	void clear_data();
 	void clear_context();
 	void on_leaf_color_change();
@@ -340,6 +345,7 @@ public:
 	  enable_leaf_wind(en_lw), use_clip_cube(0), tree_center(all_zeros), damage(0.0), damage_scale(0.0), last_size_scale(0.0), tree_nl_scale(1.0), tree_color(WHITE), clip_cube(all_zeros) {}
 	void enable_clip_cube(cube_t const &cc) {clip_cube = cc; use_clip_cube = 1;}
 	void bind_to_td(tree_data_t *td);
+	tree_data_t const *get_shared_tdata() const {return tree_data;} // null if private
 	void gen_tree(point const &pos, int size, int ttype, int calc_z, bool add_cobjs, bool user_placed, rand_gen_t &rgen,
 		float height_scale=1.0, float br_scale_mult=1.0, float nl_scale=1.0, bool has_4th_branches=0, bool allow_bushes=1);
 	void add_tree_collision_objects();
@@ -394,12 +400,21 @@ public:
 
 class tree_cont_t : public vector<tree> {
 
+	struct deferred_tree_t { // a tree placed but not yet generated
+		unsigned ix;
+		int ttype;
+		point pos;
+		rand_gen_t rgen;
+		deferred_tree_t(unsigned ix_, int ttype_, point const &pos_, rand_gen_t const &rgen_) : ix(ix_), ttype(ttype_), pos(pos_), rgen(rgen_) {}
+	};
 	tree_data_manager_t &shared_tree_data;
 	vector<pair<float, unsigned>> sorted;
 	vector<tree *> to_update_leaves;
 	cube_t all_bcube;
 	bool generated;
 
+	void gen_deferred_trees(vector<deferred_tree_t> &trees);
+
 public:
 	tree_cont_t(tree_data_manager_t &tds) : shared_tree_data(tds), generated(0) {all_bcube.set_to_zeros();}
 	bool was_generated() const {return generated;}
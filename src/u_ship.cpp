@@ -56,7 +56,7 @@ float const MAX_LEAD_SHOT_DOTP = 0.4; // ~21 degrees
 extern bool player_autopilot, player_auto_stop, player_enemy, regen_uses_credits, respawn_req_hw, hold_fighters, dock_fighters, build_any, ctrl_key_pressed, begin_motion;
 extern int frame_counter, iticks, onscreen_display, display_mode, animate2;
 extern float fticks, urm_proj, global_regen, ship_build_delay, hyperspeed_mult, player_turn_rate, rand_spawn_ship_dmax;
-extern unsigned alloced_fobjs[], team_credits[], init_credits[], ind_ships_used[];
+extern unsigned alloced_fobjs[], team_credits[], init_credits[], ind_ships_used[], univ_dist_ai_ticks;
 extern exp_type_params et_params[];
 extern vector<free_obj const *> a_targets, attackers;
 extern vector<ship_explosion> exploding;
@@ -80,6 +80,7 @@ u_ship::u_ship(unsigned sclass_, point const &pos0, unsigned align, unsigned ai_
 	init_align  = align;
 	is_flagship = 0;
 	child_stray_dist = 0.0;
+	ai_rgen.set_state(obj_id+1, 1);
 	init();
 	if (rand_orient) do_rotate(TWO_PI*rand_float(), TWO_PI*rand_float());
 }
@@ -407,7 +408,8 @@ bool u_ship::do_multi_target() const { // add time delay/rand-mod?
 }
 
 
-free_obj const *u_ship::find_closest_target(point const &pos0, float min_dist, float max_dist, bool req_shields) const {
+// cur_targ is the current target, which may differ from target_obj; rgen is used to occasionally accept the target of a nearby friendly ship
+free_obj const *u_ship::find_closest_target(point const &pos0, free_obj const *cur_targ, float min_dist, float max_dist, bool req_shields, rand_gen_t &rgen) const {
 
 	bool const dir_pref(specs().max_turn > 0.0);
 
@@ -424,14 +426,14 @@ free_obj const *u_ship::find_closest_target(point const &pos0, float min_dist, f
 			case ALIGN_PLAYER:
 				if (!player_enemy) return NULL;
 			default: // ALIGN_PIRATE, ALIGN_RED, ALIGN_BLUE, etc.
-				if (COMMON_TARGETS && (rand()&7) == 0) { // every 8th frame
+				if (COMMON_TARGETS && (rgen.rand()&7) == 0) { // every 8th frame
 					free_obj const *friendly(get_closest_ship(pos0, min_dist, max_dist, 0, 0, 0, 0, 0));
 					
 					if (friendly) { // see if a friendly has chosen a target, and if so, then accept the target as our own
 						free_obj const *targ(friendly->get_target());
 						
 						if (target_valid(targ) && targ != friendly->get_parent() && (!req_shields || targ->has_shields()) &&
-							(target_obj == NULL  || p2p_dist(targ->get_pos(), pos) <= min_dist) &&
+							(cur_targ == NULL  || p2p_dist(targ->get_pos(), pos) <= min_dist) &&
 							(COMMON_TARGETS == 2 || p2p_dist(targ->get_pos(), pos) <= max_dist))
 						{
 							return targ;
@@ -445,59 +447,66 @@ free_obj const *u_ship::find_closest_target(point const &pos0, float min_dist, f
 }
 
 
-void u_ship::acquire_target(float min_dist) {
+// reads the state of other objects and only modifies ai_rgen, so it can be called for different ships in parallel (see prepare_ai_action())
+void u_ship::choose_target(float min_dist, targ_decision_t &td) {
 
+	td = targ_decision_t();
+	td.prev_target = target_obj;
+	td.time        = time;
+	td.min_dist    = min_dist;
+	free_obj const *targ(target_obj);
 	unsigned const ai_base_type(ai_type & AI_BASE_TYPE);
-	float const tdist((target_obj == NULL) ? 0.0 : p2p_dist(pos, target_obj->get_pos()));
+	float const tdist((targ == NULL) ? 0.0 : p2p_dist(pos, targ->get_pos()));
 	float search_dist(specs().sensor_dist);
 
 	if (!can_move() && fighters.empty()) { // if can't move, then there is no point to acquiring a target out of weapons range
 		float const weap_range(specs().get_weap_range());
 		if (weap_range > 0.0) {search_dist = min(search_dist, (1.1f*weap_range + c_radius));}
 	}
-	if (target_obj != NULL && (target_obj->is_resetting() || target_obj->is_invisible() || (COMMON_TARGETS < 2 && tdist > search_dist))) {
-		target_obj = NULL; // don't target a ship that's out of sensor range or already dead
+	if (targ != NULL && (targ->is_resetting() || targ->is_invisible() || (COMMON_TARGETS < 2 && tdist > search_dist))) {
+		targ = NULL; // don't target a ship that's out of sensor range or already dead
 	}
 
 	// RETREAT, WAIT, ENEMY, ALL
 	if (ai_base_type != AI_ATT_WAIT) { // RETREAT, ENEMY, ALL
-		if (target_obj == NULL || target_obj == parent || target_obj->invalid() ||
+		if (targ == NULL || targ == parent || targ->invalid() ||
 			time > (tup_time + TARGET_CTIME) || tdist > search_dist || tdist < min_dist)
 		{
-			tup_time = time + ((rand()%TARGET_CTIME) >> 1);  // update target every so often, randomize
+			td.tup_time   = time + ((ai_rgen.rand()%TARGET_CTIME) >> 1);  // update target every so often, randomize
+			td.update_tup = 1;
 			free_obj const *new_target_obj(NULL);
 			bool find_closest(0);
 
 			switch (target_mode) {
 			case TARGET_CLOSEST:
-				find_closest = (target_obj == NULL || retarg_time == 0);
+				find_closest = (targ == NULL || retarg_time == 0);
 				break;
 			case TARGET_ATTACKER:
 			case TARGET_LAST:
-				find_closest = (target_obj == NULL);
+				find_closest = (targ == NULL);
 				break;
 			case TARGET_PARENT:
-				if (parent != NULL && target_valid(parent->get_target()) && !parent->get_target()->is_invisible()) {target_obj = parent->get_target();}
+				if (parent != NULL && target_valid(parent->get_target()) && !parent->get_target()->is_invisible()) {targ = parent->get_target();}
 				else {find_closest = 1;}
 				break;
 			default:
 				assert(0);
 			}
 			bool const has_dest(dest_mgr.is_valid());
-			if (has_dest && (rand()&3)) {find_closest = 0;} // every 4th frame if already have a destination
+			if (has_dest && (ai_rgen.rand()&3)) {find_closest = 0;} // every 4th frame if already have a destination
 			
 			if (find_closest) {
-				if (target_obj != NULL) {
-					if (alignment == ALIGN_NEUTRAL && ai_base_type == AI_ATT_ENEMY && (rand() % NEUT_CHASE_T) == 0) {
-						target_obj = NULL; // give up the chase after awhile
+				if (targ != NULL) {
+					if (alignment == ALIGN_NEUTRAL && ai_base_type == AI_ATT_ENEMY && (ai_rgen.rand() % NEUT_CHASE_T) == 0) {
+						targ = NULL; // give up the chase after awhile
 					}
-					if (tdist > 2.0*search_dist) {target_obj = NULL;} // (tdist < min_dist) is ignored for now, out of range
+					if (tdist > 2.0*search_dist) {targ = NULL;} // (tdist < min_dist) is ignored for now, out of range
 				}
 				float eff_search_dist(search_dist);
 				if (has_dest) {eff_search_dist = min(search_dist, p2p_dist(pos, dest_mgr.get_pos()));}
-				if (target_obj != NULL && tdist >= min_dist) {eff_search_dist = min(search_dist, 0.8f*tdist);}
-				new_target_obj = find_closest_target(pos, min_dist, eff_search_dist, 0);
-				if (new_target_obj == NULL) {new_target_obj = target_obj;} // keep the same target
+				if (targ != NULL && tdist >= min_dist) {eff_search_dist = min(search_dist, 0.8f*tdist);}
+				new_target_obj = find_closest_target(pos, targ, min_dist, eff_search_dist, 0, ai_rgen);
+				if (new_target_obj == NULL) {new_target_obj = targ;} // keep the same target
 
 				if (new_target_obj == NULL && alignment != ALIGN_NEUTRAL) { // no target, choose to attack same target as teammates
 					assert(alignment < a_targets.size());
@@ -507,7 +516,7 @@ void u_ship::acquire_target(float min_dist) {
 					}
 				}
 				if ((ai_type & AI_GUARDIAN) && new_target_obj == NULL) { // seek out the last attacker
-					unsigned const start_i(rand() % NUM_ALIGNMENT); // don't show favoritism
+					unsigned const start_i(ai_rgen.rand() % NUM_ALIGNMENT); // don't show favoritism
 					
 					for (unsigned i = 0; i < NUM_ALIGNMENT; ++i) {
 						unsigned const ii((start_i + i) % NUM_ALIGNMENT);
@@ -524,22 +533,38 @@ void u_ship::acquire_target(float min_dist) {
 				}
 			}
 			if (new_target_obj != NULL) {
-				target_obj  = new_target_obj;
-				retarg_time = RETARG_DELAY;
-				
-				if (target_obj->is_player_ship() && target_obj != parent) {
-					send_warning_message(string("Enemy Ship Detected: ") + get_name());
-				}
+				targ = td.new_target = new_target_obj;
 			}
-			if (target_obj != NULL && target_mode == TARGET_LAST) {target_set = 1;}
+			if (targ != NULL && target_mode == TARGET_LAST) {td.set_target_set = 1;}
 		}
 	}
-	if ((ai_type & AI_GUARDIAN) && target_obj != NULL && target_obj->get_align() == alignment) {
-		target_obj = NULL; // don't attack a friendly
+	if ((ai_type & AI_GUARDIAN) && targ != NULL && targ->get_align() == alignment) {
+		targ = NULL; // don't attack a friendly
 	}
-	if (target_obj == NULL && parent != NULL && target_valid(parent->get_target())) {
-		target_obj = parent->get_target(); // as a last resort, even if not TARGET_PARENT
+	if (targ == NULL && parent != NULL && target_valid(parent->get_target())) {
+		targ = parent->get_target(); // as a last resort, even if not TARGET_PARENT
 	}
+	td.target = targ;
+	td.valid  = 1;
+}
+
+
+// returns 0 without changing the target if the chosen target is no longer valid, for example if it was destroyed after the decision was made
+bool u_ship::commit_target(targ_decision_t const &td) {
+
+	assert(td.valid);
+	if (td.target != NULL && td.target != parent && !target_valid(td.target)) return 0;
+	target_obj = td.target;
+	if (td.update_tup) {tup_time = td.tup_time;}
+
+	if (td.new_target != NULL) {
+		retarg_time = RETARG_DELAY;
+		
+		if (td.new_target->is_player_ship() && td.new_target != parent) {
+			send_warning_message(string("Enemy Ship Detected: ") + get_name());
+		}
+	}
+	if (td.set_target_set) {target_set = 1;}
 	if (!fighters.empty()) get_fighter_target(this);
 	
 	if (target_obj != NULL && target_obj != parent) {
@@ -547,6 +572,15 @@ void u_ship::acquire_target(float min_dist) {
 		else if (target_obj->is_invisible())                  target_obj = NULL; // invisible (cloaked ship)
 	}
 	assert(target_obj != this);
+	return 1;
+}
+
+
+void u_ship::acquire_target(float min_dist) {
+
+	targ_decision_t td;
+	choose_target(min_dist, td);
+	if (!commit_target(td)) {target_obj = NULL;} // current target is no longer valid
 }
 
 
@@ -946,6 +980,30 @@ void u_ship::fire_at_target(free_obj const *const targ_obj, float min_dist) {
 }
 
 
+float u_ship::get_ai_min_dist() const {
+	bool const no_ammo(out_of_ammo(0)), boarding(specs().for_boarding && ncrew > specs().ncrew/2), kamikaze((ai_type & AI_KAMIKAZE) != 0);
+	return ((no_ammo || kamikaze || boarding) ? 0.0 : get_min_att_dist()); // ram the enemy
+}
+
+bool u_ship::is_ai_acquire_frame() const {
+	if (univ_dist_ai_ticks > 1 && (flags & OBJ_FLAGS_DIST)) { // optional reduced rate for distant ships, staggered by obj_id to spread the work across frames
+		return (((time + obj_id) % max(univ_dist_ai_ticks, (is_orbiting() ? 4U : 1U))) == 0);
+	}
+	return (!is_orbiting() || (time&3) == 0); // every 4th frame if orbiting
+}
+
+// called for all ships in parallel before the serial ai_action() pass: chooses a target from the current object state, which is
+// read only during this pass; ai_action() applies the target and does movement and firing, which modify other objects
+void u_ship::prepare_ai_action() {
+
+	targ_decision.valid = 0;
+	if (time < SHIP_AI_DELAY || invalid_or_disabled() || !begin_motion) return;
+	if (player_controlled() && specs().stoppable) return; // same early exits as ai_action(); other cases just waste the target choice
+	if (!is_ai_acquire_frame()) return;
+	choose_target(get_ai_min_dist(), targ_decision);
+}
+
+
 bool is_valid_fire_dir(vector3d const &target_dir, vector3d const &fire_dir, bool is_close=0) {
 	return (fire_dir != zero_vector && (is_close || get_angle(target_dir, fire_dir) < MAX_LEAD_SHOT_DOTP)); // check dir if not close
 }
@@ -1007,14 +1065,16 @@ void u_ship::ai_action() {
 	bool const no_ammo(out_of_ammo(0)), boarding(sc.for_boarding && ncrew > sc.ncrew/2), kamikaze((ai_type & AI_KAMIKAZE) != 0);
 	if (no_ammo && !kamikaze && !boarding && target_obj != parent) move_dir = -1; // out of ammo, run away
 	vector3d avoid_orient(dir);
-	float const min_attack(get_min_att_dist()), vmag(velocity.mag());
-	float const min_dist((no_ammo || kamikaze || boarding) ? 0.0 : min_attack); // ram the enemy
+	float const min_attack(get_min_att_dist()), vmag(velocity.mag()), min_dist(get_ai_min_dist());
 	bool const avoid_exp(can_move_ && avoid_explosions(avoid_orient)), local_dest(dest_override);
 	dest_override = 0;
 	
-	if (!is_orbiting() || (time&3) == 0) { // every 4th frame if orbiting
-		acquire_target(min_dist); // slow
+	if (is_ai_acquire_frame()) {
+		targ_decision_t const &td(targ_decision);
+		// use the target chosen in prepare_ai_action() unless our target was changed since then by another ship's AI (or ai_action() override) or the chosen one became invalid
+		if (!(td.valid && td.time == time && td.min_dist == min_dist && td.prev_target == target_obj && commit_target(td))) {acquire_target(min_dist);} // slow
 	}
+	targ_decision.valid = 0;
 	free_obj const *const acquired_target(target_obj);
 	if (local_dest) {target_obj = NULL;}
 	bool const parent_is_player(parent && !player_autopilot && parent->is_player_ship());
@@ -1551,7 +1611,7 @@ bool u_ship::fire_weapon(vector3d const &fire_dir, float target_dist) {
 			fpos += offsets[o]*radius; // fire from this point
 
 			if (multi_target) {
-				free_obj const *new_tobj(find_closest_target(fpos, get_min_att_dist(), weap.range, weap.shield_d_only));
+				free_obj const *new_tobj(find_closest_target(fpos, target_obj, get_min_att_dist(), weap.range, weap.shield_d_only, ai_rgen));
 				
 				if (new_tobj != NULL) {
 					tobj = new_tobj;
@@ -16,6 +16,8 @@ using std::ostream;
 using std::istream;
 
 class s_object;
+typedef string modmap_val_t;
+typedef map<s_object, modmap_val_t> modmap;
 class uasteroid;
 class uasteroid_field;
 class uasteroid_belt;
@@ -139,8 +141,10 @@ public:
 	void setname(string const &name_) {name = name_;}
 	string const &getname() const {return name;}
 	void gen_name(s_object const &sobj);
+	void gen_name(s_object const &sobj, rand_gen_t &rgen, modmap const &given_names);
 	bool rename(s_object const &sobj, string const &name_);
 	bool lookup_given_name(s_object const &sobj);
+	bool lookup_given_name(s_object const &sobj, modmap const &given_names);
 };
 
 
@@ -152,6 +156,7 @@ public:
 
 	uobj_rgen() : gen(0) {}
 	void gen_rseeds();
+	void gen_rseeds(rand_gen_t &rgen_);
 	void get_rseeds();
 	void set_rseeds() const;
 	int get_id() const {return rgen.rseed1;} // not complete id, but should be good enough
@@ -439,8 +444,8 @@ public:
 	~ugalaxy();
 	void calc_color();
 	void calc_bounding_sphere();
-	bool create(ucell const &cell, int index);
-	float get_radius_at(point const &pos_, bool exact=0) const;
+	bool create(ucell const &cell, int index, rand_gen_t &rgen_, s_object const &name_sobj, modmap const &given_names);
+	float get_radius_at(point const &pos_, bool exact=0) const; // exact=1 neither reads nor writes the cache
 	bool is_close_to(ugalaxy const &g, float overlap_amount) const;
 	void process(ucell const &cell);
 	bool gen_system_loc(vector<point> const &placed);
@@ -468,6 +473,7 @@ public:
 
 	ucell() : last_bkg_color(BLACK), last_player_pos(all_zeros), last_star_cache_ix(0), cached_stars_valid(0) {}
 	void gen_cell(int const ii[3]);
+	void gen_cell_at(int const ii[3], point const &upt, s_object const &name_sobj, modmap const &given_names);
 	void draw_nebulas(ushader_group &usg) const;
 	void draw_systems(ushader_group &usg, s_object const &clobj, unsigned pass, bool no_move, bool skip_closest, bool sel_cell, bool gen_only, bool no_asteroid_dust);
 	void free_uobj();
@@ -544,6 +550,24 @@ struct cell_block {
 	ucell cells[U_BLOCKS][U_BLOCKS][U_BLOCKS];
 };
 
+struct univ_search_hints_t { // galaxy, cluster, and system of the last get_closest_object() result, searched first by the next query
+	int galaxy, cluster, system;
+	univ_search_hints_t() : galaxy(-1), cluster(-1), system(-1) {}
+	void update(s_object const &result);
+};
+
+struct closest_obj_query_t { // for batched get_object_closest_to_pos() calls
+
+	point pos;
+	float r_add;
+	bool include_asteroids, skip;
+	int found;
+	s_object result;
+
+	closest_obj_query_t() : pos(all_zeros), r_add(0.0), include_asteroids(0), skip(1), found(0) {}
+	closest_obj_query_t(point const &pos_, float r_add_, bool ia) : pos(pos_), r_add(r_add_), include_asteroids(ia), skip(0), found(0) {}
+};
+
 struct coll_test { // size = 16
 
 	int index;
@@ -565,10 +589,12 @@ class universe_t : protected cell_block {
 public:
 	void init();
 	void shift_cells(int dx, int dy, int dz);
+	void prefetch_cells(point const &camera);
 	void free_context();
 	void draw_all_cells(s_object const &clobj, bool skip_closest, bool no_move, int no_distant, bool gen_only, bool no_asteroid_dust);
 	int get_closest_object(s_object &result, point pos, int max_level, bool include_asteroids, bool offset, float expand,
-		bool get_destroyed=0, float g_expand=1.0, float r_add=0.0, int galaxy_hint=-1) const;
+		bool get_destroyed=0, float g_expand=1.0, float r_add=0.0, int galaxy_hint=-1, univ_search_hints_t *hints=nullptr) const;
+	void get_objects_closest_to_pos(vector<closest_obj_query_t> &queries, float expand=1.0) const;
 	bool get_trajectory_collisions(line_query_state &lqs, s_object &result, point &coll, vector3d dir, point start, float dist, float line_radius, bool include_asteroids=1) const;
 	float get_point_temperature(s_object const &clobj, point const &pos, point &sun_pos) const;
 
@@ -597,9 +623,6 @@ public:
 };
 
 
-typedef string modmap_val_t;
-typedef map<s_object, modmap_val_t> modmap;
-
 
 inline uplanet const &get_planet(s_object const &so) {return so.get_planet();}
 
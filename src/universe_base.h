@@ -89,6 +89,9 @@ public:
 };
 
 
+enum {USIM_PHASE_CLOSEST=0, USIM_PHASE_GRAVITY, USIM_PHASE_AI, USIM_PHASE_PHYSICS, USIM_PHASE_COLL, NUM_USIM_PHASES}; // simulation benchmark phases
+
+
 struct ellipsoid_t {
 
 	float xy_angle;
@@ -105,4 +108,5 @@ bool has_sun_lighting(point const &pos);
 int  set_uobj_color(point const &pos, float radius, bool known_shadowed, int shadow_thresh, point *sun_pos, colorRGBA *sun_color,
 					uobject const *&sobj, float ambient_scale_s, float ambient_scale_no_s, shader_t *shader, bool no_shadow_check=0);
 uobject *line_intersect_universe(point const &start, vector3d const &dir, float length, float line_radius, float &dist);
+double *get_usim_phase_time(unsigned phase); // returns nullptr unless a simulation benchmark is running
 
@@ -10,10 +10,66 @@
 
 float const M_ATTEN_FACTOR = 0.5;
 float const F_ATTEN_FACTOR = 0.4;
+unsigned const PLANET_TEX_CACHE_SIZE = 48; // max number of cached rocky planet/moon textures (~22MB at 256x256)
 
 extern int display_mode;
 
 
+class planet_tex_cache_t { // generated texture + heightmap data for rocky planets/moons, keyed by rseeds + surface params
+
+	struct entry_t {
+		long rs1=0, rs2=0;
+		unsigned size=0, last_used=0;
+		int type=0;
+		float temp=0.0, atmos=0.0, water=0.0, lava=0.0, snow_thresh=0.0;
+		colorRGBA colorA, colorB;
+		vector<unsigned char> data;
+		vector<float> heightmap;
+
+		bool matches(urev_body const &b, unsigned size_) const {
+			return (rs1 == b.rgen.rseed1 && rs2 == b.rgen.rseed2 && size == size_ && type == b.type && temp == b.temp && atmos == b.atmos &&
+				water == b.water && lava == b.lava && snow_thresh == b.snow_thresh && colorA == b.colorA && colorB == b.colorB);
+		}
+	};
+	vector<entry_t> entries;
+	unsigned cur_time=0;
+
+public:
+	bool lookup(urev_body const &b, unsigned size, unsigned char *data, vector<float> &heightmap) {
+		for (auto i = entries.begin(); i != entries.end(); ++i) {
+			if (!i->matches(b, size)) continue;
+			assert(i->data.size() == 3*size*size && i->heightmap.size() == size*size);
+			memcpy(data, i->data.data(), i->data.size());
+			heightmap = i->heightmap;
+			i->last_used = ++cur_time;
+			return 1;
+		}
+		return 0;
+	}
+	void add(urev_body const &b, unsigned size, unsigned char const *data, vector<float> const &heightmap) {
+		entry_t *e(nullptr);
+
+		if (entries.size() < PLANET_TEX_CACHE_SIZE) { // add a new entry
+			entries.emplace_back();
+			e = &entries.back();
+		}
+		else { // replace the least recently used entry
+			e = &entries.front();
+			for (auto i = entries.begin(); i != entries.end(); ++i) {if (i->last_used < e->last_used) {e = &(*i);}}
+		}
+		e->rs1   = b.rgen.rseed1; e->rs2 = b.rgen.rseed2;
+		e->size  = size; e->type = b.type; e->temp = b.temp; e->atmos = b.atmos;
+		e->water = b.water; e->lava = b.lava; e->snow_thresh = b.snow_thresh;
+		e->colorA = b.colorA; e->colorB = b.colorB;
+		e->data.assign(data, data+3*size*size);
+		e->heightmap = heightmap;
+		e->last_used = ++cur_time;
+	}
+};
+
+planet_tex_cache_t planet_tex_cache;
+
+
 void noise_gen_3d::gen_sines(float mag, float freq) {
 
 	assert(SINES_PER_FREQ >= 2);
@@ -200,12 +256,12 @@ void urev_body::gen_texture_data_and_heightmap(unsigned char *data, unsigned siz
 	unsigned const table_size(MAX_TEXTURE_SIZE << 1); // larger is more accurate
 	static float xtable[TOT_NUM_SINES*table_size], ytable[TOT_NUM_SINES*table_size];
 	surface->setup(size, max(water, lava), 1); // use_heightmap=1
+	wr_scale = 1.0/max(0.01, (1.0 - water));
+	if (planet_tex_cache.lookup(*this, size, data, surface->heightmap)) return; // already generated
 	unsigned const num_sines(surface->num_sines);
 	float const *const rdata(surface->rdata);
 	float const mt2(0.5*(table_size-1)), scale(1.5/surface->max_mag);
 	float const delta(TWO_PI/size), sin_ds(sin(delta)), cos_ds(cos(delta));
-	unsigned const pole_thresh(size>>3);
-	wr_scale = 1.0/max(0.01, (1.0 - water));
 
 	for (unsigned i = 0; i < table_size; ++i) { // build sin table
 		unsigned const offset(i*num_sines);
@@ -233,20 +289,15 @@ void urev_body::gen_texture_data_and_heightmap(unsigned char *data, unsigned siz
 		for (unsigned j = 0; j < size; ++j) { // theta values, Note: x and y are swapped because theta is out of phase by 90 degrees to match tex coords
 			float const s(sin_s), c(cos_s), xval(sin_phi*s), yval(sin_phi*c);
 			unsigned const tj(size-j-1), index(3*(texoff + tj));
-			unsigned const ox1((unsigned((xval+1.0)*mt2))*num_sines), oy1((unsigned((yval+1.0)*mt2))*num_sines);
+			// linearly interpolate between adjacent table entries, which is accurate enough to be used near the poles as well
+			float const tx((xval+1.0)*mt2), ty((yval+1.0)*mt2);
+			unsigned const ix(min(unsigned(max(tx, 0.0f)), table_size-2)), iy(min(unsigned(max(ty, 0.0f)), table_size-2));
+			float const fx(tx - ix), fy(ty - iy);
+			float const *const x0(xtable + ix*num_sines), *const x1(x0 + num_sines);
+			float const *const y0(ytable + iy*num_sines), *const y1(y0 + num_sines);
 			float val(0.0);
-
-			if (i <= (int)pole_thresh || i >= int(size-pole_thresh-1)) { // slower version near the poles
-				for (unsigned k = 0; k < num_sines; ++k) {
-					unsigned const index2(NUM_SINE_PARAMS*k);
-					val += ztable[k]*SINF(rdata[index2+1]*xval + rdata[index2+2])*SINF(rdata[index2+3]*yval + rdata[index2+4]);
-				}
-			}
-			else {
-				// Note: chooses the closest precomputed grid point for efficiency -
-				// no interpolation, so has artifacts closer to the poles
-				for (unsigned k = 0; k < num_sines; ++k) {val += ztable[k]*xtable[ox1+k]*ytable[oy1+k];}
-			}
+			// branch-free, contiguous in k so that it vectorizes across sine terms
+			for (unsigned k = 0; k < num_sines; ++k) {val += ztable[k]*(x0[k] + fx*(x1[k] - x0[k]))*(y0[k] + fy*(y1[k] - y0[k]));} // performance critical
 			val = 0.5*(max(-1.0f, min(1.0f, scale*val)) + 1.0);
 			surface->heightmap[hmoff + j] = val;
 			get_surface_color((data + index), val, phi);
@@ -254,6 +305,7 @@ void urev_body::gen_texture_data_and_heightmap(unsigned char *data, unsigned siz
 			cos_s = c*cos_ds - s*sin_ds;
 		} // for j
 	} // for i
+	planet_tex_cache.add(*this, size, data, surface->heightmap);
 	//if (size >= MAX_TEXTURE_SIZE) PRINT_TIME("Gen");
 }
 
@@ -9,6 +9,7 @@
 
 int const FAST_LIGHT_VIS    = 1;
 float const NORM_VIS_EXTEND = 0.02;
+float const HORIZON_QUANT   = 255.0/PI_TWO; // horizon angles in [0, PI/2] are stored as unsigned chars
 
 
 point ocean;
@@ -388,76 +389,114 @@ bool light_visible_from_vertex(int xpos, int ypos, point const &lpos, int fast)
 }
 
 
-class mesh_shadow_gen {
+// calls func(x, y) for each in-bounds mesh vertex along the line from {xa, ya} to {xb, yb} using Bresenham's line drawing algorithm
+template<typename F> void walk_mesh_line(int xa, int ya, int xb, int yb, int xsize, int ysize, F func) {
 
-	float const *mh;
-	unsigned char *smask;
-	float const *sh_in_x, *sh_in_y;
-	float *sh_out_x, *sh_out_y;
-	float dist;
+	int const dx(xb - xa), dy(yb - ya);
+	int x(xa), y(ya);
+	int dx1(0), dy1(0), dx2(0), dy2(0);
+	if (dx < 0) {dx1 = -1; dx2 = -1;} else if (dx > 0) {dx1 = 1; dx2 = 1;}
+	if (dy < 0) {dy1 = -1;} else if (dy > 0) {dy1 = 1;}
+	int longest(abs(dx)), shortest(abs(dy));
+
+	if (longest <= shortest) {
+		swap(longest, shortest);
+		if (dy < 0) {dy2 = -1;} else if (dy > 0) {dy2 = 1;}
+		dx2 = 0;
+	}
+	int numerator(longest >> 1);
+
+	for (int i = 0; i <= longest; i++) {
+		if (x >= 0 && y >= 0 && x < xsize && y < ysize) {func(x, y);}
+		numerator += shortest;
+
+		if (numerator >= longest) {
+			numerator -= longest;
+			x += dx1;
+			y += dy1;
+		} else {
+			x += dx2;
+			y += dy2;
+		}
+	} // for i
+}
+
+
+// sweeps parallel lines in direction dir across a mesh of size xsize x ysize, starting from the two edges facing the light;
+// lines are spaced at half vertex increments, so adjacent lines may visit the same vertex
+class mesh_sweep_base {
+protected:
 	int xsize, ysize;
+	float dist;
 	vector3d dir;
 
-	void trace_shadow_path(point v1) {
+	mesh_sweep_base(int xsz, int ysz) : xsize(xsz), ysize(ysz), dist(0.0f) {}
+	void set_dir(vector3d const &dir_) {dir = dir_; dist = 2.0*XY_SUM_SIZE/sqrt(dir.x*dir.x + dir.y*dir.y);}
+	unsigned get_num_lines() const {return 2*(xsize + ysize);}
+
+	bool get_line(unsigned n, int &xa, int &ya, int &xb, int &yb) const {
+		point v1;
+		if (n < 2U*ysize) {v1.assign(get_xval((dir.x > 0) ? 0 : xsize), (-Y_SCENE_SIZE + 0.5*DY_VAL*n), 0.0);} // half increments
+		else {v1.assign((-X_SCENE_SIZE + 0.5*DX_VAL*(n - 2*ysize)), get_yval((dir.y > 0) ? 0 : ysize), 0.0);}
 		point v2(v1 + vector3d(dir.x*dist, dir.y*dist, 0.0));
 		float const d[3][2] = {{-X_SCENE_SIZE, get_xval(xsize)}, {-Y_SCENE_SIZE, get_yval(ysize)}, {zmin, zmax}};
-		if (!do_line_clip(v1, v2, d)) return; // edge case ([zmin, zmax] should contain 0.0)
-		int const xa(get_xpos(v1.x)), ya(get_ypos(v1.y)), xb(get_xpos(v2.x)), yb(get_ypos(v2.y)), dx(xb - xa), dy(yb - ya);
+		if (!do_line_clip(v1, v2, d)) return 0; // edge case ([zmin, zmax] should contain 0.0)
+		xa = get_xpos(v1.x); ya = get_ypos(v1.y); xb = get_xpos(v2.x); yb = get_ypos(v2.y);
+		return 1;
+	}
+	point get_vertex(float const *const mh, int x, int y) const {return point((-X_SCENE_SIZE + DX_VAL*x), (-Y_SCENE_SIZE + DY_VAL*y), mh[y*xsize+x]);}
+};
+
+
+class mesh_shadow_gen : public mesh_sweep_base {
+
+	float const *mh;
+	unsigned char *smask;
+	float const *sh_in_x, *sh_in_y;
+	float *sh_out_x, *sh_out_y;
+	vector<int> sh_out_line[2]; // {x, y}: index of the line that last set each sh_out value
+
+	// multiple lines can end at the same edge vertex; keep the value from the highest line index, which is what a serial sweep would produce
+	void set_sh_out(float *sh_out, unsigned dim, unsigned ix, float shadow_z, int line_ix) {
+		#pragma omp critical(mesh_shadow_out)
+		if (line_ix >= sh_out_line[dim][ix]) {sh_out_line[dim][ix] = line_ix; sh_out[ix] = shadow_z;}
+	}
+	void trace_shadow_path(unsigned line_ix) {
+		int xa(0), ya(0), xb(0), yb(0);
+		if (!get_line(line_ix, xa, ya, xb, yb)) return;
 		bool const dim(fabs(dir.x) < fabs(dir.y));
 		double const dir_ratio(dir.z/dir[dim]);
 		bool inited(0);
 		point cur(all_zeros);
 
 #if 1 // Bresenham's line drawing algorithm
-		int x(xa), y(ya);
-		int dx1(0), dy1(0), dx2(0), dy2(0);
-		if (dx < 0) {dx1 = -1; dx2 = -1;} else if (dx > 0) {dx1 = 1; dx2 = 1;}
-		if (dy < 0) {dy1 = -1;} else if (dy > 0) {dy1 = 1;}
-		int longest(abs(dx)), shortest(abs(dy));
-
-		if (longest <= shortest) {
-			swap(longest, shortest);
-			if (dy < 0) {dy2 = -1;} else if (dy > 0) {dy2 = 1;}
-			dx2 = 0;
-		}
-		int numerator(longest >> 1);
-
-		for (int i = 0; i <= longest; i++) {
-			if (x >= 0 && y >= 0 && x < xsize && y < ysize) {
-				point const pt((-X_SCENE_SIZE + DX_VAL*x), (-Y_SCENE_SIZE + DY_VAL*y), mh[y*xsize+x]);
-
-				// use starting shadow height value
-				if (sh_in_y != NULL && x == xa && sh_in_y[y] > MESH_MIN_Z) {
-					cur.assign(pt.x, pt.y, sh_in_y[y]);
-					inited = 1;
-				}
-				else if (sh_in_x != NULL && y == ya && sh_in_x[x] > MESH_MIN_Z) {
-					cur.assign(pt.x, pt.y, sh_in_x[x]);
-					inited = 1;
-				}
-				float const shadow_z((pt[dim] - cur[dim])*dir_ratio + cur.z);
+		walk_mesh_line(xa, ya, xb, yb, xsize, ysize, [&](int x, int y) {
+			point const pt(get_vertex(mh, x, y));
 
-				if (inited && shadow_z > pt.z) { // shadowed
-					smask[y*xsize+x] |= MESH_SHADOW;
-					// set ending shadow height value
-					if (sh_out_y != NULL && x == xb) {sh_out_y[y] = shadow_z;}
-					if (sh_out_x != NULL && y == yb) {sh_out_x[x] = shadow_z;}
-				}
-				else {cur = pt;} // update point
+			// use starting shadow height value
+			if (sh_in_y != NULL && x == xa && sh_in_y[y] > MESH_MIN_Z) {
+				cur.assign(pt.x, pt.y, sh_in_y[y]);
 				inited = 1;
 			}
-			numerator += shortest;
-
-			if (numerator >= longest) {
-				numerator -= longest;
-				x += dx1;
-				y += dy1;
-			} else {
-				x += dx2;
-				y += dy2;
+			else if (sh_in_x != NULL && y == ya && sh_in_x[x] > MESH_MIN_Z) {
+				cur.assign(pt.x, pt.y, sh_in_x[x]);
+				inited = 1;
 			}
-		} // for i
+			float const shadow_z((pt[dim] - cur[dim])*dir_ratio + cur.z);
+
+			if (inited && shadow_z > pt.z) { // shadowed
+				unsigned char &sm(smask[y*xsize+x]);
+				#pragma omp atomic
+				sm |= MESH_SHADOW;
+				// set ending shadow height value
+				if (sh_out_y != NULL && x == xb) {set_sh_out(sh_out_y, 1, y, shadow_z, line_ix);}
+				if (sh_out_x != NULL && y == yb) {set_sh_out(sh_out_x, 0, x, shadow_z, line_ix);}
+			}
+			else {cur = pt;} // update point
+			inited = 1;
+		});
 #else
+		int const dx(xb - xa), dy(yb - ya);
 		int const steps(max(abs(dx), abs(dy)));
 		double const xinc(dx/(double)steps), yinc(dy/(double)steps);
 		double x(xa), y(ya);
@@ -504,31 +543,76 @@ class mesh_shadow_gen {
 
 public:
 	mesh_shadow_gen(float const *const h, unsigned char *sm, int xsz, int ysz, float const *shix, float const *shiy, float *shox, float *shoy)
-		: mh(h), smask(sm), sh_in_x(shix), sh_in_y(shiy), sh_out_x(shox), sh_out_y(shoy), dist(0.0f), xsize(xsz), ysize(ysz) {
+		: mesh_sweep_base(xsz, ysz), mh(h), smask(sm), sh_in_x(shix), sh_in_y(shiy), sh_out_x(shox), sh_out_y(shoy) {
 		assert(mh != NULL && smask != NULL);
 	}
 	void run(point const &lpos) { // assumes light source directional/at infinity
 		//timer_t timer("Shadow Gen");
 		assert(smask != NULL);
-		dir  = (all_zeros - lpos).get_norm();
-		dist = 2.0*XY_SUM_SIZE/sqrt(dir.x*dir.x + dir.y*dir.y);
-		#pragma omp parallel sections num_threads(2)
-		{
-			#pragma omp section
-			{
-				float const xval(get_xval((dir.x > 0) ? 0 : xsize));
-				for (int y = 0; y < 2*ysize; ++y) { // half increments
-					trace_shadow_path(point(xval, (-Y_SCENE_SIZE + 0.5*DY_VAL*y), 0.0));
-				}
-			}
-			#pragma omp section
+		set_dir((all_zeros - lpos).get_norm());
+		int const num_lines(get_num_lines());
+		sh_out_line[0].assign(xsize, -1);
+		sh_out_line[1].assign(ysize, -1);
+		// scan lines are independent: each one only sets shadow bits and the edge shadow heights
+#pragma omp parallel for schedule(dynamic,16) if (xsize*ysize >= 4096)
+		for (int n = 0; n < num_lines; ++n) {trace_shadow_path(n);}
+	}
+};
+
+
+// computes the horizon angle of each mesh vertex in num_az evenly spaced azimuth directions toward the light;
+// uses the upper convex hull of the vertices already visited along each sweep line, which gives the max elevation angle in O(1) amortized per vertex
+class mesh_horizon_gen : public mesh_sweep_base {
+
+	float const *mh;
+
+	struct hull_pt_t {
+		float t, z; // t = distance along the sweep direction
+		hull_pt_t(float t_=0.0, float z_=0.0) : t(t_), z(z_) {}
+		float slope_from(hull_pt_t const &p) const {return (z - p.z)/max((p.t - t), TOLERANCE);} // rise from p toward this point (behind p)
+	};
+public:
+	mesh_horizon_gen(float const *const h, int xsz, int ysz) : mesh_sweep_base(xsz, ysz), mh(h) {assert(mh != NULL);}
+
+	void run(unsigned num_az, vector<unsigned char> &horizons) {
+		//timer_t timer("Horizon Gen");
+		unsigned const num_verts(xsize*ysize);
+		horizons.resize(num_az*num_verts);
+		std::fill(horizons.begin(), horizons.end(), 0);
+
+		for (unsigned a = 0; a < num_az; ++a) {
+			float const theta(TWO_PI*a/num_az);
+			set_dir(vector3d(-cos(theta), -sin(theta), 0.0)); // sweep away from the light
+			unsigned char *const hz(&horizons[a*num_verts]);
+			int const num_lines(get_num_lines());
+
+#pragma omp parallel if (num_verts >= 4096)
 			{
-				float const yval(get_yval((dir.y > 0) ? 0 : ysize));
-				for (int x = 0; x < 2*xsize; ++x) { // half increments
-					trace_shadow_path(point((-X_SCENE_SIZE + 0.5*DX_VAL*x), yval, 0.0));
-				}
-			}
-		}
+				// adjacent lines can visit the same vertex, so each thread takes the max into its own buffer, and these are merged at the end
+				vector<unsigned char> thread_hz(num_verts, 0);
+
+#pragma omp for schedule(dynamic,16) nowait
+				for (int n = 0; n < num_lines; ++n) {
+					int xa(0), ya(0), xb(0), yb(0);
+					if (!get_line(n, xa, ya, xb, yb)) continue;
+					vector<hull_pt_t> hull; // upper convex hull of visited vertices
+
+					walk_mesh_line(xa, ya, xb, yb, xsize, ysize, [&](int x, int y) {
+						point const pt(get_vertex(mh, x, y));
+						hull_pt_t const p((pt.x*dir.x + pt.y*dir.y), pt.z);
+						while (hull.size() >= 2 && hull[hull.size()-2].slope_from(p) >= hull.back().slope_from(p)) {hull.pop_back();}
+
+						if (!hull.empty()) {
+							float const angle(atan(hull.back().slope_from(p)));
+							if (angle > 0.0) {max_eq(thread_hz[y*xsize+x], (unsigned char)min(255.0f, ceil(HORIZON_QUANT*angle)));} // round up to be conservative
+						}
+						hull.push_back(p);
+					});
+				} // for n
+#pragma omp critical(mesh_horizon_merge) // once per thread
+				for (unsigned i = 0; i < num_verts; ++i) {max_eq(hz[i], thread_hz[i]);}
+			} // omp parallel
+		} // for a
 	}
 };
 
@@ -545,6 +629,38 @@ void calc_mesh_shadows(unsigned l, point const &lpos, float const *const mh, uns
 }
 
 
+void calc_mesh_horizons(float const *const mh, int xsize, int ysize, unsigned num_az, vector<unsigned char> &horizons) {
+	assert(num_az > 0);
+	mesh_horizon_gen(mh, xsize, ysize).run(num_az, horizons);
+}
+
+// same result as calc_mesh_shadows() (within the azimuth/angle quantization) for any light direction, without the shadow sweep;
+// horizons must have been computed by calc_mesh_horizons() for the same mesh; doesn't include shadows cast from outside the mesh
+void calc_mesh_shadows_from_horizons(unsigned l, point const &lpos, vector<unsigned char> const &horizons, unsigned num_az,
+	unsigned char *smask, int xsize, int ysize)
+{
+	unsigned const num_verts(xsize*ysize);
+	assert(num_az > 0 && horizons.size() == num_az*num_verts);
+	bool const no_shadow(l == LIGHT_MOON && combined_gu), all_shadowed(!no_shadow && lpos.z < zmin);
+	unsigned char const val(all_shadowed ? MESH_SHADOW : 0);
+	for (unsigned i = 0; i < num_verts; ++i) {smask[i] = val;}
+	if (no_shadow || all_shadowed || FAST_VISIBILITY_CALC == 3) return;
+	float const xy_mag(sqrt(lpos.x*lpos.x + lpos.y*lpos.y));
+	if (xy_mag == 0.0) return; // straight down = no mesh shadows
+	float const light_angle(HORIZON_QUANT*atan2(lpos.z, xy_mag)); // in quantized units
+	float azimuth(num_az*atan2(lpos.y, lpos.x)/TWO_PI);
+	if (azimuth < 0.0) {azimuth += num_az;}
+	unsigned const a0(min(unsigned(azimuth), num_az-1)), a1((a0 + 1) % num_az);
+	float const w1(azimuth - a0), w0(1.0 - w1);
+	unsigned char const *const h0(&horizons[a0*num_verts]), *const h1(&horizons[a1*num_verts]);
+
+#pragma omp parallel for schedule(static) if (num_verts >= 65536)
+	for (int i = 0; i < (int)num_verts; ++i) {
+		if (w0*h0[i] + w1*h1[i] > light_angle) {smask[i] = MESH_SHADOW;}
+	}
+}
+
+
 void calc_visibility(unsigned light_sources) {
 
 	if (world_mode == WMODE_UNIVERSE) return;
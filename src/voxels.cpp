@@ -1061,10 +1061,7 @@ bool voxel_model_ground::clear_block(unsigned block_ix) {
 
 	if (add_cobjs) {
 		assert(block_ix < data_blocks.size());
-
-		for (vector<unsigned>::const_iterator i = data_blocks[block_ix].cids.begin(); i != data_blocks[block_ix].cids.end(); ++i) {
-			remove_coll_object(*i);
-		}
+		remove_coll_objects(data_blocks[block_ix].cids);
 		data_blocks[block_ix].clear();
 	}
 	return ret;
@@ -1135,15 +1132,18 @@ void voxel_model_ground::create_block_hook(unsigned block_ix) { // lod_level ==
 	tri_data_t::value_type const &td(tri_data[0][block_ix]);
 	unsigned const num_verts(td.num_verts());
 	assert((num_verts % 3) == 0);
-	data_blocks[block_ix].cids.reserve(num_verts/3);
+	vector<coll_tquad> polys; // generated outside the critical section, then added as a batch
+	vector<unsigned char> cp_ixs; // index into cparams for each poly
+	polys.reserve(num_verts/3);
+	cp_ixs.reserve(num_verts/3);
 
-	#pragma omp critical(add_coll_polygon)
 	for (unsigned v = 0; v < num_verts; v += 3) {
 		point const pts[3] = {td.get_vert(v+0).v, td.get_vert(v+1).v, td.get_vert(v+2).v};
 		vector3d const normal(get_poly_norm(pts));
 		if (normal == zero_vector) continue; // degenerate polygon, skip it
 		unsigned const cp_ix((params.top_tex_used && normal.z > 0.5) ? 2 : fabs(eval_noise_texture_at((pts[0] + pts[1] + pts[2])/3.0)) > 0.5);
-		int cindex(-1);
+		coll_tquad poly;
+		poly.normal = normal;
 
 #if 1 // only gets here ~5% of the time for the large voxel terrain scene
 		if (v+3 < num_verts) { // have a next triangle
@@ -1152,24 +1152,32 @@ void voxel_model_ground::create_block_hook(unsigned block_ix) { // lod_level ==
 			if ((normal - get_poly_norm(pts2)).mag_sq() < 0.0001) {
 				if (pts2[0] == pts[1] && pts2[2] == pts[2]) { // merge two tris into a quad
 					point const quad_pts[4] = {pts[0], pts[1], pts2[1], pts[2]};
-					cindex = add_simple_coll_polygon(quad_pts, 4, cparams[cp_ix], normal);
+					poly.npts = 4;
+					for (unsigned i = 0; i < 4; ++i) {poly.pts[i] = quad_pts[i];}
 					v += 3; // skip the second triangle
 				}
 				else if (pts2[1] == pts[1] && pts2[0] == pts[2]) { // merge two tris into a quad
 					point const quad_pts[4] = {pts[0], pts[1], pts2[2], pts[2]};
-					cindex = add_simple_coll_polygon(quad_pts, 4, cparams[cp_ix], normal);
+					poly.npts = 4;
+					for (unsigned i = 0; i < 4; ++i) {poly.pts[i] = quad_pts[i];}
 					v += 3; // skip the second triangle
 				}
 			}
 		}
 #endif
-		if (cindex < 0) {cindex = add_simple_coll_polygon(pts, 3, cparams[cp_ix], normal);}
-		if (add_as_fixed) {coll_objects.get_cobj(cindex).fixed = 1;} // mark as fixed so that lmap cells will be generated and cobjs will be re-added
-		data_blocks[block_ix].cids.push_back(cindex);
-	}
-	// Note: this call is really only safe to do without trying to the add_coll_polygon critical section because
-	// coll_objects has been reserved ahead of time and won't be resized (meaning the pointers are always valid)
-	cobj_tree.add_cobjs_for_block(data_blocks[block_ix].cids, block_ix%params.num_blocks, block_ix/params.num_blocks);
+		if (poly.npts == 0) { // not merged into a quad
+			poly.npts = 3;
+			for (unsigned i = 0; i < 3; ++i) {poly.pts[i] = pts[i];}
+		}
+		polys.push_back(poly);
+		cp_ixs.push_back(cp_ix);
+	}
+	vector<unsigned> &cids(data_blocks[block_ix].cids);
+	// mark as fixed so that lmap cells will be generated and cobjs will be re-added
+	add_simple_coll_polygons(polys, cp_ixs, cparams, cids, add_as_fixed);
+	// Note: coll_objects won't be resized until register_simple_coll_polygons() is called, so it's safe to read the cobjs here
+	cobj_tree.add_cobjs_for_block(cids, block_ix%params.num_blocks, block_ix/params.num_blocks);
+	register_simple_coll_polygons(cids);
 }
 
 